@@ -0,0 +1,288 @@
+
+#ifndef COLUMNAR
+#define COLUMNAR
+
+#include "mapped_file.hh"
+#include "convertions.hh"
+#include "correlation.hh"
+#include "parallel_correlation.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+/**
+ * Simple on disk columnar format for numeric matrices:
+ *
+ *  [header, 64 bytes]
+ *      magic "MCOLUMNS", version, dtype,
+ *      rows, cols, column stride (in elements)
+ *  [column 0][column 1] ... [column cols-1]
+ *
+ * Every column takes stride elements, a multiple of 64 bytes,
+ * so columns are aligned to 64 bytes in the file (and in
+ * memory once it is mapped). Data are stored in the native
+ * byte order. Chunks of rows can be fed to
+ * multicolumn_pcc_accumulator::accumulate() as column-major
+ * matrices (row_offset 1, col_offset stride) without copies.
+ */
+namespace math
+{
+    namespace io
+    {
+
+        enum class dtype : std::uint32_t {
+            float32 = 1,
+            float64 = 2,
+            int16 = 3,
+            int32 = 4,
+            int64 = 5,
+        };
+
+        template <typename T>
+        constexpr dtype dtype_of() {
+            if constexpr (std::is_same_v<T, float>) {
+                return dtype::float32;
+            } else if constexpr (std::is_same_v<T, double>) {
+                return dtype::float64;
+            } else if constexpr (std::is_same_v<T, std::int16_t>) {
+                return dtype::int16;
+            } else if constexpr (std::is_same_v<T, std::int32_t>) {
+                return dtype::int32;
+            } else {
+                static_assert(std::is_same_v<T, std::int64_t>, "Unsupported type for the columnar format");
+                return dtype::int64;
+            }
+        }
+
+        struct columnar_header {
+            char magic[8];
+            std::uint32_t version;
+            dtype type;
+            std::uint64_t rows;
+            std::uint64_t cols;
+            std::uint64_t stride;       // elements between two columns
+            std::uint8_t reserved[24];
+        };
+        static_assert(sizeof(columnar_header) == 64, "The header must take 64 bytes");
+
+        constexpr char columnar_magic[8] = {'M','C','O','L','U','M','N','S'};
+        constexpr std::uint32_t columnar_version = 1;
+
+        // elements per column, rounded up to fill 64 bytes blocks
+        template <typename T>
+        constexpr std::uint64_t columnar_stride(std::uint64_t rows) {
+            constexpr std::uint64_t per_block = 64 / sizeof(T);
+            return (rows + per_block - 1) / per_block * per_block;
+        }
+
+        /**
+         * Create a columnar file with the given size and give
+         * direct access to its (zero initialized) columns.
+         */
+        template <typename T>
+        class columnar_writer
+        {
+        private:
+            mapped_file file;
+            std::uint64_t _rows, _cols, stride;
+
+            columnar_header& header() {
+                return *reinterpret_cast<columnar_header*>(file.data());
+            }
+
+        public:
+            columnar_writer(const std::string& path, std::uint64_t rows, std::uint64_t cols)
+            : file(path, sizeof(columnar_header) + columnar_stride<T>(rows)*cols*sizeof(T)),
+              _rows{rows}, _cols{cols}, stride{columnar_stride<T>(rows)}
+            {
+                auto& h = header();
+                std::memcpy(h.magic, columnar_magic, sizeof(h.magic));
+                h.version = columnar_version;
+                h.type = dtype_of<T>();
+                h.rows = rows;
+                h.cols = cols;
+                h.stride = stride;
+            }
+
+            T* column(std::uint64_t c) {
+                return reinterpret_cast<T*>(file.data() + sizeof(columnar_header)) + c*stride;
+            }
+
+            // element (r,c) is at data()[r*row_offset() + c*col_offset()]
+            T* data() { return column(0); }
+            std::uint64_t row_offset() const { return 1; }
+            std::uint64_t col_offset() const { return stride; }
+
+            std::uint64_t rows() const { return _rows; }
+            std::uint64_t cols() const { return _cols; }
+
+            // reduce the number of rows stored in the header,
+            // e.g. when fewer rows than expected have been written
+            void truncate_rows(std::uint64_t rows) {
+                if (rows > _rows) {
+                    throw std::invalid_argument("Cannot increase the number of rows");
+                }
+                _rows = rows;
+                header().rows = rows;
+            }
+
+            void sync() { file.sync(); }
+        };
+
+        /**
+         * Read only access to a columnar file through mmap.
+         */
+        template <typename T>
+        class columnar_reader
+        {
+        private:
+            mapped_file file;
+            std::uint64_t _rows{}, _cols{}, stride{};
+
+            const T* base() const {
+                return reinterpret_cast<const T*>(file.data() + sizeof(columnar_header));
+            }
+
+        public:
+            explicit columnar_reader(const std::string& path) : file(path) {
+                using namespace std::literals;
+                if (file.size() < sizeof(columnar_header)) {
+                    throw std::runtime_error("'"s + path + "' is too small to be a columnar file"s);
+                }
+                columnar_header h;
+                std::memcpy(&h, file.data(), sizeof(h));
+                if (std::memcmp(h.magic, columnar_magic, sizeof(h.magic)) != 0) {
+                    throw std::runtime_error("'"s + path + "' is not a columnar file"s);
+                }
+                if (h.version != columnar_version) {
+                    throw std::runtime_error("Unsupported version "s + std::to_string(h.version) + " of '"s + path + "'"s);
+                }
+                if (h.type != dtype_of<T>()) {
+                    throw std::runtime_error("Type mismatch reading '"s + path + "'"s);
+                }
+                if (h.stride < h.rows || (h.cols && (file.size() - sizeof(h)) / sizeof(T) / h.cols < h.stride)) {
+                    throw std::runtime_error("'"s + path + "' is truncated"s);
+                }
+                _rows = h.rows;
+                _cols = h.cols;
+                stride = h.stride;
+                file.advise(0, file.size(), MADV_SEQUENTIAL);
+            }
+
+            std::uint64_t rows() const { return _rows; }
+            std::uint64_t cols() const { return _cols; }
+
+            const T* column(std::uint64_t c) const { return base() + c*stride; }
+
+            // rows [first, first+count) as a column-major chunk
+            statistics::matrix_chunk<T> chunk(std::uint64_t first, std::uint64_t count) const {
+                count = std::min(count, _rows - std::min(first, _rows));
+                return {base() + first, count, 1, stride};
+            }
+
+            // ask the kernel to start reading rows [first, first+count)
+            void prefetch(std::uint64_t first, std::uint64_t count) const {
+                count = std::min(count, _rows - std::min(first, _rows));
+                for (std::uint64_t c{}; c != _cols && count; ++c) {
+                    file.advise(sizeof(columnar_header) + (c*stride + first)*sizeof(T), count*sizeof(T), MADV_WILLNEED);
+                }
+            }
+
+            // call f(chunk) on consecutive chunks of chunk_rows rows,
+            // the next chunk is prefetched while f runs
+            template <typename F>
+            void for_each_chunk(std::uint64_t chunk_rows, F f) const {
+                if (chunk_rows == 0) {
+                    throw std::invalid_argument("chunk_rows must be at least 1");
+                }
+                prefetch(0, chunk_rows);
+                for (std::uint64_t first{}; first < _rows; first += chunk_rows) {
+                    prefetch(first + chunk_rows, chunk_rows);
+                    f(chunk(first, chunk_rows));
+                }
+            }
+
+            // feed all the rows to acc, chunk by chunk
+            auto& accumulate(statistics::multicolumn_pcc_accumulator<T>& acc, std::uint64_t chunk_rows = 1 << 16) const {
+                for_each_chunk(chunk_rows, [&](const statistics::matrix_chunk<T>& ch){
+                    acc.accumulate(ch.matrix, ch.rows, _cols, ch.row_offset, ch.col_offset);
+                });
+                return acc;
+            }
+
+            // same as accumulate() using a pool of threads
+            auto& parallel_accumulate(statistics::multicolumn_pcc_accumulator<T>& acc, std::uint64_t chunk_rows = 1 << 16, unsigned threads = 0) const {
+                if (chunk_rows == 0) {
+                    throw std::invalid_argument("chunk_rows must be at least 1");
+                }
+                const auto chunks = (_rows + chunk_rows - 1) / chunk_rows;
+                return statistics::parallel_accumulate(acc, chunks, [&](std::size_t i){
+                    prefetch((i+1)*chunk_rows, chunk_rows);
+                    return chunk(i*chunk_rows, chunk_rows);
+                }, threads);
+            }
+        };
+
+        /**
+         * Convert a delimited text file (one row per line) to the
+         * columnar format. The first header_lines lines are skipped
+         * and the number of columns is taken from the first data
+         * line. Values are parsed by convertions::parse_rows()
+         * directly into out_path + ".tmp", renamed to out_path on
+         * success and removed on error: out_path is never left
+         * truncated.
+         */
+        template <typename T>
+        inline std::uint64_t csv_to_columnar(const std::string& csv_path, const std::string& out_path, char delimiter = ',', std::size_t header_lines = 0) {
+            using namespace std::literals;
+            mapped_file csv(csv_path);
+            csv.advise(0, csv.size(), MADV_SEQUENTIAL);
+            std::string_view text(csv.data(), csv.size());
+            for (std::size_t h{}; h != header_lines && !text.empty(); ++h) {
+                const auto nl = text.find('\n');
+                text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+            }
+            // upper bound of the rows: the lines
+            std::uint64_t lines = std::count(text.begin(), text.end(), '\n');
+            if (!text.empty() && text.back() != '\n') {
+                ++lines;
+            }
+            const auto first_line = text.substr(0, text.find('\n'));
+            const std::uint64_t cols = first_line.empty() ? 0 : std::count(first_line.begin(), first_line.end(), delimiter) + 1;
+            const auto tmp = out_path + ".tmp";
+            std::uint64_t rows{};
+            try {
+                columnar_writer<T> out(tmp, lines, cols);
+                const auto status = convertions::parse_rows(text, delimiter, out.data(), cols, lines, out.row_offset(), out.col_offset());
+                if (!status) {
+                    throw std::runtime_error("Cannot convert '"s + csv_path + "': invalid value at line "s
+                        + std::to_string(status.line + header_lines) + ", column "s + std::to_string(status.column));
+                }
+                // blank lines are not rows
+                out.truncate_rows(status.rows);
+                out.sync();
+                rows = status.rows;
+            } catch (...) {
+                std::remove(tmp.c_str());
+                throw;
+            }
+            if (std::rename(tmp.c_str(), out_path.c_str()) != 0) {
+                const auto err = errno;
+                std::remove(tmp.c_str());
+                throw std::system_error(err, std::generic_category(), "cannot rename '" + tmp + "'");
+            }
+            return rows;
+        }
+
+    } // namespace io
+} // namespace math
+
+#endif
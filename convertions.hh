@@ -3,7 +3,16 @@
 #define CONVERTIONS
 
 #include <string>
+#include <string_view>
 #include <stdexcept>
+#include <charconv>
+#include <system_error>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "simd.hh"
 
 /**
  * This namespace contains a set of template
@@ -68,6 +77,261 @@ namespace math {
             return std::stoull(s);
         }
 
+        /**
+         * Locale independent parsing of numbers from text without
+         * allocations, based on std::from_chars. Leading and
+         * trailing blanks and a leading '+' are accepted, the same
+         * ranges of ston are enforced (e.g. unsigned int).
+         * Functions taking a T& never throw and report errors
+         * through std::errc.
+         */
+        template <typename T>
+        inline std::errc parse(std::string_view s, T& value) noexcept {
+            static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "parse supports only arithmetic types other than bool");
+            auto first = s.data();
+            auto last = first + s.size();
+            while (first != last && (*first == ' ' || *first == '\t')) {
+                ++first;
+            }
+            while (last != first && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r')) {
+                --last;
+            }
+            if (first != last && *first == '+') {
+                ++first;
+                if (first != last && *first == '-') {
+                    return std::errc::invalid_argument;
+                }
+            }
+            std::from_chars_result res;
+            if constexpr (std::is_same_v<T, unsigned int>) {
+                // as ston: read a long and check it fits
+                long cast{};
+                res = std::from_chars(first, last, cast);
+                if (res.ec == std::errc{} && cast != (unsigned int)cast) {
+                    return std::errc::result_out_of_range;
+                }
+                value = cast;
+            } else if constexpr (std::is_same_v<T, unsigned long> || std::is_same_v<T, unsigned long long>) {
+                // as std::stoul: a negative number is negated in T
+                const bool negative = first != last && *first == '-';
+                T tmp{};
+                res = std::from_chars(first + negative, last, tmp);
+                value = negative ? T{} - tmp : tmp;
+            } else if constexpr (std::is_floating_point_v<T>) {
+                res = std::from_chars(first, last, value, std::chars_format::general);
+            } else {
+                res = std::from_chars(first, last, value);
+            }
+            if (res.ec != std::errc{}) {
+                return res.ec;
+            }
+            // the whole field must be a number
+            return res.ptr == last ? std::errc{} : std::errc::invalid_argument;
+        }
+
+        // throwing version of parse(s, value), with the same
+        // exceptions of ston
+        template <typename T>
+        inline T parse(std::string_view s) {
+            using namespace std::literals;
+            T value{};
+            const auto ec = parse(s, value);
+            if (ec == std::errc::result_out_of_range) {
+                throw std::out_of_range("cannot cast '"s + std::string(s) + "': out of range"s);
+            }
+            if (ec != std::errc{}) {
+                throw std::invalid_argument("cannot cast '"s + std::string(s) + "' to a number"s);
+            }
+            return value;
+        }
+
+        namespace detail
+        {
+            // bit i is set if p[i] is d1 or d2, for 64 bytes
+            inline std::uint64_t mask_scalar(const char* p, char d1, char d2) {
+                std::uint64_t ans{};
+                for (int i{}; i != 64; ++i) {
+                    ans |= std::uint64_t(p[i] == d1 || p[i] == d2) << i;
+                }
+                return ans;
+            }
+
+#ifdef MATH_SIMD_X86
+            MATH_SIMD_TARGET("sse2")
+            inline std::uint64_t mask_sse2(const char* p, char d1, char d2) {
+                const auto v1 = _mm_set1_epi8(d1), v2 = _mm_set1_epi8(d2);
+                std::uint64_t ans{};
+                for (int i{}; i != 4; ++i) {
+                    const auto v = _mm_loadu_si128((const __m128i*)(p + 16*i));
+                    const auto m = _mm_or_si128(_mm_cmpeq_epi8(v, v1), _mm_cmpeq_epi8(v, v2));
+                    ans |= std::uint64_t((unsigned)_mm_movemask_epi8(m)) << (16*i);
+                }
+                return ans;
+            }
+
+            MATH_SIMD_TARGET("avx2")
+            inline std::uint64_t mask_avx2(const char* p, char d1, char d2) {
+                const auto v1 = _mm256_set1_epi8(d1), v2 = _mm256_set1_epi8(d2);
+                const auto lo = _mm256_loadu_si256((const __m256i*)p);
+                const auto hi = _mm256_loadu_si256((const __m256i*)(p + 32));
+                const auto m_lo = _mm256_or_si256(_mm256_cmpeq_epi8(lo, v1), _mm256_cmpeq_epi8(lo, v2));
+                const auto m_hi = _mm256_or_si256(_mm256_cmpeq_epi8(hi, v1), _mm256_cmpeq_epi8(hi, v2));
+                return std::uint64_t((unsigned)_mm256_movemask_epi8(m_lo)) | (std::uint64_t((unsigned)_mm256_movemask_epi8(m_hi)) << 32);
+            }
+#endif
+
+            inline std::uint64_t delimiter_mask(const char* p, char d1, char d2) {
+#ifdef MATH_SIMD_X86
+                switch (simd::active_isa()) {
+                case simd::isa::avx512:
+                case simd::isa::avx2:
+                    return mask_avx2(p, d1, d2);
+                case simd::isa::sse2:
+                    return mask_sse2(p, d1, d2);
+                default:
+                    break;
+                }
+#endif
+                return mask_scalar(p, d1, d2);
+            }
+
+            inline int lowest_bit(std::uint64_t m) {
+#if defined(__GNUC__) || defined(__clang__)
+                return __builtin_ctzll(m);
+#else
+                int i{};
+                while (!(m & 1)) {
+                    m >>= 1;
+                    ++i;
+                }
+                return i;
+#endif
+            }
+        } // namespace detail
+
+        // outcome of a bulk parse
+        struct parse_status {
+            std::errc ec{};             // first error, std::errc{} if none
+            std::size_t rows{};         // complete rows stored
+            std::size_t consumed{};     // bytes of text consumed (complete rows)
+            std::size_t line{};         // line of the error, from 0
+            std::size_t column{};       // column of the error, from 0
+
+            explicit operator bool() const { return ec == std::errc{}; }
+        };
+
+        /**
+         * Parse rows of cols fields separated by delimiter and
+         * terminated by '\n' (a '\r' before it is ignored) and
+         * store them in out, element (r,c) going to
+         * out[r*row_offset + c*col_offset], so both row-major and
+         * column-major buffers can be filled without copies.
+         * Delimiters are located with SIMD on 64 bytes blocks.
+         * At most max_rows rows are parsed, blank lines are
+         * skipped. If last_chunk is false a final line without
+         * '\n' is not parsed and it is left to the caller (see
+         * parse_status::consumed) so that text can be fed in
+         * chunks. It never throws.
+         */
+        template <typename T>
+        inline parse_status parse_rows(
+            std::string_view text, char delimiter,
+            T* out, std::size_t cols, std::size_t max_rows,
+            std::size_t row_offset, std::size_t col_offset,
+            bool last_chunk = true
+        ) noexcept {
+            parse_status status;
+            const auto begin = text.data();
+            const auto size = text.size();
+            std::size_t field{};    // start of the current field
+            std::size_t col{};      // current column
+            std::size_t lines{};
+            // handle the end of a field at position pos
+            auto end_field = [&](std::size_t pos, bool newline) -> bool {
+                const std::string_view f(begin + field, pos - field);
+                if (newline && col == 0 && f.find_first_not_of(" \t\r") == std::string_view::npos) {
+                    // blank line
+                    ++lines;
+                    field = pos + 1;
+                    status.consumed = field;
+                    return true;
+                }
+                if (col == cols || (newline && col+1 != cols)) {
+                    status.ec = std::errc::invalid_argument;
+                } else {
+                    status.ec = parse(f, out[status.rows*row_offset + col*col_offset]);
+                }
+                if (status.ec != std::errc{}) {
+                    status.line = lines;
+                    status.column = col;
+                    return false;
+                }
+                field = pos + 1;
+                if (newline) {
+                    ++status.rows;
+                    ++lines;
+                    col = 0;
+                    status.consumed = field;
+                } else {
+                    ++col;
+                }
+                return true;
+            };
+            if (cols == 0 || max_rows == 0) {
+                return status;
+            }
+            for (std::size_t block{}; block < size; block += 64) {
+                std::uint64_t mask;
+                if (block + 64 <= size) {
+                    mask = detail::delimiter_mask(begin + block, delimiter, '\n');
+                } else {
+                    // last partial block, padded
+                    char tmp[64]{};
+                    std::memcpy(tmp, begin + block, size - block);
+                    mask = detail::delimiter_mask(tmp, delimiter, '\n') & ((std::uint64_t(1) << (size - block)) - 1);
+                }
+                while (mask) {
+                    const auto pos = block + detail::lowest_bit(mask);
+                    mask &= mask - 1;
+                    if (!end_field(pos, begin[pos] == '\n')) {
+                        return status;
+                    }
+                    if (status.rows == max_rows) {
+                        return status;
+                    }
+                }
+            }
+            // last line without '\n'
+            if (last_chunk && field < size) {
+                end_field(size, true);
+            }
+            return status;
+        }
+
+        // parse exactly count fields of a single line into
+        // out[0], out[stride], ... It never throws.
+        template <typename T>
+        inline parse_status parse_fields(std::string_view line, char delimiter, T* out, std::size_t count, std::size_t stride = 1) noexcept {
+            auto status = parse_rows(line, delimiter, out, count, 1, 0, stride);
+            if (status && status.rows != 1) {
+                status.ec = std::errc::invalid_argument;
+            }
+            return status;
+        }
+
+        // throw the exception corresponding to a failed bulk parse
+        inline void throw_if_error(const parse_status& status) {
+            using namespace std::literals;
+            if (status) {
+                return;
+            }
+            const auto where = " at line "s + std::to_string(status.line) + ", column "s + std::to_string(status.column);
+            if (status.ec == std::errc::result_out_of_range) {
+                throw std::out_of_range("value out of range"s + where);
+            }
+            throw std::invalid_argument("invalid value"s + where);
+        }
+
     } // namespace convertions
 } // namespace math
 
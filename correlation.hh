@@ -3,18 +3,150 @@
 #define CORRELATION
 
 #include <cmath>
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 #include <stdexcept>
 #include <string>
 #include <map>
 #include <utility>
 #include <valarray>
+#include <algorithm>
+#include <array>
+#include <limits>
+
+#include "couple.hh"
+#include "covariance_kernel.hh"
+#include "instrumentation.hh"
+#include "pcc_kernel.hh"
 
 namespace math
 {
+    namespace io
+    {
+        // access to the state of the accumulators, see serialization.hh
+        struct state_access;
+    }
+
     namespace statistics
     {
 
+        namespace detail
+        {
+#ifdef __SIZEOF_INT128__
+            using wide_integer = __int128;
+#else
+            using wide_integer = long long;
+#endif
+        } // namespace detail
+
+        // Types used to accumulate the sums of a series of T and
+        // to return its coefficients. Floating point series use T
+        // for both, integer series up to 32 bits accumulate
+        // exactly in integers and are converted to double only
+        // when the coefficients are computed (see exact_rows for
+        // the number of rows). 64 bit integer series are out of
+        // scope: they accumulate in T, as they always did, and the
+        // sums overflow as soon as they exceed its range.
+        template <typename T, typename = void>
+        struct accumulation_traits {
+            using accumulator_type = T;
+            using result_type = T;
+        };
+
+        template <typename T>
+        struct accumulation_traits<T, std::enable_if_t<std::is_integral_v<T>>> {
+            // squares of 16 bits are at most 2^30 (2^32 unsigned),
+            // 64 bits hold the sums of 2^33 rows (2^31). Squares of
+            // 32 bits in 128 bits hold more rows than exact_rows
+            // (long double, not exact, without 128 bit integers)
+            using accumulator_type = std::conditional_t<(sizeof(T) <= 2), std::int64_t,
+                std::conditional_t<(sizeof(T) > 4), T,
+                std::conditional_t<(sizeof(detail::wide_integer) > 8), detail::wide_integer, long double>>>;
+            using result_type = double;
+        };
+
+        namespace detail
+        {
+            // Number of rows for which the sums of a series of T
+            // are exact: they fit in the accumulator, squares are
+            // below 2^(2*digits), and the centered sums of
+            // integer_pcc fit in wide_integer. With |values| <= m,
+            // |n*sum_prod| and |sum_1*sum_2| are at most (n*m)^2,
+            // so their difference fits while 2*(n*m)^2 < 2^(bits-1),
+            // that is n*m < 2^(bits/2 - 1).
+            // Beyond it (2^33 rows for int16) the accumulators of
+            // 16 bit series overflow too and nothing is exact.
+            template <typename T>
+            constexpr long long exact_rows() {
+                using A = typename accumulation_traits<T>::accumulator_type;
+                constexpr int digits = std::numeric_limits<T>::digits;
+                constexpr int exponent = std::min(int(4*sizeof(wide_integer)) - 1 - digits, int(8*sizeof(A)) - 1 - 2*digits);
+                if constexpr (exponent <= 0 || sizeof(T) > 4 || std::is_floating_point_v<A>) {
+                    return 0;
+                } else {
+                    return 1LL << std::min(exponent, 62);
+                }
+            }
+
+            // Coefficient from integer sums of a series of T: below
+            // exact_rows<T>() (2^32 rows for int32, 2^31 for uint32)
+            // the centered sums n*sum_prod - sum_1*sum_2
+            // etc. are computed exactly and rounded only once,
+            // above (and for 64 bit integers) in long double.
+            template <typename T, typename R, typename A>
+            inline R integer_pcc(long long count, A sum_1, A sum_2, A sum_1_squared, A sum_2_squared, A sum_prod) {
+                if (count < exact_rows<T>()) {
+                    using W = wide_integer;
+                    const W n = count;
+                    const W num = n*W(sum_prod) - W(sum_1)*W(sum_2);
+                    const W d_1 = n*W(sum_1_squared) - W(sum_1)*W(sum_1);
+                    const W d_2 = n*W(sum_2_squared) - W(sum_2)*W(sum_2);
+                    const R den = R(d_1)*R(d_2);
+                    return den ? R(num) / std::sqrt(den) : 0;
+                }
+                using L = long double;
+                const L n = count;
+                const L num = L(sum_prod) - L(sum_1)*L(sum_2) / n;
+                const L den = (L(sum_1_squared) - L(sum_1)*L(sum_1) / n) * (L(sum_2_squared) - L(sum_2)*L(sum_2) / n);
+                return den > 0 ? R(num / std::sqrt(den)) : 0;
+            }
+
+            // integer_pcc of all the pairs of N columns in couple
+            // order, the deviation of each column computed once
+            template <typename T, typename R, typename A>
+            inline void integer_pcc_triangle(int N, long long count, const A* totals, const A* squared_totals, const A* covariance, R* out) {
+                std::vector<R> deviations(N);
+                if (count < exact_rows<T>()) {
+                    using W = wide_integer;
+                    const W n = count;
+                    for (int c{}; c != N; ++c) {
+                        deviations[c] = R(n*W(squared_totals[c]) - W(totals[c])*W(totals[c]));
+                    }
+                    for (int i{}; i < N-1; ++i) {
+                        for (int j{i+1}; j != N; ++j) {
+                            const R num = R(n*W(*covariance++) - W(totals[i])*W(totals[j]));
+                            const R den = deviations[i]*deviations[j];
+                            *out++ = den ? num / std::sqrt(den) : 0;
+                        }
+                    }
+                    return;
+                }
+                using L = long double;
+                const L n = count;
+                for (int c{}; c != N; ++c) {
+                    deviations[c] = R(L(squared_totals[c]) - L(totals[c])*L(totals[c]) / n);
+                }
+                for (int i{}; i < N-1; ++i) {
+                    for (int j{i+1}; j != N; ++j) {
+                        const R num = R(L(*covariance++) - L(totals[i])*L(totals[j]) / n);
+                        const R den = deviations[i]*deviations[j];
+                        *out++ = den > 0 ? num / std::sqrt(den) : 0;
+                    }
+                }
+            }
+        } // namespace detail
+
         // This call willl be used to store partial
         // results of calculus of Pearson Correlation
         // Coefficient on large datasets:
@@ -22,6 +154,8 @@ namespace math
         template <typename T = double>
         struct pcc_partial {
             using value_type = T;
+            using accumulator_type = typename accumulation_traits<T>::accumulator_type;
+            using result_type = typename accumulation_traits<T>::result_type;
 
             pcc_partial() = default;
             pcc_partial(const pcc_partial<value_type>&) = default;
@@ -46,20 +180,43 @@ namespace math
                 return ans;
             }
 
+            // inverse of operator+=, remove the contribution of
+            // p which must have been previously added
+            auto& operator-=(const pcc_partial<value_type>& p) {
+                this->count -= p.count;
+                this->sum_1 -= p.sum_1;
+                this->sum_2 -= p.sum_2;
+                this->sum_1_squared -= p.sum_1_squared;
+                this->sum_2_squared -= p.sum_2_squared;
+                this->sum_prod -= p.sum_prod;
+                return *this;
+            }
+
+            auto operator-(const pcc_partial<value_type>& p) const {
+                auto ans = *this;
+                ans -= p;
+                return ans;
+            }
+
             // Calculate the Pearson Correlation Coefficient
             // with the accumulated data
-            auto compute() const -> value_type {
+            auto compute() const -> result_type {
                 if (count == 0) {
                     return 0;
                 }
-                const auto num = ( sum_prod - (sum_1*sum_2)/count );
-                const auto den = (sum_1_squared - (sum_1*sum_1 / count)) * (sum_2_squared - (sum_2*sum_2 / count));
-                // check for div by 0
-                return den ?  num / std::sqrt( den ) : 0;
+                if constexpr (std::is_integral_v<value_type>) {
+                    return detail::integer_pcc<value_type, result_type>(count, sum_1, sum_2, sum_1_squared, sum_2_squared, sum_prod);
+                } else {
+                    const auto num = ( sum_prod - (sum_1*sum_2)/count );
+                    const auto den = (sum_1_squared - (sum_1*sum_1 / count)) * (sum_2_squared - (sum_2*sum_2 / count));
+                    // check for div by 0
+                    return den ?  num / std::sqrt( den ) : 0;
+                }
             }
 
             // Fastest way to add two more elements
-            auto& accumulate(value_type v_1, value_type v_2) {
+            auto& accumulate(value_type value_1, value_type value_2) {
+                const accumulator_type v_1 = value_1, v_2 = value_2;
                 this->sum_1 += v_1;
                 this->sum_2 += v_2;
                 this->sum_1_squared += v_1*v_1;
@@ -69,14 +226,45 @@ namespace math
                 return *this;
             }
 
+            // inverse of accumulate(), remove two elements
+            // previously added
+            auto& remove(value_type value_1, value_type value_2) {
+                const accumulator_type v_1 = value_1, v_2 = value_2;
+                this->sum_1 -= v_1;
+                this->sum_2 -= v_2;
+                this->sum_1_squared -= v_1*v_1;
+                this->sum_2_squared -= v_2*v_2;
+                this->sum_prod -= v_1*v_2;
+                --this->count;
+                return *this;
+            }
+
             long long count{};
-            value_type sum_1{};
-            value_type sum_2{};
-            value_type sum_1_squared{};
-            value_type sum_2_squared{};
-            value_type sum_prod{};
+            accumulator_type sum_1{};
+            accumulator_type sum_2{};
+            accumulator_type sum_1_squared{};
+            accumulator_type sum_2_squared{};
+            accumulator_type sum_prod{};
         };
 
+        namespace detail
+        {
+            // float, double and int16 series go through the vectorized kernels
+            template <typename T>
+            inline pcc_partial<T> pcc_from_kernel(const T* v1, const T* v2, std::size_t size, std::size_t scatter) {
+                typename pcc_partial<T>::accumulator_type sums[5];
+                kernels::pcc_sums(v1, v2, size, scatter, sums);
+                pcc_partial<T> ans;
+                ans.count = size;
+                ans.sum_1 = sums[0];
+                ans.sum_2 = sums[1];
+                ans.sum_1_squared = sums[2];
+                ans.sum_2_squared = sums[3];
+                ans.sum_prod = sums[4];
+                return ans;
+            }
+        } // namespace detail
+
         template <typename T, typename R = T>
         inline pcc_partial<R> pearson_correlation_coefficient(const std::vector<T>& v1, const std::vector<T>& v2) {
             using namespace std::literals;
@@ -84,9 +272,16 @@ namespace math
             if (v1.size() != v2.size()) {
                 throw std::invalid_argument("Arguments must have the same length, found len(v1)="s + std::to_string(v1.size()) + ", len(v2)=" + std::to_string(v2.size()));
             }
+            MATH_INSTRUMENT_PHASE(pcc);
+            MATH_INSTRUMENT_ADD(pcc_elements, v1.size());
+            MATH_INSTRUMENT_ADD(pcc_bytes, 2*v1.size()*sizeof(T));
+            if constexpr (kernels::has_pcc_kernel<T, R>) {
+                return detail::pcc_from_kernel(v1.data(), v2.data(), v1.size(), 1);
+            }
+            using A = typename pcc_partial<R>::accumulator_type;
             for (decltype(v1.size()) i{}; i!=v1.size(); ++i) {
-                const auto v_1 = v1[i];
-                const auto v_2 = v2[i];
+                const A v_1 = v1[i];
+                const A v_2 = v2[i];
                 ans.sum_1 += v_1;
                 ans.sum_2 += v_2;
                 ans.sum_1_squared += v_1*v_1;
@@ -100,9 +295,16 @@ namespace math
         template <typename T, typename R = T>
         inline pcc_partial<R> pearson_correlation_coefficient(const T* v1, const T* v2, std::size_t size) {
             pcc_partial<R> ans;
+            MATH_INSTRUMENT_PHASE(pcc);
+            MATH_INSTRUMENT_ADD(pcc_elements, size);
+            MATH_INSTRUMENT_ADD(pcc_bytes, 2*size*sizeof(T));
+            if constexpr (kernels::has_pcc_kernel<T, R>) {
+                return detail::pcc_from_kernel(v1, v2, size, 1);
+            }
+            using A = typename pcc_partial<R>::accumulator_type;
             for (decltype(size) i{}; i!=size; ++i) {
-                const auto v_1 = v1[i];
-                const auto v_2 = v2[i];
+                const A v_1 = v1[i];
+                const A v_2 = v2[i];
                 ans.sum_1 += v_1;
                 ans.sum_2 += v_2;
                 ans.sum_1_squared += v_1*v_1;
@@ -121,9 +323,16 @@ namespace math
             if (scatter == 0) {
                 throw std::invalid_argument("Scatter must be graeter than 0");
             }
+            MATH_INSTRUMENT_PHASE(pcc);
+            MATH_INSTRUMENT_ADD(pcc_elements, size);
+            MATH_INSTRUMENT_ADD(pcc_bytes, 2*size*sizeof(T));
+            if constexpr (kernels::has_pcc_kernel<T, R>) {
+                return detail::pcc_from_kernel(v1, v2, size, scatter);
+            }
+            using A = typename pcc_partial<R>::accumulator_type;
             for (decltype(size) i{}; i!=size; ++i) {
-                const auto v_1 = v1[i*scatter];
-                const auto v_2 = v2[i*scatter];
+                const A v_1 = v1[i*scatter];
+                const A v_2 = v2[i*scatter];
                 ans.sum_1 += v_1;
                 ans.sum_2 += v_2;
                 ans.sum_1_squared += v_1*v_1;
@@ -134,60 +343,218 @@ namespace math
             return ans;
         }
 
+        // Pearson Correlation Coefficients of all the pairs of
+        // N columns, stored contiguously as a packed upper triangle
+        // in the same order of math::sets::couple:
+        //  (0,1) (0,2) ... (0,N-1) (1,2) ... (N-2,N-1)
+        template <typename T = double>
+        class correlation_matrix {
+        public:
+            using value_type = T;
+        private:
+            int N;
+            std::vector<value_type> values;
+        public:
+            correlation_matrix(int N)
+            : N{N}, values(N > 1 ? std::size_t(N)*(N-1)/2 : 0)
+            {}
+
+            int columns() const { return N; }
+            // number of pairs
+            std::size_t size() const { return values.size(); }
+
+            // position of the pair (i,j), i != j, in the triangle
+            std::size_t index(int i, int j) const {
+                if (i > j) {
+                    std::swap(i, j);
+                }
+                return kernels::pair_index(N, i, j);
+            }
+
+            // coefficient of the columns i and j, i != j
+            value_type operator()(int i, int j) const {
+                return values[index(i, j)];
+            }
+
+            // checked version of operator()
+            value_type at(int i, int j) const {
+                if (i < 0 || j < 0 || N <= i || N <= j || i == j) {
+                    using namespace std::literals;
+                    throw std::out_of_range("Invalid pair ("s + std::to_string(i) + ","s + std::to_string(j) + ") for "s + std::to_string(N) + " columns"s);
+                }
+                return (*this)(i, j);
+            }
+
+            // access by position in the triangle
+            value_type operator[](std::size_t idx) const { return values[idx]; }
+            value_type& operator[](std::size_t idx) { return values[idx]; }
+
+            value_type* data() { return values.data(); }
+            const value_type* data() const { return values.data(); }
+
+            auto begin() const { return values.begin(); }
+            auto end() const { return values.end(); }
+        };
+
+        // Pearson Correlation Coefficients between N columns of
+        // a set X and M columns of a set Y, stored row-major:
+        // the pair (i,j) is at position i*M + j
+        template <typename T = double>
+        class cross_correlation_matrix {
+        public:
+            using value_type = T;
+        private:
+            int N, M;
+            std::vector<value_type> values;
+        public:
+            cross_correlation_matrix(int N, int M)
+            : N{N}, M{M}, values(std::size_t(std::max(N, 0))*std::max(M, 0))
+            {}
+
+            // columns of X
+            int rows() const { return N; }
+            // columns of Y
+            int columns() const { return M; }
+            // number of pairs
+            std::size_t size() const { return values.size(); }
+
+            std::size_t index(int i, int j) const {
+                return std::size_t(i)*M + j;
+            }
+
+            // coefficient of the column i of X and j of Y
+            value_type operator()(int i, int j) const {
+                return values[index(i, j)];
+            }
+
+            // checked version of operator()
+            value_type at(int i, int j) const {
+                if (i < 0 || j < 0 || N <= i || M <= j) {
+                    using namespace std::literals;
+                    throw std::out_of_range("Invalid pair ("s + std::to_string(i) + ","s + std::to_string(j) + ") for "s + std::to_string(N) + "x"s + std::to_string(M) + " columns"s);
+                }
+                return (*this)(i, j);
+            }
+
+            value_type operator[](std::size_t idx) const { return values[idx]; }
+            value_type& operator[](std::size_t idx) { return values[idx]; }
+
+            value_type* data() { return values.data(); }
+            const value_type* data() const { return values.data(); }
+
+            auto begin() const { return values.begin(); }
+            auto end() const { return values.end(); }
+        };
+
+        // number of columns known only at run time
+        constexpr int dynamic_columns = -1;
+
+        // multicolumn_pcc_accumulator<T> takes the number of
+        // columns at run time, multicolumn_pcc_accumulator<T, N>
+        // fixes it at compile time
+        template <typename T = double, int Columns = dynamic_columns>
+        class multicolumn_pcc_accumulator;
+
         // This class has been conceived to easily
         // calculate PCC on all pairs of columns in
         // a large dataset
-        template <typename T = double>
-        class multicolumn_pcc_accumulator {
+        template <typename T>
+        class multicolumn_pcc_accumulator<T, dynamic_columns> {
         public:
             using value_type = T;
+            // exact integers for integer columns, see accumulation_traits
+            using accumulator_type = typename accumulation_traits<T>::accumulator_type;
+            using result_type = typename accumulation_traits<T>::result_type;
         private:
-            // number of columns to analyze
-            const int N;
+            template <typename, int>
+            friend class multicolumn_pcc_accumulator;
+            friend struct io::state_access;
+
+            // number of columns to analyze, changed only by
+            // add_columns() and remove_columns()
+            int N;
             // it is unnecessary to calculate the mean and the
             // mean of the squared values of each column once per
             // pair of columns; it is sufficient to calculate it
             // just once per column.
             // for each column
-            std::valarray<value_type> totals;           // sum of element in each column
-            std::valarray<value_type> squared_totals;   // sum of squared element in each column
+            std::valarray<accumulator_type> totals;           // sum of element in each column
+            std::valarray<accumulator_type> squared_totals;   // sum of squared element in each column
             // for each pair of columns - (0,1) (0,2) (0,3) (1,2) (1,3) (2,3)
-            std::valarray<value_type> covariance_total;
+            std::valarray<accumulator_type> covariance_total;
             long long int count{};  // total number of rows
         public:
             multicolumn_pcc_accumulator(int N)
-            : N{N}, totals(N), squared_totals(N), covariance_total((N-1)*N/2)
+            : N{N}, totals(std::max(N, 0)), squared_totals(std::max(N, 0)), covariance_total(N > 1 ? std::size_t(N)*(N-1)/2 : 0)
             {
                 if (N < 2) {
                     using namespace std::literals;
-                    std::invalid_argument("N must be at least 2, found "s + std::to_string(N));
+                    throw std::invalid_argument("N must be at least 2, found "s + std::to_string(N));
                 }
             }
 
-            // count a single row
-            auto& accumulate(const std::vector<value_type>& row) {
-                if (row.size() != N) {
+        private:
+            void check_row(const std::vector<value_type>& row) const {
+                if (row.size() != (std::size_t)N) {
                     using namespace std::literals;
                     throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(N) + " found "s + std::to_string(row.size()));
                 }
+            }
+
+            // add (or subtract) the contributions of a row
+            template <bool Subtract>
+            void update_row(const value_type* row) {
                 auto covariance_iterator = std::begin(covariance_total);
-                // first column
-                for (int i{}; i!=N-1; ++i) {
-                    const auto tmp = row[i];
+                for (int i{}; i!=N; ++i) {
+                    const accumulator_type tmp = Subtract ? -accumulator_type(row[i]) : accumulator_type(row[i]);
                     totals[i] += tmp;
-                    squared_totals[i] += tmp*tmp;
+                    squared_totals[i] += tmp*accumulator_type(row[i]);
                     for (int j{i+1}; j!=N; ++j) {
-                        *covariance_iterator += tmp*row[j];
+                        *covariance_iterator += tmp*accumulator_type(row[j]);
                         ++covariance_iterator;
                     }
                 }
-                const auto tmp = row[N-1];
-                totals[N-1] = tmp;
-                squared_totals[N-1] = tmp*tmp;
+            }
+
+        public:
+
+            // count a single row
+            auto& accumulate(const std::vector<value_type>& row) {
+                check_row(row);
+                return accumulate_row(row.data());
+            }
+
+            // count a single row given as pointer and size
+            auto& accumulate(const value_type* row, std::size_t size) {
+                if (size != (std::size_t)N) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(N) + " found "s + std::to_string(size));
+                }
+                return accumulate_row(row);
+            }
+
+            // remove a single row previously counted
+            auto& remove(const std::vector<value_type>& row) {
+                check_row(row);
+                return remove_row(row.data());
+            }
+
+            // count a single row of N elements
+            auto& accumulate_row(const value_type* row) {
+                MATH_INSTRUMENT_ADD(rows_ingested, 1);
+                MATH_INSTRUMENT_ADD(bytes_ingested, N*sizeof(value_type));
+                update_row<false>(row);
                 ++count;
                 return *this;
             }
 
+            // remove a single row of N elements previously counted
+            auto& remove_row(const value_type* row) {
+                update_row<true>(row);
+                --count;
+                return *this;
+            }
+
             // 
             auto& accumulate(
                 const value_type* matrix,   // matrix containing the chunk to analyze
@@ -202,72 +569,63 @@ namespace math
                     using namespace std::literals;
                     throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(N) + " found "s + std::to_string(cols));
                 }
-                // offset between same index
-                // elements of two adjacent column
-                //const auto col_offset = /*sizeof(value_type) */ (by_columns ? rows : 1);
-                // offset between same index
-                // elements of two adjacent rows
-                //const auto row_offset = /*sizeof(value_type) */ (by_columns ? 1 : cols);
-                {
-                    auto column = matrix; // pointer to first element of next column
-                    // for each column
-                    for (std::size_t c{}; c!=cols; ++c) {
-                        // accumulators
-                        value_type tot{};   // sum(row)
-                        value_type tot2{};  // sum(row.^2)
-                        auto row = column;    // point to first element of the column
-                        // for each row
-                        for (std::size_t r{}; r!=rows; ++r) {
-                            const auto tmp = *row;
-                            tot += tmp;
-                            tot2 += tmp*tmp;
-                            // point to next row
-                            row += row_offset;
-                        }
-                        // store partials - once to limit memory deferencing
-                        totals[c] += tot;
-                        squared_totals[c] += tot2;
-                        // point to next column
-                        column += col_offset;
-                    }
-                }
-                // for each couple of columns
-                {
-                    std::size_t couple_idx {};
-                    // ptr to c1
-                    auto column1 = matrix;
-                    for (std::size_t c1{}; c1 != cols; ++c1) {
-                        // ptr to c2
-                        auto column2 = column1 + col_offset;
-                        for (std::size_t c2{c1+1}; c2 != cols; ++c2) {
-                            // accumulator
-                            value_type cross{};
-                            // for each couple (col1[i],col2[i])
-                            auto row1 = column1;
-                            auto row2 = column2;
-                            for (std::size_t r{}; r!=rows; ++r) {
-                                cross += (*row1)*(*row2);
-                                // next pair
-                                row1 += row_offset;
-                                row2 += row_offset;
-                            }
-                            // store partial
-                            covariance_total[couple_idx++] += cross;   
-                            column2 += col_offset;
-                        }
-                        column1 += col_offset;
-                    }
-                }
+                // columns are processed in groups packed in contiguous
+                // panels and multiplied by a register blocked kernel,
+                // column sums are collected while packing
+                accumulate_groups(matrix, rows, cols, row_offset, col_offset, 0, kernels::groups(cols));
                 // +rows rows to be considered to calculate means
+                return commit_rows(rows);
+            }
+
+            // Split version of accumulate(matrix, ...): update only the
+            // columns in the groups [g_begin,g_end) (of kernels::width
+            // columns each, see kernels::groups) and the pairs starting
+            // with one of them. Calls on disjoint ranges of groups
+            // touch disjoint data and can run concurrently.
+            // Once all the groups of a chunk are done commit_rows()
+            // must be called once with the number of rows of the chunk.
+            auto& accumulate_groups(
+                const value_type* matrix,
+                std::size_t rows,
+                std::size_t cols,
+                std::size_t row_offset,
+                std::size_t col_offset,
+                std::size_t g_begin,
+                std::size_t g_end
+            ) {
+                if (cols != (decltype(cols))N) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(N) + " found "s + std::to_string(cols));
+                }
+                g_end = std::min(g_end, kernels::groups(cols));
+                MATH_INSTRUMENT_PHASE(kernel);
+                // every column is read by the call of its own group
+                MATH_INSTRUMENT_ADD(bytes_ingested, g_begin < g_end ? rows*(std::min(g_end*kernels::width, cols) - g_begin*kernels::width)*sizeof(value_type) : 0);
+                kernels::syrk(
+                    matrix, rows, cols, row_offset, col_offset, g_begin, g_end,
+                    std::begin(covariance_total), std::begin(totals), std::begin(squared_totals)
+                );
+                return *this;
+            }
+
+            auto& commit_rows(std::size_t rows) {
+                MATH_INSTRUMENT_ADD(rows_ingested, rows);
                 count += rows;
                 return *this;
             }
 
+            // number of columns
+            int columns() const { return N; }
+            // number of rows accumulated so far
+            long long int rows() const { return count; }
+
             auto& operator+=(const multicolumn_pcc_accumulator<T>& o) {
                 if (N != o.N) {
                     using namespace std::literals;
                     throw std::runtime_error("Size mismatch, this->N = "s + std::to_string(N) + ", other.N = "s + std::to_string(o.N));
                 }
+                MATH_INSTRUMENT_PHASE(merge);
+                MATH_INSTRUMENT_ADD(merges, 1);
                 //partials += o.partials;
                 totals += o.totals;
                 squared_totals += o.squared_totals;
@@ -276,6 +634,174 @@ namespace math
                 return *this;
             }
 
+            // add a fixed size accumulator
+            template <int Columns>
+            auto& operator+=(const multicolumn_pcc_accumulator<T, Columns>& o) {
+                if (N != Columns) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Size mismatch, this->N = "s + std::to_string(N) + ", other.N = "s + std::to_string(Columns));
+                }
+                MATH_INSTRUMENT_PHASE(merge);
+                MATH_INSTRUMENT_ADD(merges, 1);
+                for (int c{}; c != N; ++c) {
+                    totals[c] += o.totals[c];
+                    squared_totals[c] += o.squared_totals[c];
+                }
+                for (std::size_t k{}; k != o.covariance_total.size(); ++k) {
+                    covariance_total[k] += o.covariance_total[k];
+                }
+                count += o.count;
+                return *this;
+            }
+
+            // inverse of operator+=
+            auto& operator-=(const multicolumn_pcc_accumulator<T>& o) {
+                if (N != o.N) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Size mismatch, this->N = "s + std::to_string(N) + ", other.N = "s + std::to_string(o.N));
+                }
+                MATH_INSTRUMENT_PHASE(merge);
+                MATH_INSTRUMENT_ADD(merges, 1);
+                totals -= o.totals;
+                squared_totals -= o.squared_totals;
+                covariance_total -= o.covariance_total;
+                count -= o.count;
+                return *this;
+            }
+
+            // forget all the rows counted so far
+            auto& reset() {
+                totals = 0;
+                squared_totals = 0;
+                covariance_total = 0;
+                count = 0;
+                return *this;
+            }
+
+            // Drop the given columns, the others keep their order
+            // and the pairs their values. One pass over the triangle
+            // into a single new allocation.
+            auto& remove_columns(const std::vector<int>& columns) {
+                using namespace std::literals;
+                std::vector<char> keep(N, 1);
+                for (auto c : columns) {
+                    if (c < 0 || N <= c) {
+                        throw std::out_of_range("Invalid column "s + std::to_string(c) + " for "s + std::to_string(N) + " columns"s);
+                    }
+                    keep[c] = 0;
+                }
+                const int kept = std::count(keep.begin(), keep.end(), 1);
+                if (kept < 2) {
+                    throw std::invalid_argument("At least 2 columns must remain, found "s + std::to_string(kept));
+                }
+                std::valarray<accumulator_type> t(kept), sq(kept), cov(std::size_t(kept)*(kept-1)/2);
+                auto out = std::begin(cov);
+                auto in = std::begin(covariance_total);
+                for (int i{}, k{}; i != N; ++i) {
+                    if (!keep[i]) {
+                        in += N-1-i;
+                        continue;
+                    }
+                    t[k] = totals[i];
+                    sq[k] = squared_totals[i];
+                    ++k;
+                    for (int j{i+1}; j != N; ++j, ++in) {
+                        if (keep[j]) {
+                            *out++ = *in;
+                        }
+                    }
+                }
+                totals = std::move(t);
+                squared_totals = std::move(sq);
+                covariance_total = std::move(cov);
+                N = kept;
+                return *this;
+            }
+
+            // Append K new columns without replaying the existing
+            // pairs: only the sums of the new columns and their
+            // products with all the columns are computed, that is
+            // O(rows*(N+K)*K) instead of O(rows*(N+K)^2).
+            // old_columns must hold the same rows counted so far
+            // (rows == rows()) for the current N columns, in order,
+            // new_columns the K new ones, which take the indices
+            // [N,N+K).
+            auto& add_columns(
+                const value_type* old_columns, std::size_t old_row_offset, std::size_t old_col_offset,
+                const value_type* new_columns, std::size_t K, std::size_t new_row_offset, std::size_t new_col_offset,
+                std::size_t rows
+            ) {
+                if (rows != (std::size_t)count) {
+                    using namespace std::literals;
+                    throw std::runtime_error("The history must contain all the "s + std::to_string(count) + " rows counted, found "s + std::to_string(rows));
+                }
+                if (K == 0) {
+                    return *this;
+                }
+                if (K > std::size_t(std::numeric_limits<int>::max() - N)) {
+                    using namespace std::literals;
+                    throw std::invalid_argument("Cannot add "s + std::to_string(K) + " columns to "s + std::to_string(N) + ", more than INT_MAX columns"s);
+                }
+                MATH_INSTRUMENT_PHASE(kernel);
+                MATH_INSTRUMENT_ADD(bytes_ingested, rows*(N + K)*sizeof(value_type));
+                // products old x new (N x K) and new x new (K x K),
+                // sums of the new columns; integers are exact in
+                // the gemm kernel, both use its thread_local panels
+                std::vector<accumulator_type> old_new(N*K), new_new(K*K), sums(K);
+                kernels::gemm(
+                    old_columns, N, old_row_offset, old_col_offset,
+                    new_columns, K, new_row_offset, new_col_offset,
+                    rows, old_new.data(), (accumulator_type*)nullptr, (accumulator_type*)nullptr
+                );
+                std::vector<accumulator_type> new_totals(2*K), new_squared(2*K);
+                kernels::gemm(
+                    new_columns, K, new_row_offset, new_col_offset,
+                    new_columns, K, new_row_offset, new_col_offset,
+                    rows, new_new.data(), new_totals.data(), new_squared.data()
+                );
+                std::copy(new_totals.begin(), new_totals.begin() + K, sums.begin());
+                // new triangle in couple order, single allocation
+                const int M = N + int(K);
+                std::valarray<accumulator_type> t(M), sq(M), cov(std::size_t(M)*(M-1)/2);
+                auto out = std::begin(cov);
+                auto in = std::begin(covariance_total);
+                for (int i{}; i != M; ++i) {
+                    if (i < N) {
+                        t[i] = totals[i];
+                        sq[i] = squared_totals[i];
+                        out = std::copy(in, in + (N-1-i), out);
+                        in += N-1-i;
+                        out = std::copy(old_new.begin() + i*K, old_new.begin() + (i+1)*K, out);
+                    } else {
+                        const auto k = i - N;
+                        t[i] = sums[k];
+                        sq[i] = new_new[k*K + k];
+                        out = std::copy(new_new.begin() + k*K + k+1, new_new.begin() + (k+1)*K, out);
+                    }
+                }
+                totals = std::move(t);
+                squared_totals = std::move(sq);
+                covariance_total = std::move(cov);
+                N = M;
+                return *this;
+            }
+
+            // history as a single matrix: the current N columns
+            // followed by the cols - N new ones
+            auto& add_columns(
+                const value_type* matrix,
+                std::size_t rows,
+                std::size_t cols,
+                std::size_t row_offset,
+                std::size_t col_offset
+            ) {
+                if (cols < (std::size_t)N) {
+                    using namespace std::literals;
+                    throw std::runtime_error("The history must contain at least the "s + std::to_string(N) + " current columns, found "s + std::to_string(cols));
+                }
+                return add_columns(matrix, row_offset, col_offset, matrix + N*col_offset, cols - N, row_offset, col_offset, rows);
+            }
+
             auto operator+(const multicolumn_pcc_accumulator& o) const {
                 if (N != o.N) {
                     using namespace std::literals;
@@ -286,6 +812,18 @@ namespace math
                 return ans;
             }
 
+            // partial of the pair (i,j), i < j
+            pcc_partial<value_type> partial(int i, int j) const {
+                pcc_partial<value_type> ans;
+                ans.count = count;
+                ans.sum_1 = totals[i];
+                ans.sum_2 = totals[j];
+                ans.sum_1_squared = squared_totals[i];
+                ans.sum_2_squared = squared_totals[j];
+                ans.sum_prod = covariance_total[kernels::pair_index(N, i, j)];
+                return ans;
+            }
+
             // convert content to valarray of pcc_partial to adapt to
             // existing code.
             std::valarray<pcc_partial<value_type>> to_pcc_partial_valarray() const {
@@ -310,22 +848,600 @@ namespace math
                 return ans;
             }
 
+            // Coefficients of all the pairs in a packed triangle.
+            // The means and the deviations of each column are
+            // computed once and then all the pairs of a column
+            // go through a vectorized pass.
+            correlation_matrix<result_type> packed_results() const {
+                MATH_INSTRUMENT_PHASE(packed_results);
+                correlation_matrix<result_type> ans(N);
+                if (count == 0) {
+                    return ans;
+                }
+                if constexpr (std::is_integral_v<value_type>) {
+                    detail::integer_pcc_triangle<value_type, result_type>(N, count, std::begin(totals), std::begin(squared_totals), std::begin(covariance_total), ans.data());
+                } else {
+                    const value_type n = count;
+                    // sum of the squared deviations of each column
+                    std::vector<value_type> deviations(N);
+                    for (int c{}; c != N; ++c) {
+                        deviations[c] = squared_totals[c] - (totals[c]*totals[c] / n);
+                    }
+                    auto out = ans.data();
+                    auto cov = std::begin(covariance_total);
+                    for (int i{}; i < N-1; ++i) {
+                        const auto pairs = N-1-i;
+                        kernels::pcc_row(cov, std::begin(totals) + i+1, deviations.data() + i+1, pairs, totals[i], deviations[i], n, out);
+                        cov += pairs;
+                        out += pairs;
+                    }
+                }
+                return ans;
+            }
+
             // return a map containing all
             auto results() const {
-                auto partials = to_pcc_partial_valarray();
+                MATH_INSTRUMENT_PHASE(results);
+                const auto packed = packed_results();
                 // use unordered map to sped up data access
-                std::map<std::pair<int,int>,value_type> ans;
-                auto partial_iterator = std::begin(partials);
+                std::map<std::pair<int,int>,result_type> ans;
+                auto packed_iterator = packed.begin();
                 for (int i{}; i!=N-1; ++i) {
                     for (int j{i+1}; j!=N; ++j) {
-                        ans[std::make_pair(i,j)] = partial_iterator->compute();
-                        ++partial_iterator;
+                        ans[std::make_pair(i,j)] = *packed_iterator;
+                        ++packed_iterator;
+                    }
+                }
+                return ans;
+            }
+        };
+
+        /**
+         * multicolumn_pcc_accumulator with the number of columns
+         * fixed at compile time: all the sums are kept in
+         * std::array so nothing is allocated, and the loops over
+         * the pairs have constant bounds that the compiler can
+         * unroll and vectorize. Suitable for small N, e.g. a
+         * few tens of sensors updated once per event.
+         */
+        template <typename T, int Columns>
+        class multicolumn_pcc_accumulator {
+            static_assert(Columns >= 2, "Columns must be at least 2");
+        public:
+            using value_type = T;
+            using accumulator_type = typename accumulation_traits<T>::accumulator_type;
+            using result_type = typename accumulation_traits<T>::result_type;
+            static constexpr int N = Columns;
+            static constexpr std::size_t P = std::size_t(N)*(N-1)/2;
+        private:
+            template <typename, int>
+            friend class multicolumn_pcc_accumulator;
+
+            std::array<accumulator_type, N> totals{};
+            std::array<accumulator_type, N> squared_totals{};
+            // same order of math::sets::couple
+            std::array<accumulator_type, P> covariance_total{};
+            long long int count{};
+
+            // pair_table[k] is the pair of columns of the
+            // position k, computed from math::sets::couple
+            static constexpr std::array<std::pair<int,int>, P> make_pair_table() {
+                std::array<std::pair<int,int>, P> ans{};
+                for (int i{}; i != N; ++i) {
+                    for (int j{i+1}; j != N; ++j) {
+                        // std::pair assignment is not constexpr before C++20
+                        auto& p = ans[sets::couple::index(N, i, j)];
+                        p.first = i;
+                        p.second = j;
+                    }
+                }
+                return ans;
+            }
+
+            template <bool Subtract>
+            void update_row(const value_type* row) {
+                for (int i{}; i != N; ++i) {
+                    const accumulator_type tmp = Subtract ? -accumulator_type(row[i]) : accumulator_type(row[i]);
+                    totals[i] += tmp;
+                    squared_totals[i] += tmp*accumulator_type(row[i]);
+                    // pairs (i,j) are contiguous from (i,i+1), for
+                    // i = N-1 cov is the end of the array
+                    const auto cov = covariance_total.data() + index(i, i+1);
+                    for (int j{i+1}; j != N; ++j) {
+                        cov[j - (i+1)] += tmp*accumulator_type(row[j]);
+                    }
+                }
+            }
+
+        public:
+            static constexpr std::array<std::pair<int,int>, P> pair_table = make_pair_table();
+
+            // position of the pair (i,j), i < j
+            static constexpr std::size_t index(int i, int j) {
+                return sets::couple::index(N, i, j);
+            }
+
+            multicolumn_pcc_accumulator() = default;
+
+            // copy the sums of an accumulator with N columns
+            explicit multicolumn_pcc_accumulator(const multicolumn_pcc_accumulator<T>& o) {
+                if (o.N != N) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Size mismatch, this->N = "s + std::to_string(N) + ", other.N = "s + std::to_string(o.N));
+                }
+                std::copy(std::begin(o.totals), std::end(o.totals), totals.begin());
+                std::copy(std::begin(o.squared_totals), std::end(o.squared_totals), squared_totals.begin());
+                std::copy(std::begin(o.covariance_total), std::end(o.covariance_total), covariance_total.begin());
+                count = o.count;
+            }
+
+            // conversion to the run time sized accumulator
+            operator multicolumn_pcc_accumulator<T>() const {
+                multicolumn_pcc_accumulator<T> ans(N);
+                return ans += *this;
+            }
+
+            auto& accumulate_row(const value_type* row) {
+                MATH_INSTRUMENT_ADD(rows_ingested, 1);
+                MATH_INSTRUMENT_ADD(bytes_ingested, N*sizeof(value_type));
+                update_row<false>(row);
+                ++count;
+                return *this;
+            }
+
+            auto& remove_row(const value_type* row) {
+                update_row<true>(row);
+                --count;
+                return *this;
+            }
+
+            auto& accumulate(const std::array<value_type, N>& row) {
+                return accumulate_row(row.data());
+            }
+
+            auto& remove(const std::array<value_type, N>& row) {
+                return remove_row(row.data());
+            }
+
+            auto& accumulate(const value_type* row, std::size_t size) {
+                if (size != std::size_t(N)) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(N) + " found "s + std::to_string(size));
+                }
+                return accumulate_row(row);
+            }
+
+            auto& accumulate(const std::vector<value_type>& row) {
+                return accumulate(row.data(), row.size());
+            }
+
+            // same as multicolumn_pcc_accumulator<T>::accumulate(matrix, ...)
+            auto& accumulate(
+                const value_type* matrix,
+                std::size_t rows,
+                std::size_t cols,
+                std::size_t row_offset,
+                std::size_t col_offset
+            ) {
+                if (cols != std::size_t(N)) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(N) + " found "s + std::to_string(cols));
+                }
+                MATH_INSTRUMENT_PHASE(kernel);
+                MATH_INSTRUMENT_ADD(rows_ingested, rows);
+                MATH_INSTRUMENT_ADD(bytes_ingested, rows*N*sizeof(value_type));
+                kernels::syrk(
+                    matrix, rows, cols, row_offset, col_offset, 0, kernels::groups(cols),
+                    covariance_total.data(), totals.data(), squared_totals.data()
+                );
+                count += rows;
+                return *this;
+            }
+
+            constexpr int columns() const { return N; }
+            long long int rows() const { return count; }
+
+            auto& operator+=(const multicolumn_pcc_accumulator& o) {
+                MATH_INSTRUMENT_PHASE(merge);
+                MATH_INSTRUMENT_ADD(merges, 1);
+                for (int c{}; c != N; ++c) {
+                    totals[c] += o.totals[c];
+                    squared_totals[c] += o.squared_totals[c];
+                }
+                for (std::size_t k{}; k != P; ++k) {
+                    covariance_total[k] += o.covariance_total[k];
+                }
+                count += o.count;
+                return *this;
+            }
+
+            auto& operator-=(const multicolumn_pcc_accumulator& o) {
+                MATH_INSTRUMENT_PHASE(merge);
+                MATH_INSTRUMENT_ADD(merges, 1);
+                for (int c{}; c != N; ++c) {
+                    totals[c] -= o.totals[c];
+                    squared_totals[c] -= o.squared_totals[c];
+                }
+                for (std::size_t k{}; k != P; ++k) {
+                    covariance_total[k] -= o.covariance_total[k];
+                }
+                count -= o.count;
+                return *this;
+            }
+
+            // add a run time sized accumulator with N columns
+            auto& operator+=(const multicolumn_pcc_accumulator<T>& o) {
+                return *this += multicolumn_pcc_accumulator(o);
+            }
+
+            auto operator+(const multicolumn_pcc_accumulator& o) const {
+                auto ans = *this;
+                ans += o;
+                return ans;
+            }
+
+            auto& reset() {
+                *this = multicolumn_pcc_accumulator();
+                return *this;
+            }
+
+            // partial of the pair (i,j), i < j
+            pcc_partial<value_type> partial(int i, int j) const {
+                pcc_partial<value_type> ans;
+                ans.count = count;
+                ans.sum_1 = totals[i];
+                ans.sum_2 = totals[j];
+                ans.sum_1_squared = squared_totals[i];
+                ans.sum_2_squared = squared_totals[j];
+                ans.sum_prod = covariance_total[index(i, j)];
+                return ans;
+            }
+
+            // coefficients of all the pairs in couple order,
+            // same values of multicolumn_pcc_accumulator<T>::packed_results()
+            std::array<result_type, P> packed_results() const {
+                MATH_INSTRUMENT_PHASE(packed_results);
+                std::array<result_type, P> ans{};
+                if (count == 0) {
+                    return ans;
+                }
+                if constexpr (std::is_integral_v<value_type>) {
+                    detail::integer_pcc_triangle<value_type, result_type>(N, count, totals.data(), squared_totals.data(), covariance_total.data(), ans.data());
+                } else {
+                    const value_type n = count;
+                    std::array<value_type, N> deviations;
+                    for (int c{}; c != N; ++c) {
+                        deviations[c] = squared_totals[c] - (totals[c]*totals[c] / n);
+                    }
+                    auto out = ans.data();
+                    auto cov = covariance_total.data();
+                    for (int i{}; i < N-1; ++i) {
+                        const auto pairs = N-1-i;
+                        kernels::pcc_row(cov, totals.data() + i+1, deviations.data() + i+1, pairs, totals[i], deviations[i], n, out);
+                        cov += pairs;
+                        out += pairs;
+                    }
+                }
+                return ans;
+            }
+
+            auto results() const {
+                MATH_INSTRUMENT_PHASE(results);
+                const auto packed = packed_results();
+                std::map<std::pair<int,int>,result_type> ans;
+                for (std::size_t k{}; k != P; ++k) {
+                    ans[pair_table[k]] = packed[k];
+                }
+                return ans;
+            }
+        };
+
+        /**
+         * Correlation of N columns (the set X) against M other
+         * columns (the set Y) without the pairs inside X or Y:
+         * it keeps the sums of the N+M columns and the N x M
+         * block of cross products, updated by a GEMM-like
+         * kernel when whole matrices are accumulated.
+         * Rows have N+M elements, the first N belong to X.
+         */
+        template <typename T = double>
+        class cross_pcc_accumulator {
+        public:
+            using value_type = T;
+            // exact integers for integer columns, see accumulation_traits
+            using accumulator_type = typename accumulation_traits<T>::accumulator_type;
+            using result_type = typename accumulation_traits<T>::result_type;
+        private:
+            int N, M;
+            // for each column, X first
+            std::valarray<accumulator_type> totals;
+            std::valarray<accumulator_type> squared_totals;
+            // for each pair, row-major: (0,0) (0,1) ... (0,M-1) (1,0) ...
+            std::valarray<accumulator_type> cross_total;
+            long long int count{};
+
+            void check_columns(std::size_t cols) const {
+                if (cols != std::size_t(N) + M) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(N + M) + " found "s + std::to_string(cols));
+                }
+            }
+
+            void check_size(const cross_pcc_accumulator& o) const {
+                if (N != o.N || M != o.M) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Size mismatch, this is "s + std::to_string(N) + "x"s + std::to_string(M)
+                        + ", other is "s + std::to_string(o.N) + "x"s + std::to_string(o.M));
+                }
+            }
+
+        public:
+            cross_pcc_accumulator(int N, int M)
+            : N{N}, M{M}
+            {
+                if (N < 1 || M < 1) {
+                    using namespace std::literals;
+                    throw std::invalid_argument("N and M must be at least 1, found "s + std::to_string(N) + " and "s + std::to_string(M));
+                }
+                totals.resize(N + M);
+                squared_totals.resize(N + M);
+                cross_total.resize(std::size_t(N)*M);
+            }
+
+            // count a single row of N+M elements
+            auto& accumulate_row(const value_type* row) {
+                auto cross_iterator = std::begin(cross_total);
+                const auto y = row + N;
+                for (int k{}; k != N + M; ++k) {
+                    const accumulator_type tmp = row[k];
+                    totals[k] += tmp;
+                    squared_totals[k] += tmp*tmp;
+                }
+                for (int i{}; i != N; ++i) {
+                    const accumulator_type tmp = row[i];
+                    for (int j{}; j != M; ++j) {
+                        *cross_iterator += tmp*accumulator_type(y[j]);
+                        ++cross_iterator;
+                    }
+                }
+                ++count;
+                return *this;
+            }
+
+            auto& accumulate(const value_type* row, std::size_t size) {
+                check_columns(size);
+                return accumulate_row(row);
+            }
+
+            auto& accumulate(const std::vector<value_type>& row) {
+                return accumulate(row.data(), row.size());
+            }
+
+            // rows of N+M columns, the first N are X
+            auto& accumulate(
+                const value_type* matrix,
+                std::size_t rows,
+                std::size_t cols,
+                std::size_t row_offset,
+                std::size_t col_offset
+            ) {
+                check_columns(cols);
+                return accumulate(matrix, row_offset, col_offset, matrix + N*col_offset, row_offset, col_offset, rows);
+            }
+
+            // X and Y in two distinct matrices with the same rows
+            auto& accumulate(
+                const value_type* x, std::size_t x_row_offset, std::size_t x_col_offset,
+                const value_type* y, std::size_t y_row_offset, std::size_t y_col_offset,
+                std::size_t rows
+            ) {
+                kernels::gemm(
+                    x, N, x_row_offset, x_col_offset,
+                    y, M, y_row_offset, y_col_offset,
+                    rows, std::begin(cross_total), std::begin(totals), std::begin(squared_totals)
+                );
+                count += rows;
+                return *this;
+            }
+
+            // columns of X
+            int x_columns() const { return N; }
+            // columns of Y
+            int y_columns() const { return M; }
+            // number of rows accumulated so far
+            long long int rows() const { return count; }
+
+            auto& operator+=(const cross_pcc_accumulator<T>& o) {
+                check_size(o);
+                totals += o.totals;
+                squared_totals += o.squared_totals;
+                cross_total += o.cross_total;
+                count += o.count;
+                return *this;
+            }
+
+            auto& operator-=(const cross_pcc_accumulator<T>& o) {
+                check_size(o);
+                totals -= o.totals;
+                squared_totals -= o.squared_totals;
+                cross_total -= o.cross_total;
+                count -= o.count;
+                return *this;
+            }
+
+            auto operator+(const cross_pcc_accumulator& o) const {
+                auto ans = *this;
+                ans += o;
+                return ans;
+            }
+
+            auto& reset() {
+                totals = 0;
+                squared_totals = 0;
+                cross_total = 0;
+                count = 0;
+                return *this;
+            }
+
+            // partial of the column i of X and j of Y
+            pcc_partial<value_type> partial(int i, int j) const {
+                pcc_partial<value_type> ans;
+                ans.count = count;
+                ans.sum_1 = totals[i];
+                ans.sum_2 = totals[N + j];
+                ans.sum_1_squared = squared_totals[i];
+                ans.sum_2_squared = squared_totals[N + j];
+                ans.sum_prod = cross_total[std::size_t(i)*M + j];
+                return ans;
+            }
+
+            cross_correlation_matrix<result_type> packed_results() const {
+                cross_correlation_matrix<result_type> ans(N, M);
+                if (count == 0) {
+                    return ans;
+                }
+                if constexpr (std::is_integral_v<value_type>) {
+                    auto out = ans.data();
+                    for (int i{}; i != N; ++i) {
+                        for (int j{}; j != M; ++j) {
+                            *out++ = detail::integer_pcc<value_type, result_type>(
+                                count, totals[i], totals[N + j], squared_totals[i], squared_totals[N + j],
+                                cross_total[std::size_t(i)*M + j]
+                            );
+                        }
+                    }
+                } else {
+                    const value_type n = count;
+                    std::vector<value_type> deviations(N + M);
+                    for (int c{}; c != N + M; ++c) {
+                        deviations[c] = squared_totals[c] - (totals[c]*totals[c] / n);
+                    }
+                    for (int i{}; i != N; ++i) {
+                        kernels::pcc_row(
+                            std::begin(cross_total) + std::size_t(i)*M, std::begin(totals) + N, deviations.data() + N, M,
+                            totals[i], deviations[i], n, ans.data() + std::size_t(i)*M
+                        );
+                    }
+                }
+                return ans;
+            }
+
+            // map (column of X, column of Y) -> coefficient
+            auto results() const {
+                const auto packed = packed_results();
+                std::map<std::pair<int,int>,result_type> ans;
+                auto packed_iterator = packed.begin();
+                for (int i{}; i != N; ++i) {
+                    for (int j{}; j != M; ++j) {
+                        ans[std::make_pair(i,j)] = *packed_iterator;
+                        ++packed_iterator;
                     }
                 }
                 return ans;
             }
         };
 
+        /**
+         * Front end of a multicolumn_pcc_accumulator for data
+         * arriving one row at a time: rows are copied in an
+         * aligned block of B rows that, once full, is passed to
+         * the blocked accumulate(matrix, ...) instead of doing
+         * O(N^2) scalar updates per row.
+         * Rows still in the block are not visible through the
+         * accumulator until flush() is called, which also happens
+         * on destruction.
+         * The columns of the accumulator may change (add_columns,
+         * remove_columns) only while the block is empty: buffered
+         * rows of the old columns are dropped and reported.
+         */
+        template <typename T = double>
+        class batched_pcc_accumulator {
+        public:
+            using value_type = T;
+        private:
+            multicolumn_pcc_accumulator<value_type>& target;
+            std::size_t B;
+            // columns of the buffered rows
+            std::size_t N;
+            // B rows of N elements, row-major
+            std::vector<value_type, simd::aligned_allocator<value_type>> block;
+            std::size_t filled{};
+
+        public:
+            explicit batched_pcc_accumulator(multicolumn_pcc_accumulator<value_type>& target, std::size_t batch_rows = 4*kernels::block_rows<T>())
+            : target{target}, B{batch_rows}, N(target.columns()), block(batch_rows*N)
+            {
+                if (batch_rows == 0) {
+                    throw std::invalid_argument("batch_rows must be at least 1");
+                }
+            }
+
+            batched_pcc_accumulator(const batched_pcc_accumulator&) = delete;
+            batched_pcc_accumulator& operator=(const batched_pcc_accumulator&) = delete;
+
+            // a destructor must not throw: call flush() explicitly
+            // to get the errors, here they are dropped with the rows
+            ~batched_pcc_accumulator() {
+                try {
+                    flush();
+                } catch (...) {
+                }
+            }
+
+            // count a single row given as pointer and size
+            auto& accumulate(const value_type* row, std::size_t size) {
+                follow_columns();
+                if (size != N) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(N) + " found "s + std::to_string(size));
+                }
+                std::copy(row, row + N, block.data() + filled*N);
+                if (++filled == B) {
+                    flush();
+                }
+                return *this;
+            }
+
+            auto& accumulate(const std::vector<value_type>& row) {
+                return accumulate(row.data(), row.size());
+            }
+
+            // pass the buffered rows to the accumulator
+            auto& flush() {
+                follow_columns();
+                if (filled) {
+                    target.accumulate(block.data(), filled, N, N, 1);
+                    filled = 0;
+                }
+                return *this;
+            }
+
+            // rows waiting in the block
+            std::size_t pending() const { return filled; }
+            std::size_t batch_rows() const { return B; }
+
+            multicolumn_pcc_accumulator<value_type>& accumulator() { return target; }
+
+        private:
+            // the block follows the columns of the accumulator,
+            // rows buffered with the old ones cannot be passed
+            void follow_columns() {
+                const std::size_t columns = target.columns();
+                if (columns == N) {
+                    return;
+                }
+                const auto dropped = filled;
+                const auto old = N;
+                filled = 0;
+                N = columns;
+                block.resize(B*N);
+                if (dropped) {
+                    using namespace std::literals;
+                    throw std::runtime_error("The accumulator went from "s + std::to_string(old) + " to "s + std::to_string(columns) + " columns with "s + std::to_string(dropped) + " rows buffered, flush() before changing the columns"s);
+                }
+            }
+        };
+
     } // namespace statistics
 } // namespace math
 
@@ -6,6 +6,10 @@
 #include <utility>
 #include <optional>
 #include <stdexcept>
+#include <string>
+#include <cmath>
+#include <iterator>
+#include <vector>
 
 namespace math
 {
@@ -20,37 +24,46 @@ namespace math
         class couple
         {
         private:
-            const int n, limit = n*(n-1)/2;
-            int i;
+            const int n;
+            const long long limit = pairs(n);
+            long long i;
             int _1, _2;
             // if true no more inc() are possible
             bool _last{}, _finished{};
 
-            static std::pair<int, int> pair(int n, int i) {
-                // candidate supposing al pairs are ok
-                std::pair<int, int> p{i/n, i%n};
+        public:
+            // number of pairs of elements lower than n, 64 bit
+            // since n*(n-1)/2 overflows int for n > 46341
+            static constexpr long long pairs(int n) {
+                return (long long)n*(n-1)/2;
+            }
 
-                // first column and no overflow?
-                if (p.first == 0 && p.second+1 < n) {
-                    return std::make_pair(p.first, p.second+1);
-                } else if (p.first == 0 && p.second+1 == n) {
-                    return std::make_pair(1, 2);
-                }
+            // index of the pair (first,second), first < second,
+            // among all the pairs of elements lower than n
+            static constexpr long long index(int n, int first, int second) {
+                return (long long)first*(2LL*n - first - 1)/2 + (second - first - 1);
+            }
 
-                // reduce problem with recursion
-                // [0,1] for new base will be
-                // translated to [p[0], p[0]+1]
-                std::pair<int, int> base(p.first, p.first);
-                // all points in the triangle
-                // marked by [p[0], p[0]]
-                // must be ignored, others must be
-                // counted
-                auto remaining = i - ((n-1)*p.first - (p.first-1)*p.first/2);
-                auto p2 = pair(n-p.first, remaining);
-                return std::make_pair(p2.first+base.first, p2.second+base.second);
+            // pair with index i among all the pairs of elements
+            // lower than n, inverse of index(): first is the largest
+            // a such that index(n,a,a+1) <= i, estimated solving
+            // a^2 - (2n-1)a + 2i = 0 and then fixed for rounding
+            static std::pair<int, int> pair(int n, long long i) {
+                const long double b = 2.0L*n - 1;
+                long long a = (long long)((b - std::sqrt(b*b - 8.0L*i)) / 2);
+                if (a < 0) {
+                    a = 0;
+                }
+                while (a > 0 && index(n, a, a+1) > i) {
+                    --a;
+                }
+                while (a+1 < n-1 && index(n, a+1, a+2) <= i) {
+                    ++a;
+                }
+                return std::make_pair((int)a, (int)(i - index(n, a, a+1) + a + 1));
             }
-        public:
-            couple(int n, int i = 0) : n{n}, i{i} {
+
+            couple(int n, long long i = 0) : n{n}, i{i} {
                 using namespace std::literals;
                 if (n < 2) {
                     throw std::invalid_argument("n must be at least 2, received "s + std::to_string(n));
@@ -60,7 +73,7 @@ namespace math
                 }
                 auto tmp = pair(n, i);
                 _1 = tmp.first; _2 = tmp.second;
-                if (n == 2) {
+                if (i+1 == limit) {
                     _last = true;
                 }
             }
@@ -118,6 +131,151 @@ namespace math
             }
         };
 
+        /**
+         * Random access iterator over the pairs of elements
+         * lower than n, in the same order of couple.
+         * It dereferences to a std::pair<int,int> (by value)
+         * and can be used with parallel algorithms:
+         *  std::for_each(std::execution::par, r.begin(), r.end(), f)
+         */
+        class couple_iterator
+        {
+        private:
+            int n{2};
+            long long i{};
+            // pair with index i, valid if i < pairs(n)
+            int _1{}, _2{1};
+
+            void locate() {
+                if (0 <= i && i < couple::pairs(n)) {
+                    auto tmp = couple::pair(n, i);
+                    _1 = tmp.first; _2 = tmp.second;
+                }
+            }
+
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = std::pair<int,int>;
+            using difference_type = long long;
+            using pointer = void;
+            using reference = std::pair<int,int>;
+
+            couple_iterator() = default;
+            couple_iterator(int n, long long i) : n{n}, i{i} {
+                locate();
+            }
+
+            reference operator*() const { return {_1, _2}; }
+            reference operator[](difference_type d) const { return couple::pair(n, i + d); }
+
+            long long index() const { return i; }
+
+            couple_iterator& operator++() {
+                if (++i < couple::pairs(n)) {
+                    if (_2+1 == n) {
+                        _2 = ++_1 + 1;
+                    } else {
+                        ++_2;
+                    }
+                }
+                return *this;
+            }
+
+            couple_iterator& operator--() {
+                if (--i < couple::pairs(n)) {
+                    if (i+1 == couple::pairs(n)) {
+                        // back from the end
+                        locate();
+                    } else if (_2 == _1+1) {
+                        --_1;
+                        _2 = n-1;
+                    } else {
+                        --_2;
+                    }
+                }
+                return *this;
+            }
+
+            couple_iterator operator++(int) { auto cp = *this; ++*this; return cp; }
+            couple_iterator operator--(int) { auto cp = *this; --*this; return cp; }
+
+            couple_iterator& operator+=(difference_type d) {
+                i += d;
+                locate();
+                return *this;
+            }
+            couple_iterator& operator-=(difference_type d) { return *this += -d; }
+
+            friend couple_iterator operator+(couple_iterator it, difference_type d) { return it += d; }
+            friend couple_iterator operator+(difference_type d, couple_iterator it) { return it += d; }
+            friend couple_iterator operator-(couple_iterator it, difference_type d) { return it -= d; }
+            friend difference_type operator-(const couple_iterator& a, const couple_iterator& b) { return a.i - b.i; }
+
+            friend bool operator==(const couple_iterator& a, const couple_iterator& b) { return a.i == b.i; }
+            friend bool operator!=(const couple_iterator& a, const couple_iterator& b) { return a.i != b.i; }
+            friend bool operator<(const couple_iterator& a, const couple_iterator& b) { return a.i < b.i; }
+            friend bool operator>(const couple_iterator& a, const couple_iterator& b) { return a.i > b.i; }
+            friend bool operator<=(const couple_iterator& a, const couple_iterator& b) { return a.i <= b.i; }
+            friend bool operator>=(const couple_iterator& a, const couple_iterator& b) { return a.i >= b.i; }
+        };
+
+        // split [0,limit) in at most parts contiguous ranges
+        // whose lengths differ at most by one
+        inline std::vector<std::pair<long long, long long>> split(long long limit, long long parts) {
+            using namespace std::literals;
+            if (parts < 1) {
+                throw std::invalid_argument("parts must be at least 1, received "s + std::to_string(parts));
+            }
+            std::vector<std::pair<long long, long long>> ans;
+            if (parts > limit) {
+                parts = limit;
+            }
+            const auto base = parts ? limit / parts : 0, extra = parts ? limit % parts : 0;
+            long long begin{};
+            for (long long p{}; p != parts; ++p) {
+                const auto end = begin + base + (p < extra ? 1 : 0);
+                ans.emplace_back(begin, end);
+                begin = end;
+            }
+            return ans;
+        }
+
+        /**
+         * Pairs with index in [first,last) among all the
+         * pairs of elements lower than n.
+         */
+        class couple_range
+        {
+        private:
+            int n;
+            long long _first, _last;
+        public:
+            couple_range(int n) : couple_range(n, 0, couple::pairs(n)) {}
+            couple_range(int n, long long first, long long last) : n{n}, _first{first}, _last{last} {
+                using namespace std::literals;
+                if (n < 2) {
+                    throw std::invalid_argument("n must be at least 2, received "s + std::to_string(n));
+                }
+                if (first < 0 || last < first || couple::pairs(n) < last) {
+                    throw std::invalid_argument("["s + std::to_string(first) + ","s + std::to_string(last) + ") must be in [0,"s + std::to_string(couple::pairs(n)) + "]"s);
+                }
+            }
+
+            couple_iterator begin() const { return {n, _first}; }
+            couple_iterator end() const { return {n, _last}; }
+            long long size() const { return _last - _first; }
+            bool empty() const { return _first == _last; }
+
+            // balanced sub-ranges, one per worker
+            std::vector<couple_range> split(long long workers) const {
+                std::vector<couple_range> ans;
+                for (const auto& r : math::sets::split(size(), workers)) {
+                    ans.emplace_back(n, _first + r.first, _first + r.second);
+                }
+                return ans;
+            }
+        };
+
     } // namespace sets
 } // namespace math
 
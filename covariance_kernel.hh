@@ -0,0 +1,427 @@
+
+#ifndef COVARIANCE_KERNEL
+#define COVARIANCE_KERNEL
+
+#include "integer_kernel.hh"
+#include "simd.hh"
+
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+#include <type_traits>
+
+/**
+ * Building blocks of the blocked computation of the
+ * upper triangle of X'X (syrk like) used by
+ * multicolumn_pcc_accumulator.
+ *
+ * Columns are grouped by width consecutive elements,
+ * a chunk of rows is packed so that every group is
+ * stored as a contiguous panel (row by row) and the
+ * product of two panels is computed by a register
+ * blocked micro-kernel.
+ */
+namespace math
+{
+    namespace statistics
+    {
+        namespace kernels
+        {
+
+            // number of columns in a group, the micro-kernel
+            // computes width x width products at once
+            constexpr std::size_t width = 8;
+
+            // number of rows packed at once: a panel of a group
+            // takes about 8KB so that two of them (the operands
+            // of the micro-kernel) stay in L1
+            template <typename T>
+            constexpr std::size_t block_rows() {
+                return std::max<std::size_t>(16, 8192 / (width*sizeof(T)));
+            }
+
+            // number of groups needed to cover cols columns
+            inline std::size_t groups(std::size_t cols) {
+                return (cols + width - 1) / width;
+            }
+
+            // position of the pair (c1,c2), c1 < c2, in the packed
+            // upper triangle of a n x n matrix, same order as
+            // math::sets::couple: (0,1) (0,2) ... (1,2) ...
+            inline std::size_t pair_index(std::size_t n, std::size_t c1, std::size_t c2) {
+                return c1*(2*n - c1 - 1)/2 + (c2 - c1 - 1);
+            }
+
+            // Copy rows [0,rows) of the groups [g_begin,g_end)
+            // into panel, group g is stored starting at
+            // panel[(g-g_begin)*rows*width] as rows x width
+            // elements. Columns past cols are filled with 0.
+            // If totals is not null, the sum and the sum of the
+            // squares of each packed column are added to totals
+            // and squared_totals, so that the data are visited
+            // just once.
+            template <typename T, typename A>
+            inline void pack(
+                const T* matrix, std::size_t rows, std::size_t cols,
+                std::size_t row_offset, std::size_t col_offset,
+                std::size_t g_begin, std::size_t g_end,
+                T* panel, A* totals, A* squared_totals
+            ) {
+                for (auto g = g_begin; g != g_end; ++g) {
+                    const auto c_begin = g*width;
+                    const auto valid = std::min(width, cols - c_begin);
+                    T tot[width]{};
+                    T tot2[width]{};
+                    auto column = matrix + c_begin*col_offset;
+                    for (std::size_t r{}; r != rows; ++r) {
+                        auto row = column + r*row_offset;
+                        std::size_t w{};
+                        for (; w != valid; ++w) {
+                            const auto tmp = row[w*col_offset];
+                            panel[w] = tmp;
+                            tot[w] += tmp;
+                            tot2[w] += tmp*tmp;
+                        }
+                        for (; w != width; ++w) {
+                            panel[w] = T{};
+                        }
+                        panel += width;
+                    }
+                    if (totals) {
+                        for (std::size_t w{}; w != valid; ++w) {
+                            totals[c_begin + w] += tot[w];
+                            squared_totals[c_begin + w] += tot2[w];
+                        }
+                    }
+                }
+            }
+
+            // acc[i*width + j] = sum(a[r][i] * b[r][j]) for r in [0,rows)
+            template <typename T>
+            inline void micro_kernel_scalar(const T* a, const T* b, std::size_t rows, T* acc) {
+                std::fill(acc, acc + width*width, T{});
+                for (std::size_t r{}; r != rows; ++r) {
+                    for (std::size_t i{}; i != width; ++i) {
+                        const auto tmp = a[i];
+                        for (std::size_t j{}; j != width; ++j) {
+                            acc[i*width + j] += tmp*b[j];
+                        }
+                    }
+                    a += width;
+                    b += width;
+                }
+            }
+
+#ifdef MATH_SIMD_X86
+            // 4 rows of the result at a time to fit the 16 ymm registers
+            MATH_SIMD_TARGET("avx2,fma")
+            inline void micro_kernel_avx2(const double* a, const double* b, std::size_t rows, double* acc) {
+                for (std::size_t h{}; h != width; h += 4) {
+                    __m256d c[4][2];
+                    for (auto& ci : c) {
+                        ci[0] = _mm256_setzero_pd();
+                        ci[1] = _mm256_setzero_pd();
+                    }
+                    auto pa = a + h;
+                    auto pb = b;
+                    for (std::size_t r{}; r != rows; ++r) {
+                        const auto b0 = _mm256_load_pd(pb);
+                        const auto b1 = _mm256_load_pd(pb + 4);
+                        for (std::size_t i{}; i != 4; ++i) {
+                            const auto ai = _mm256_broadcast_sd(pa + i);
+                            c[i][0] = _mm256_fmadd_pd(ai, b0, c[i][0]);
+                            c[i][1] = _mm256_fmadd_pd(ai, b1, c[i][1]);
+                        }
+                        pa += width;
+                        pb += width;
+                    }
+                    for (std::size_t i{}; i != 4; ++i) {
+                        _mm256_storeu_pd(acc + (h+i)*width, c[i][0]);
+                        _mm256_storeu_pd(acc + (h+i)*width + 4, c[i][1]);
+                    }
+                }
+            }
+
+            MATH_SIMD_TARGET("avx2,fma")
+            inline void micro_kernel_avx2(const float* a, const float* b, std::size_t rows, float* acc) {
+                __m256 c[width];
+                for (auto& ci : c) {
+                    ci = _mm256_setzero_ps();
+                }
+                for (std::size_t r{}; r != rows; ++r) {
+                    const auto bv = _mm256_load_ps(b);
+                    for (std::size_t i{}; i != width; ++i) {
+                        c[i] = _mm256_fmadd_ps(_mm256_broadcast_ss(a + i), bv, c[i]);
+                    }
+                    a += width;
+                    b += width;
+                }
+                for (std::size_t i{}; i != width; ++i) {
+                    _mm256_storeu_ps(acc + i*width, c[i]);
+                }
+            }
+
+            MATH_SIMD_TARGET("avx512f")
+            inline void micro_kernel_avx512(const double* a, const double* b, std::size_t rows, double* acc) {
+                __m512d c[width];
+                for (auto& ci : c) {
+                    ci = _mm512_setzero_pd();
+                }
+                for (std::size_t r{}; r != rows; ++r) {
+                    const auto bv = _mm512_load_pd(b);
+                    for (std::size_t i{}; i != width; ++i) {
+                        c[i] = _mm512_fmadd_pd(_mm512_set1_pd(a[i]), bv, c[i]);
+                    }
+                    a += width;
+                    b += width;
+                }
+                for (std::size_t i{}; i != width; ++i) {
+                    _mm512_storeu_pd(acc + i*width, c[i]);
+                }
+            }
+#endif
+
+            // pick the best micro-kernel available at runtime,
+            // panels must be aligned to 64 bytes
+            template <typename T>
+            inline void micro_kernel(const T* a, const T* b, std::size_t rows, T* acc) {
+#ifdef MATH_SIMD_X86
+                const auto level = simd::active_isa();
+                if constexpr (std::is_same_v<T, double>) {
+                    if (level >= simd::isa::avx512) {
+                        return micro_kernel_avx512(a, b, rows, acc);
+                    }
+                    if (level >= simd::isa::avx2) {
+                        return micro_kernel_avx2(a, b, rows, acc);
+                    }
+                } else if constexpr (std::is_same_v<T, float>) {
+                    // 8 floats fill a ymm register, nothing to gain with zmm
+                    if (level >= simd::isa::avx2) {
+                        return micro_kernel_avx2(a, b, rows, acc);
+                    }
+                }
+#endif
+                micro_kernel_scalar(a, b, rows, acc);
+            }
+
+            // add the products of the groups gi and gj (gi <= gj)
+            // to the packed upper triangle covariance of a
+            // cols x cols matrix, ignoring the diagonal and
+            // the lower triangle
+            template <typename T, typename A>
+            inline void store_block(const T* acc, std::size_t cols, std::size_t gi, std::size_t gj, A* covariance) {
+                const auto ci_end = std::min(cols, (gi+1)*width);
+                const auto cj_begin = gj*width;
+                const auto cj_end = std::min(cols, (gj+1)*width);
+                for (auto ci = gi*width; ci != ci_end; ++ci) {
+                    const auto first = std::max(cj_begin, ci+1);
+                    if (first >= cj_end) {
+                        continue;
+                    }
+                    auto dst = covariance + pair_index(cols, ci, first);
+                    auto src = acc + (ci - gi*width)*width + (first - cj_begin);
+                    for (auto cj = first; cj != cj_end; ++cj) {
+                        *dst++ += *src++;
+                    }
+                }
+            }
+
+            // Exact version of syrk for integer columns (see
+            // integer_kernel.hh): the columns [c_begin,cols) of a
+            // block of rows are copied in contiguous buffers and
+            // every pair (i,j), i in [c_begin,c_end), i < j, is a
+            // dot product accumulated in A.
+            template <typename T, typename A>
+            inline void syrk_integer(
+                const T* matrix, std::size_t rows, std::size_t cols,
+                std::size_t row_offset, std::size_t col_offset,
+                std::size_t c_begin, std::size_t c_end,
+                A* covariance, A* totals, A* squared_totals
+            ) {
+                constexpr auto block = block_rows<T>();
+                static thread_local std::vector<T, simd::aligned_allocator<T>> panel;
+                panel.resize((cols - c_begin)*block);
+                for (std::size_t r0{}; r0 < rows; r0 += block) {
+                    const auto n = std::min(block, rows - r0);
+                    const auto chunk = matrix + r0*row_offset;
+                    for (auto c = c_begin; c != cols; ++c) {
+                        const auto column = chunk + c*col_offset;
+                        auto dst = panel.data() + (c - c_begin)*block;
+                        A tot{}, tot2{};
+                        for (std::size_t r{}; r != n; ++r) {
+                            const auto tmp = column[r*row_offset];
+                            dst[r] = tmp;
+                            tot += A(tmp);
+                            tot2 += A(tmp)*A(tmp);
+                        }
+                        if (totals && c < c_end) {
+                            totals[c] += tot;
+                            squared_totals[c] += tot2;
+                        }
+                    }
+                    for (auto i = c_begin; i != c_end; ++i) {
+                        const auto a = panel.data() + (i - c_begin)*block;
+                        auto dst = covariance + pair_index(cols, i, i+1);
+                        for (auto j = i+1; j != cols; ++j) {
+                            *dst++ += dot_integer<A>(a, panel.data() + (j - c_begin)*block, n);
+                        }
+                    }
+                }
+            }
+
+            // Accumulate the cross products of all the pairs of
+            // columns whose first element is in the groups
+            // [g_begin,g_end) into covariance (packed upper
+            // triangle). If totals is not null also the sums and
+            // the sums of squares of the columns in [g_begin,g_end)
+            // are accumulated, during the packing.
+            // Row-major and column-major data are both supported
+            // through row_offset and col_offset.
+            template <typename T, typename A>
+            inline void syrk(
+                const T* matrix, std::size_t rows, std::size_t cols,
+                std::size_t row_offset, std::size_t col_offset,
+                std::size_t g_begin, std::size_t g_end,
+                A* covariance, A* totals, A* squared_totals
+            ) {
+                const auto G = groups(cols);
+                if (g_begin >= g_end || rows == 0) {
+                    return;
+                }
+                if constexpr (std::is_integral_v<T>) {
+                    return syrk_integer(
+                        matrix, rows, cols, row_offset, col_offset,
+                        g_begin*width, std::min(cols, g_end*width),
+                        covariance, totals, squared_totals
+                    );
+                }
+                constexpr auto block = block_rows<T>();
+                // the pairs (gi,gj) with gi in [g_begin,g_end) need
+                // the groups [g_begin,G) to be packed
+                static thread_local std::vector<T, simd::aligned_allocator<T>> panel;
+                panel.resize((G - g_begin)*block*width);
+                alignas(64) T acc[width*width];
+                for (std::size_t r0{}; r0 < rows; r0 += block) {
+                    const auto n = std::min(block, rows - r0);
+                    const auto chunk = matrix + r0*row_offset;
+                    // sums are required only for the owned groups
+                    pack(chunk, n, cols, row_offset, col_offset, g_begin, g_end, panel.data(), totals, squared_totals);
+                    pack(chunk, n, cols, row_offset, col_offset, g_end, G, panel.data() + (g_end-g_begin)*n*width, (A*)nullptr, (A*)nullptr);
+                    for (auto gi = g_begin; gi != g_end; ++gi) {
+                        const auto a = panel.data() + (gi-g_begin)*n*width;
+                        for (auto gj = gi; gj != G; ++gj) {
+                            const auto b = panel.data() + (gj-g_begin)*n*width;
+                            micro_kernel(a, b, n, acc);
+                            store_block(acc, cols, gi, gj, covariance);
+                        }
+                    }
+                }
+            }
+
+            // add the products of the groups gx of X and gy of Y
+            // to the nx x ny row-major block cross
+            template <typename T, typename A>
+            inline void store_rect(const T* acc, std::size_t nx, std::size_t ny, std::size_t gx, std::size_t gy, A* cross) {
+                const auto ci_end = std::min(nx, (gx+1)*width);
+                const auto cj_begin = gy*width;
+                const auto valid = std::min(ny, cj_begin + width) - cj_begin;
+                for (auto ci = gx*width; ci != ci_end; ++ci) {
+                    auto dst = cross + ci*ny + cj_begin;
+                    auto src = acc + (ci - gx*width)*width;
+                    for (std::size_t w{}; w != valid; ++w) {
+                        dst[w] += src[w];
+                    }
+                }
+            }
+
+            // Exact version of gemm for integer columns: a block of
+            // rows of the columns of X and Y is copied in contiguous
+            // buffers and every pair is a dot product accumulated in A.
+            template <typename T, typename A>
+            inline void gemm_integer(
+                const T* x, std::size_t nx, std::size_t x_row_offset, std::size_t x_col_offset,
+                const T* y, std::size_t ny, std::size_t y_row_offset, std::size_t y_col_offset,
+                std::size_t rows, A* cross, A* totals, A* squared_totals
+            ) {
+                constexpr auto block = block_rows<T>();
+                static thread_local std::vector<T, simd::aligned_allocator<T>> panel;
+                panel.resize((nx + ny)*block);
+                for (std::size_t r0{}; r0 < rows; r0 += block) {
+                    const auto n = std::min(block, rows - r0);
+                    // X in the columns [0,nx) of the panel, Y after
+                    for (std::size_t c{}; c != nx + ny; ++c) {
+                        const auto column = c < nx
+                            ? x + r0*x_row_offset + c*x_col_offset
+                            : y + r0*y_row_offset + (c - nx)*y_col_offset;
+                        const auto row_offset = c < nx ? x_row_offset : y_row_offset;
+                        auto dst = panel.data() + c*block;
+                        A tot{}, tot2{};
+                        for (std::size_t r{}; r != n; ++r) {
+                            const auto tmp = column[r*row_offset];
+                            dst[r] = tmp;
+                            tot += A(tmp);
+                            tot2 += A(tmp)*A(tmp);
+                        }
+                        if (totals) {
+                            totals[c] += tot;
+                            squared_totals[c] += tot2;
+                        }
+                    }
+                    for (std::size_t i{}; i != nx; ++i) {
+                        for (std::size_t j{}; j != ny; ++j) {
+                            cross[i*ny + j] += dot_integer<A>(panel.data() + i*block, panel.data() + (nx + j)*block, n);
+                        }
+                    }
+                }
+            }
+
+            // Accumulate the cross products X'Y of the columns of
+            // X (rows x nx) and Y (rows x ny) into the nx x ny
+            // row-major block cross. Each block of rows of Y is
+            // packed once and reused against one packed group of
+            // X at a time, so only the groups of Y need to stay in
+            // cache. If totals is not null the sums and the sums of
+            // squares of the columns of X and then of Y are added
+            // to totals and squared_totals (nx + ny elements).
+            template <typename T, typename A>
+            inline void gemm(
+                const T* x, std::size_t nx, std::size_t x_row_offset, std::size_t x_col_offset,
+                const T* y, std::size_t ny, std::size_t y_row_offset, std::size_t y_col_offset,
+                std::size_t rows, A* cross, A* totals, A* squared_totals
+            ) {
+                if (rows == 0 || nx == 0 || ny == 0) {
+                    return;
+                }
+                if constexpr (std::is_integral_v<T>) {
+                    return gemm_integer(
+                        x, nx, x_row_offset, x_col_offset,
+                        y, ny, y_row_offset, y_col_offset,
+                        rows, cross, totals, squared_totals
+                    );
+                }
+                const auto Gx = groups(nx);
+                const auto Gy = groups(ny);
+                constexpr auto block = block_rows<T>();
+                static thread_local std::vector<T, simd::aligned_allocator<T>> y_panel, x_panel;
+                y_panel.resize(Gy*block*width);
+                x_panel.resize(block*width);
+                alignas(64) T acc[width*width];
+                for (std::size_t r0{}; r0 < rows; r0 += block) {
+                    const auto n = std::min(block, rows - r0);
+                    pack(y + r0*y_row_offset, n, ny, y_row_offset, y_col_offset, 0, Gy, y_panel.data(),
+                        totals ? totals + nx : nullptr, totals ? squared_totals + nx : nullptr);
+                    for (std::size_t gx{}; gx != Gx; ++gx) {
+                        pack(x + r0*x_row_offset, n, nx, x_row_offset, x_col_offset, gx, gx+1, x_panel.data(), totals, squared_totals);
+                        for (std::size_t gy{}; gy != Gy; ++gy) {
+                            micro_kernel(x_panel.data(), y_panel.data() + gy*n*width, n, acc);
+                            store_rect(acc, nx, ny, gx, gy, cross);
+                        }
+                    }
+                }
+            }
+
+        } // namespace kernels
+    } // namespace statistics
+} // namespace math
+
+#endif
@@ -0,0 +1,243 @@
+
+#ifndef EWM
+#define EWM
+
+#include "correlation.hh"
+#include "pcc_kernel.hh"
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <valarray>
+#include <vector>
+
+/**
+ * Exponentially weighted Pearson Correlation Coefficient:
+ * a sample observed k updates ago weights 2^(-k/half_life).
+ * Instead of multiplying all the sums by the decay factor on
+ * every update, the weight of the new samples grows by the
+ * inverse factor: the correlation does not depend on a common
+ * scale of the weights, so the result is the same and every
+ * update costs as much as an unweighted one. When the weight
+ * grows too large all the sums are divided by it, which keeps
+ * them (and their products) in range.
+ */
+namespace math
+{
+    namespace statistics
+    {
+
+        namespace detail
+        {
+            // weight that triggers the renormalization, its square
+            // must still be representable
+            template <typename T>
+            constexpr T ewm_limit() {
+                T ans{1};
+                for (int i{}; i < std::numeric_limits<T>::max_exponent / 4; ++i) {
+                    ans *= 2;
+                }
+                return ans;
+            }
+
+            template <typename T>
+            inline T ewm_growth(T half_life) {
+                if (!(half_life > 0)) {
+                    using namespace std::literals;
+                    throw std::invalid_argument("half_life must be positive, found "s + std::to_string(half_life));
+                }
+                return std::exp2(T{1} / half_life);
+            }
+        } // namespace detail
+
+        template <typename T = double>
+        class ewm_pcc {
+        public:
+            using value_type = T;
+        private:
+            value_type growth;          // inverse of the decay per update
+            value_type scale{1};        // weight of the next sample
+            value_type weight{};        // sum of the weights
+            value_type sum_1{}, sum_2{};
+            value_type sum_1_squared{}, sum_2_squared{};
+            value_type sum_prod{};
+
+            void renormalize() {
+                const auto k = 1 / scale;
+                weight *= k;
+                sum_1 *= k;
+                sum_2 *= k;
+                sum_1_squared *= k;
+                sum_2_squared *= k;
+                sum_prod *= k;
+                scale = 1;
+            }
+
+        public:
+            explicit ewm_pcc(value_type half_life) : growth{detail::ewm_growth(half_life)} {}
+
+            auto& accumulate(value_type v_1, value_type v_2) {
+                const auto w = scale;
+                const auto w_1 = w*v_1;
+                const auto w_2 = w*v_2;
+                weight += w;
+                sum_1 += w_1;
+                sum_2 += w_2;
+                sum_1_squared += w_1*v_1;
+                sum_2_squared += w_2*v_2;
+                sum_prod += w_1*v_2;
+                scale *= growth;
+                if (scale > detail::ewm_limit<value_type>()) {
+                    renormalize();
+                }
+                return *this;
+            }
+
+            auto compute() const -> value_type {
+                if (weight == 0) {
+                    return 0;
+                }
+                const auto num = sum_prod - (sum_1*sum_2)/weight;
+                const auto den = (sum_1_squared - (sum_1*sum_1 / weight)) * (sum_2_squared - (sum_2*sum_2 / weight));
+                return den ? num / std::sqrt(den) : 0;
+            }
+
+            // weighted means
+            value_type mean_1() const { return weight ? sum_1 / weight : 0; }
+            value_type mean_2() const { return weight ? sum_2 / weight : 0; }
+
+            // sum of the weights, the newest sample weights 1
+            value_type total_weight() const { return weight * growth / scale; }
+
+            auto& reset() {
+                scale = 1;
+                weight = sum_1 = sum_2 = sum_1_squared = sum_2_squared = sum_prod = 0;
+                return *this;
+            }
+        };
+
+        template <typename T = double>
+        class ewm_multicolumn_pcc {
+        public:
+            using value_type = T;
+        private:
+            int N;
+            value_type growth;
+            value_type scale{1};
+            value_type weight{};
+            std::valarray<value_type> totals;
+            std::valarray<value_type> squared_totals;
+            // same order of math::sets::couple
+            std::valarray<value_type> covariance_total;
+
+            void renormalize() {
+                const auto k = 1 / scale;
+                weight *= k;
+                totals *= k;
+                squared_totals *= k;
+                covariance_total *= k;
+                scale = 1;
+            }
+
+        public:
+            ewm_multicolumn_pcc(int N, value_type half_life)
+            : N{N}, growth{detail::ewm_growth(half_life)}
+            {
+                if (N < 2) {
+                    using namespace std::literals;
+                    throw std::invalid_argument("N must be at least 2, found "s + std::to_string(N));
+                }
+                totals.resize(N);
+                squared_totals.resize(N);
+                covariance_total.resize(std::size_t(N)*(N-1)/2);
+            }
+
+            // count a row of N elements as the newest sample
+            auto& accumulate_row(const value_type* row) {
+                const auto w = scale;
+                auto covariance_iterator = std::begin(covariance_total);
+                for (int i{}; i != N; ++i) {
+                    const auto tmp = w*row[i];
+                    totals[i] += tmp;
+                    squared_totals[i] += tmp*row[i];
+                    for (int j{i+1}; j != N; ++j) {
+                        *covariance_iterator += tmp*row[j];
+                        ++covariance_iterator;
+                    }
+                }
+                weight += w;
+                scale *= growth;
+                if (scale > detail::ewm_limit<value_type>()) {
+                    renormalize();
+                }
+                return *this;
+            }
+
+            auto& accumulate(const value_type* row, std::size_t size) {
+                if (size != (std::size_t)N) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(N) + " found "s + std::to_string(size));
+                }
+                return accumulate_row(row);
+            }
+
+            auto& accumulate(const std::vector<value_type>& row) {
+                return accumulate(row.data(), row.size());
+            }
+
+            int columns() const { return N; }
+            value_type total_weight() const { return weight * growth / scale; }
+
+            auto& reset() {
+                scale = 1;
+                weight = 0;
+                totals = 0;
+                squared_totals = 0;
+                covariance_total = 0;
+                return *this;
+            }
+
+            correlation_matrix<value_type> packed_results() const {
+                correlation_matrix<value_type> ans(N);
+                if (weight == 0) {
+                    return ans;
+                }
+                // same computation of the unweighted accumulator
+                // with the total weight in place of the count
+                std::vector<value_type> deviations(N);
+                for (int c{}; c != N; ++c) {
+                    deviations[c] = squared_totals[c] - (totals[c]*totals[c] / weight);
+                }
+                auto out = ans.data();
+                auto cov = std::begin(covariance_total);
+                for (int i{}; i < N-1; ++i) {
+                    const auto pairs = N-1-i;
+                    kernels::pcc_row(cov, std::begin(totals) + i+1, deviations.data() + i+1, pairs, totals[i], deviations[i], weight, out);
+                    cov += pairs;
+                    out += pairs;
+                }
+                return ans;
+            }
+
+            auto results() const {
+                const auto packed = packed_results();
+                std::map<std::pair<int,int>,value_type> ans;
+                auto packed_iterator = packed.begin();
+                for (int i{}; i!=N-1; ++i) {
+                    for (int j{i+1}; j!=N; ++j) {
+                        ans[std::make_pair(i,j)] = *packed_iterator;
+                        ++packed_iterator;
+                    }
+                }
+                return ans;
+            }
+        };
+
+    } // namespace statistics
+} // namespace math
+
+#endif
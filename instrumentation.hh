@@ -0,0 +1,254 @@
+
+#ifndef INSTRUMENTATION
+#define INSTRUMENTATION
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Optional counters on the hot entry points of the
+ * accumulators: rows and bytes ingested, calls and time spent
+ * in each phase, merges. The hooks are compiled only when
+ * MATH_UTILS_INSTRUMENTATION is defined (before including any
+ * header of the library, in all the translation units),
+ * otherwise they expand to nothing and read() returns zeros.
+ *
+ * Every thread updates its own block of counters without
+ * synchronization, read() adds the blocks of the live threads
+ * to the totals of the threads already terminated.
+ * Single elements (pcc_partial::accumulate) are not
+ * instrumented, only calls processing whole series or rows.
+ * Phases may nest: results includes packed_results.
+ */
+namespace math
+{
+    namespace instrumentation
+    {
+
+#ifdef MATH_UTILS_INSTRUMENTATION
+        constexpr bool enabled = true;
+#else
+        constexpr bool enabled = false;
+#endif
+
+        enum class counter {
+            rows_ingested,      // rows counted by the multicolumn accumulators
+            bytes_ingested,     // bytes of the rows counted
+            pcc_elements,       // pairs of elements of pearson_correlation_coefficient*
+            pcc_bytes,          // bytes read by pearson_correlation_coefficient*
+            merges,             // operator+= and operator-= between accumulators
+        };
+        constexpr std::size_t counters = 5;
+
+        enum class phase {
+            pcc,                // pearson_correlation_coefficient*
+            kernel,             // covariance kernel of the matrix path
+            merge,              // operator+= and operator-= between accumulators
+            packed_results,     // coefficients from the sums
+            results,            // map of the coefficients
+        };
+        constexpr std::size_t phases = 5;
+
+        inline const char* name(counter c) {
+            static const char* names[counters] = {"rows_ingested", "bytes_ingested", "pcc_elements", "pcc_bytes", "merges"};
+            return names[std::size_t(c)];
+        }
+
+        inline const char* name(phase p) {
+            static const char* names[phases] = {"pcc", "kernel", "merge", "packed_results", "results"};
+            return names[std::size_t(p)];
+        }
+
+        // values aggregated over all the threads
+        struct snapshot {
+            std::array<std::uint64_t, counters> values{};
+            std::array<std::uint64_t, phases> calls{};
+            std::array<std::uint64_t, phases> nanoseconds{};
+
+            std::uint64_t operator[](counter c) const { return values[std::size_t(c)]; }
+            std::uint64_t count(phase p) const { return calls[std::size_t(p)]; }
+            double seconds(phase p) const { return nanoseconds[std::size_t(p)] * 1e-9; }
+
+            // one "name value" per line
+            std::string to_text() const {
+                std::ostringstream out;
+                for (std::size_t c{}; c != counters; ++c) {
+                    out << name(counter(c)) << ' ' << values[c] << '\n';
+                }
+                for (std::size_t p{}; p != phases; ++p) {
+                    out << name(phase(p)) << ".calls " << calls[p] << '\n';
+                    out << name(phase(p)) << ".ns " << nanoseconds[p] << '\n';
+                }
+                return out.str();
+            }
+
+            std::string to_json() const {
+                std::ostringstream out;
+                out << "{\"counters\": {";
+                for (std::size_t c{}; c != counters; ++c) {
+                    out << (c ? ", " : "") << '"' << name(counter(c)) << "\": " << values[c];
+                }
+                out << "}, \"phases\": {";
+                for (std::size_t p{}; p != phases; ++p) {
+                    out << (p ? ", " : "") << '"' << name(phase(p)) << "\": {\"calls\": " << calls[p] << ", \"ns\": " << nanoseconds[p] << '}';
+                }
+                out << "}}";
+                return out.str();
+            }
+        };
+
+        namespace detail
+        {
+            // counters, then calls and nanoseconds of the phases
+            constexpr std::size_t slots = counters + 2*phases;
+
+            // written only by its thread, relaxed atomics let
+            // read() see the values without a data race
+            struct thread_block {
+                std::array<std::atomic<std::uint64_t>, slots> values{};
+
+                void add(std::size_t slot, std::uint64_t n) {
+                    values[slot].store(values[slot].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+                }
+            };
+
+            class registry
+            {
+            private:
+                std::mutex m;
+                std::vector<thread_block*> live;
+                std::array<std::uint64_t, slots> retired{};     // threads terminated
+                std::array<std::uint64_t, slots> baseline{};    // subtracted by read()
+
+                std::array<std::uint64_t, slots> total() {
+                    auto ans = retired;
+                    for (auto b : live) {
+                        for (std::size_t s{}; s != slots; ++s) {
+                            ans[s] += b->values[s].load(std::memory_order_relaxed);
+                        }
+                    }
+                    return ans;
+                }
+
+            public:
+                void attach(thread_block* b) {
+                    std::lock_guard<std::mutex> lock(m);
+                    live.push_back(b);
+                }
+
+                void detach(thread_block* b) {
+                    std::lock_guard<std::mutex> lock(m);
+                    for (std::size_t s{}; s != slots; ++s) {
+                        retired[s] += b->values[s].load(std::memory_order_relaxed);
+                    }
+                    for (auto& l : live) {
+                        if (l == b) {
+                            l = live.back();
+                            live.pop_back();
+                            break;
+                        }
+                    }
+                }
+
+                snapshot read() {
+                    std::lock_guard<std::mutex> lock(m);
+                    const auto t = total();
+                    snapshot ans;
+                    for (std::size_t c{}; c != counters; ++c) {
+                        ans.values[c] = t[c] - baseline[c];
+                    }
+                    for (std::size_t p{}; p != phases; ++p) {
+                        ans.calls[p] = t[counters + p] - baseline[counters + p];
+                        ans.nanoseconds[p] = t[counters + phases + p] - baseline[counters + phases + p];
+                    }
+                    return ans;
+                }
+
+                // the blocks are never written by other threads,
+                // so reset moves the baseline instead
+                void reset() {
+                    std::lock_guard<std::mutex> lock(m);
+                    baseline = total();
+                }
+            };
+
+            inline registry& global() {
+                static registry r;
+                return r;
+            }
+
+            // block of the current thread, registered on first use
+            // and folded into the totals when the thread exits
+            struct thread_handle {
+                thread_block block;
+                thread_handle() { global().attach(&block); }
+                ~thread_handle() { global().detach(&block); }
+            };
+
+            inline thread_block& local() {
+                static thread_local thread_handle handle;
+                return handle.block;
+            }
+        } // namespace detail
+
+        inline void add(counter c, std::uint64_t n) {
+            detail::local().add(std::size_t(c), n);
+        }
+
+        // times a phase from construction to destruction
+        class phase_timer
+        {
+        private:
+            using clock = std::chrono::steady_clock;
+            std::size_t p;
+            clock::time_point start;
+        public:
+            explicit phase_timer(phase p) : p{std::size_t(p)}, start{clock::now()} {}
+            phase_timer(const phase_timer&) = delete;
+            phase_timer& operator=(const phase_timer&) = delete;
+            ~phase_timer() {
+                const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+                auto& b = detail::local();
+                b.add(counters + p, 1);
+                b.add(counters + phases + p, ns);
+            }
+        };
+
+        // totals of all the threads since the start (or the last reset)
+        inline snapshot read() {
+            if constexpr (enabled) {
+                return detail::global().read();
+            }
+            return {};
+        }
+
+        inline void reset() {
+            if constexpr (enabled) {
+                detail::global().reset();
+            }
+        }
+
+    } // namespace instrumentation
+} // namespace math
+
+#ifdef MATH_UTILS_INSTRUMENTATION
+#define MATH_INSTRUMENT_CONCAT_(a, b) a##b
+#define MATH_INSTRUMENT_CONCAT(a, b) MATH_INSTRUMENT_CONCAT_(a, b)
+// add n to a counter
+#define MATH_INSTRUMENT_ADD(name, n) ::math::instrumentation::add(::math::instrumentation::counter::name, (n))
+// time the rest of the enclosing scope as a phase
+#define MATH_INSTRUMENT_PHASE(name) \
+    ::math::instrumentation::phase_timer MATH_INSTRUMENT_CONCAT(math_instrument_phase_, __LINE__){::math::instrumentation::phase::name}
+#else
+#define MATH_INSTRUMENT_ADD(name, n) ((void)0)
+#define MATH_INSTRUMENT_PHASE(name) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,169 @@
+
+#ifndef INTEGER_KERNEL
+#define INTEGER_KERNEL
+
+#include "simd.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Exact kernels for integer series: the five sums of
+ * pcc_sums and the dot products of the integer syrk are
+ * accumulated in 64 (or 128) bit integers, so the result does
+ * not depend on the order of the additions.
+ *
+ * int16 goes through pmaddwd (_mm256_madd_epi16), which
+ * multiplies 16 pairs and adds them two by two into 8 int32
+ * lanes. The only sum of two products not fitting in int32
+ * is (-32768)^2 * 2 = 2^31, which wraps to INT32_MIN; every
+ * other result is greater than INT32_MIN. Subtracting 1 from
+ * each lane before widening turns the wrapped value into
+ * 2^31 - 1 without touching the others, the 1s are added back
+ * once at the end.
+ */
+namespace math
+{
+    namespace statistics
+    {
+        namespace kernels
+        {
+
+            // out[5] as pcc_sums, in the integer accumulator A,
+            // starting from element i
+            template <typename T, typename A>
+            inline void pcc_sums_integer_scalar(const T* v1, const T* v2, std::size_t size, std::size_t scatter, std::size_t i, A* out) {
+                A s1{}, s2{}, q1{}, q2{}, p{};
+                auto p1 = v1 + i*scatter;
+                auto p2 = v2 + i*scatter;
+                for (; i < size; ++i, p1 += scatter, p2 += scatter) {
+                    const A a = *p1;
+                    const A b = *p2;
+                    s1 += a;
+                    s2 += b;
+                    q1 += a*a;
+                    q2 += b*b;
+                    p += a*b;
+                }
+                out[0] += s1;
+                out[1] += s2;
+                out[2] += q1;
+                out[3] += q2;
+                out[4] += p;
+            }
+
+            template <typename T, typename A>
+            inline A dot_integer_scalar(const T* a, const T* b, std::size_t n) {
+                A ans{};
+                for (std::size_t k{}; k != n; ++k) {
+                    ans += A(a[k]) * A(b[k]);
+                }
+                return ans;
+            }
+
+#ifdef MATH_SIMD_X86
+            // acc (4 x int64) += the 8 int32 lanes of m
+            MATH_SIMD_TARGET("avx2")
+            inline __m256i widen_add(__m256i acc, __m256i m) {
+                acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(m)));
+                return _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(m, 1)));
+            }
+
+            MATH_SIMD_TARGET("avx2")
+            inline std::int64_t hsum_epi64(__m256i v) {
+                alignas(32) std::int64_t lanes[4];
+                _mm256_store_si256((__m256i*)lanes, v);
+                return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+            }
+
+            // madd of a and b, biased by -1 (see above)
+            MATH_SIMD_TARGET("avx2")
+            inline __m256i madd_biased(__m256i a, __m256i b) {
+                return _mm256_sub_epi32(_mm256_madd_epi16(a, b), _mm256_set1_epi32(1));
+            }
+
+            MATH_SIMD_TARGET("avx2")
+            inline void pcc_sums_avx2(const std::int16_t* v1, const std::int16_t* v2, std::size_t size, std::size_t scatter, std::int64_t* out) {
+                if (scatter != 1) {
+                    // no gather for 16 bit elements
+                    return pcc_sums_integer_scalar(v1, v2, size, scatter, 0, out);
+                }
+                const auto ones = _mm256_set1_epi16(1);
+                __m256i q1 = _mm256_setzero_si256(), q2 = q1, p = q1;
+                std::int64_t s1{}, s2{};
+                std::size_t i{};
+                const auto vector_end = size - size % 16;
+                while (i != vector_end) {
+                    // the lanes of the plain sums grow by at most
+                    // 2^16 per step and stay in int32 for 2^14 steps
+                    const auto end = std::min<std::size_t>(vector_end, i + 16*(std::size_t(1) << 14));
+                    __m256i t1 = _mm256_setzero_si256(), t2 = t1;
+                    for (; i != end; i += 16) {
+                        const auto a = _mm256_loadu_si256((const __m256i*)(v1 + i));
+                        const auto b = _mm256_loadu_si256((const __m256i*)(v2 + i));
+                        t1 = _mm256_add_epi32(t1, _mm256_madd_epi16(a, ones));
+                        t2 = _mm256_add_epi32(t2, _mm256_madd_epi16(b, ones));
+                        q1 = widen_add(q1, madd_biased(a, a));
+                        q2 = widen_add(q2, madd_biased(b, b));
+                        p = widen_add(p, madd_biased(a, b));
+                    }
+                    s1 += hsum_epi64(widen_add(_mm256_setzero_si256(), t1));
+                    s2 += hsum_epi64(widen_add(_mm256_setzero_si256(), t2));
+                }
+                // 8 lanes biased by -1 per step
+                const std::int64_t bias = vector_end / 2;
+                out[0] += s1;
+                out[1] += s2;
+                out[2] += hsum_epi64(q1) + bias;
+                out[3] += hsum_epi64(q2) + bias;
+                out[4] += hsum_epi64(p) + bias;
+                pcc_sums_integer_scalar(v1, v2, size, 1, vector_end, out);
+            }
+
+            MATH_SIMD_TARGET("avx2")
+            inline std::int64_t dot_avx2(const std::int16_t* a, const std::int16_t* b, std::size_t n) {
+                __m256i acc = _mm256_setzero_si256();
+                const auto vector_end = n - n % 16;
+                for (std::size_t k{}; k != vector_end; k += 16) {
+                    const auto x = _mm256_loadu_si256((const __m256i*)(a + k));
+                    const auto y = _mm256_loadu_si256((const __m256i*)(b + k));
+                    acc = widen_add(acc, madd_biased(x, y));
+                }
+                return hsum_epi64(acc) + std::int64_t(vector_end / 2)
+                    + dot_integer_scalar<std::int16_t, std::int64_t>(a + vector_end, b + vector_end, n - vector_end);
+            }
+#endif
+
+            // five sums of two int16 series, exact
+            inline void pcc_sums(const std::int16_t* v1, const std::int16_t* v2, std::size_t size, std::size_t scatter, std::int64_t* out) {
+                for (std::size_t k{}; k != 5; ++k) {
+                    out[k] = 0;
+                }
+#ifdef MATH_SIMD_X86
+                if (simd::active_isa() >= simd::isa::avx2) {
+                    return pcc_sums_avx2(v1, v2, size, scatter, out);
+                }
+#endif
+                pcc_sums_integer_scalar(v1, v2, size, scatter, 0, out);
+            }
+
+            // sum(a[k]*b[k]) for k in [0,n), exact in A
+            template <typename A, typename T>
+            inline A dot_integer(const T* a, const T* b, std::size_t n) {
+#ifdef MATH_SIMD_X86
+                if constexpr (std::is_same_v<T, std::int16_t>) {
+                    if (simd::active_isa() >= simd::isa::avx2) {
+                        return dot_avx2(a, b, n);
+                    }
+                }
+#endif
+                return dot_integer_scalar<T, A>(a, b, n);
+            }
+
+        } // namespace kernels
+    } // namespace statistics
+} // namespace math
+
+#endif
@@ -0,0 +1,315 @@
+
+#ifndef LAGGED
+#define LAGGED
+
+#include "correlation.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Lagged cross-correlation of two series x and y of n
+ * samples: for each lag k in [-L,L] the coefficient of the
+ * pairs (x[t], y[t+k]) for the t where both exist, the same
+ * result of a pcc_partial over those n-|k| pairs.
+ * The products sum(x[t]*y[t+k]) of all the lags come from a
+ * single FFT based correlation, O(n log n) instead of
+ * O(n*L); the sums and the sums of squares of each lag come
+ * from prefix sums. Series are centered on their mean first,
+ * which does not change the coefficients but keeps the
+ * rounding errors of the FFT small.
+ */
+namespace math
+{
+    namespace statistics
+    {
+
+        /**
+         * Iterative radix-2 complex FFT of a fixed size
+         * (power of 2), twiddle factors and bit reversal
+         * permutation are computed once.
+         */
+        template <typename T = double>
+        class fft_plan
+        {
+        public:
+            using complex = std::complex<T>;
+        private:
+            std::size_t n;
+            std::vector<complex> twiddles;      // exp(-2*pi*i*k/n), k in [0,n/2)
+            std::vector<std::uint32_t> reversed;
+
+            // without the checks for NaN and infinities of operator*
+            static complex mul(complex a, complex b) {
+                return {a.real()*b.real() - a.imag()*b.imag(), a.real()*b.imag() + a.imag()*b.real()};
+            }
+
+        public:
+            explicit fft_plan(std::size_t n) : n{n}, twiddles(n/2), reversed(n) {
+                if (n == 0 || (n & (n-1))) {
+                    using namespace std::literals;
+                    throw std::invalid_argument("The size of the FFT must be a power of 2, found "s + std::to_string(n));
+                }
+                const auto pi = std::acos(T{-1});
+                for (std::size_t k{}; k != n/2; ++k) {
+                    const auto angle = -2*pi*T(k)/T(n);
+                    twiddles[k] = {std::cos(angle), std::sin(angle)};
+                }
+                std::size_t bits{};
+                while ((std::size_t(1) << bits) < n) {
+                    ++bits;
+                }
+                for (std::size_t i{}; i != n; ++i) {
+                    std::size_t r{};
+                    for (std::size_t b{}; b != bits; ++b) {
+                        r |= ((i >> b) & 1) << (bits - 1 - b);
+                    }
+                    reversed[i] = r;
+                }
+            }
+
+            std::size_t size() const { return n; }
+
+            // in place, the inverse is scaled by 1/n
+            void transform(complex* a, bool inverse = false) const {
+                for (std::size_t i{}; i != n; ++i) {
+                    if (i < reversed[i]) {
+                        std::swap(a[i], a[reversed[i]]);
+                    }
+                }
+                for (std::size_t len{2}; len <= n; len <<= 1) {
+                    const auto half = len / 2;
+                    const auto step = n / len;
+                    for (std::size_t i{}; i < n; i += len) {
+                        for (std::size_t j{}; j != half; ++j) {
+                            const auto w = inverse ? std::conj(twiddles[j*step]) : twiddles[j*step];
+                            const auto u = a[i + j];
+                            const auto v = mul(a[i + j + half], w);
+                            a[i + j] = u + v;
+                            a[i + j + half] = u - v;
+                        }
+                    }
+                }
+                if (inverse) {
+                    const T scale = T{1} / n;
+                    for (std::size_t i{}; i != n; ++i) {
+                        a[i] *= scale;
+                    }
+                }
+            }
+
+            // spectrum of two real series at once: transform x + i*y
+            // and split the result using the symmetries of the
+            // spectra of real series
+            void transform_real_pair(complex* z, complex* x, complex* y) const {
+                transform(z);
+                for (std::size_t k{}; k != n; ++k) {
+                    const auto a = z[k];
+                    const auto b = std::conj(z[(n - k) & (n - 1)]);
+                    x[k] = (a + b) * T(0.5);
+                    y[k] = complex{a.imag() - b.imag(), b.real() - a.real()} * T(0.5);
+                }
+            }
+
+            static complex conj_mul(complex a, complex b) {
+                return mul(std::conj(a), b);
+            }
+        };
+
+        template <typename T = double>
+        class lagged_correlation
+        {
+        public:
+            using value_type = T;
+            using complex = std::complex<T>;
+        private:
+            std::size_t L;
+            // plans by size
+            std::map<std::size_t, fft_plan<T>> plans;
+            // scratch buffers reused by all the calls
+            std::vector<complex> z, spectrum_x, spectrum_y;
+            std::vector<T> prefix;
+            // series used by the pairs, sorted, and the slot in
+            // used of the first and second series of every pair
+            std::vector<int> used;
+            std::vector<std::size_t> slots;
+
+            const fft_plan<T>& plan_for(std::size_t n) {
+                std::size_t size{1};
+                // no circular aliasing for the lags in [-L,L]
+                while (size < n + L) {
+                    size <<= 1;
+                }
+                auto it = plans.find(size);
+                if (it == plans.end()) {
+                    it = plans.emplace(size, fft_plan<T>(size)).first;
+                }
+                return it->second;
+            }
+
+            // center the series (stride row_offset) and store the
+            // prefix sums of the values and of their squares in
+            // prefix[0..n] and prefix[n+1..2n+1]
+            static T center(const T* v, std::size_t n, std::size_t stride, complex* out, bool imaginary, T* prefix) {
+                T mean{};
+                for (std::size_t t{}; t != n; ++t) {
+                    mean += v[t*stride];
+                }
+                mean /= n;
+                prefix[0] = prefix[n+1] = 0;
+                for (std::size_t t{}; t != n; ++t) {
+                    const auto c = v[t*stride] - mean;
+                    if (imaginary) {
+                        out[t].imag(c);
+                    } else {
+                        out[t].real(c);
+                    }
+                    prefix[t+1] = prefix[t] + c;
+                    prefix[n+2+t] = prefix[n+1+t] + c*c;
+                }
+                return mean;
+            }
+
+            // coefficients of the lags [-L,L] from the circular
+            // correlation in the real (or imaginary) part of corr
+            // and the prefix sums
+            void finish(const complex* corr, bool imaginary, std::size_t size, const T* px, const T* py, std::size_t n, T* out) const {
+                const long long lag = L;
+                for (long long k{-lag}; k <= lag; ++k) {
+                    const auto m = n - std::size_t(k < 0 ? -k : k);
+                    const std::size_t a = k < 0 ? -k : 0;     // first x
+                    const std::size_t b = k < 0 ? 0 : k;      // first y
+                    const auto c = corr[k < 0 ? size + k : k];
+                    pcc_partial<T> p;
+                    p.count = m;
+                    p.sum_1 = px[a + m] - px[a];
+                    p.sum_2 = py[b + m] - py[b];
+                    p.sum_1_squared = px[n+1 + a + m] - px[n+1 + a];
+                    p.sum_2_squared = py[n+1 + b + m] - py[n+1 + b];
+                    p.sum_prod = imaginary ? c.imag() : c.real();
+                    out[k + lag] = p.compute();
+                }
+            }
+
+        public:
+            explicit lagged_correlation(std::size_t max_lag) : L{max_lag} {}
+
+            std::size_t max_lag() const { return L; }
+            // values returned for each pair
+            std::size_t lags() const { return 2*L + 1; }
+
+            // out[k+L] is the coefficient of lag k, k in [-L,L],
+            // that is of x[t] and y[t+k]
+            void compute(const T* x, const T* y, std::size_t n, T* out, std::size_t stride = 1) {
+                const std::pair<int,int> pair{0, 1};
+                const T* columns[2] = {x, y};
+                compute_pairs(columns, n, stride, &pair, 1, out);
+            }
+
+            std::vector<T> compute(const std::vector<T>& x, const std::vector<T>& y) {
+                if (x.size() != y.size()) {
+                    using namespace std::literals;
+                    throw std::invalid_argument("Arguments must have the same length, found len(x)="s + std::to_string(x.size()) + ", len(y)=" + std::to_string(y.size()));
+                }
+                std::vector<T> ans(lags());
+                compute(x.data(), y.data(), x.size(), ans.data());
+                return ans;
+            }
+
+            // Lagged correlation of many pairs of series of n
+            // elements (stride apart): pair p correlates
+            // columns[pairs[p].first] and columns[pairs[p].second] and
+            // its lags go to out[p*lags(), (p+1)*lags()).
+            // The spectrum of each series is computed once, two
+            // series per FFT, and the correlations are transformed
+            // back two pairs per FFT.
+            template <typename Columns>
+            void compute_pairs(const Columns& columns, std::size_t n, std::size_t stride, const std::pair<int,int>* pairs, std::size_t count, T* out) {
+                if (n <= L) {
+                    using namespace std::literals;
+                    throw std::invalid_argument("Series of "s + std::to_string(n) + " elements are too short for lags up to "s + std::to_string(L));
+                }
+                const auto& plan = plan_for(n);
+                const auto size = plan.size();
+                used.clear();
+                for (std::size_t p{}; p != count; ++p) {
+                    used.push_back(pairs[p].first);
+                    used.push_back(pairs[p].second);
+                }
+                std::sort(used.begin(), used.end());
+                used.erase(std::unique(used.begin(), used.end()), used.end());
+                slots.resize(2*count);
+                for (std::size_t p{}; p != count; ++p) {
+                    slots[2*p] = std::lower_bound(used.begin(), used.end(), pairs[p].first) - used.begin();
+                    slots[2*p+1] = std::lower_bound(used.begin(), used.end(), pairs[p].second) - used.begin();
+                }
+                spectrum_x.resize(size*used.size());
+                prefix.resize((2*n + 2)*used.size());
+                z.resize(size);
+                spectrum_y.resize(size);
+                for (std::size_t s{}; s < used.size(); s += 2) {
+                    std::fill(z.begin(), z.end(), complex{});
+                    center(columns[used[s]], n, stride, z.data(), false, prefix.data() + s*(2*n+2));
+                    auto second = spectrum_y.data();
+                    if (s + 1 != used.size()) {
+                        center(columns[used[s+1]], n, stride, z.data(), true, prefix.data() + (s+1)*(2*n+2));
+                        second = spectrum_x.data() + (s+1)*size;
+                    }
+                    plan.transform_real_pair(z.data(), spectrum_x.data() + s*size, second);
+                }
+                for (std::size_t p{}; p < count; p += 2) {
+                    // two real correlations in the real and imaginary parts
+                    const auto two = p + 1 != count;
+                    const auto x1 = spectrum_x.data() + slots[2*p]*size;
+                    const auto y1 = spectrum_x.data() + slots[2*p+1]*size;
+                    for (std::size_t k{}; k != size; ++k) {
+                        z[k] = fft_plan<T>::conj_mul(x1[k], y1[k]);
+                    }
+                    if (two) {
+                        const auto x2 = spectrum_x.data() + slots[2*p+2]*size;
+                        const auto y2 = spectrum_x.data() + slots[2*p+3]*size;
+                        for (std::size_t k{}; k != size; ++k) {
+                            const auto c = fft_plan<T>::conj_mul(x2[k], y2[k]);
+                            // z += i*c
+                            z[k] += complex{-c.imag(), c.real()};
+                        }
+                    }
+                    plan.transform(z.data(), true);
+                    finish(z.data(), false, size,
+                        prefix.data() + slots[2*p]*(2*n+2), prefix.data() + slots[2*p+1]*(2*n+2),
+                        n, out + p*lags());
+                    if (two) {
+                        finish(z.data(), true, size,
+                            prefix.data() + slots[2*p+2]*(2*n+2), prefix.data() + slots[2*p+3]*(2*n+2),
+                            n, out + (p+1)*lags());
+                    }
+                }
+            }
+
+            // pairs of columns of a matrix (described as for
+            // multicolumn_pcc_accumulator::accumulate)
+            void compute_pairs(
+                const T* matrix, std::size_t rows, std::size_t row_offset, std::size_t col_offset,
+                const std::vector<std::pair<int,int>>& pairs, T* out
+            ) {
+                struct column_view {
+                    const T* matrix;
+                    std::size_t col_offset;
+                    const T* operator[](int c) const { return matrix + c*col_offset; }
+                };
+                compute_pairs(column_view{matrix, col_offset}, rows, row_offset, pairs.data(), pairs.size(), out);
+            }
+        };
+
+    } // namespace statistics
+} // namespace math
+
+#endif
@@ -0,0 +1,148 @@
+
+#ifndef MAPPED_FILE
+#define MAPPED_FILE
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace math
+{
+    namespace io
+    {
+
+        /**
+         * RAII wrapper of a file mapped in memory (POSIX mmap).
+         * A file opened for writing is created (or truncated)
+         * with the requested size.
+         */
+        class mapped_file
+        {
+        private:
+            int fd{-1};
+            void* base{};
+            std::size_t length{};
+            bool writable{};
+
+            [[noreturn]] static void fail(const std::string& what, const std::string& path) {
+                throw std::system_error(errno, std::generic_category(), what + " '" + path + "'");
+            }
+
+            void release() {
+                if (base) {
+                    ::munmap(base, length);
+                }
+                if (fd != -1) {
+                    ::close(fd);
+                }
+                base = nullptr;
+                fd = -1;
+                length = 0;
+            }
+
+        public:
+            mapped_file() = default;
+
+            // map an existing file read only
+            explicit mapped_file(const std::string& path) {
+                fd = ::open(path.c_str(), O_RDONLY);
+                if (fd == -1) {
+                    fail("cannot open", path);
+                }
+                struct stat st;
+                if (::fstat(fd, &st) == -1) {
+                    release();
+                    fail("cannot stat", path);
+                }
+                length = st.st_size;
+                if (length) {
+                    base = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+                    if (base == MAP_FAILED) {
+                        base = nullptr;
+                        release();
+                        fail("cannot map", path);
+                    }
+                }
+            }
+
+            // create a file of size bytes and map it read/write
+            mapped_file(const std::string& path, std::size_t size) : length{size}, writable{true} {
+                fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+                if (fd == -1) {
+                    fail("cannot create", path);
+                }
+                if (::ftruncate(fd, size) == -1) {
+                    release();
+                    fail("cannot resize", path);
+                }
+                if (length) {
+                    base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                    if (base == MAP_FAILED) {
+                        base = nullptr;
+                        release();
+                        fail("cannot map", path);
+                    }
+                }
+            }
+
+            mapped_file(const mapped_file&) = delete;
+            mapped_file& operator=(const mapped_file&) = delete;
+
+            mapped_file(mapped_file&& o) noexcept
+            : fd{std::exchange(o.fd, -1)}, base{std::exchange(o.base, nullptr)},
+              length{std::exchange(o.length, 0)}, writable{o.writable}
+            {}
+
+            mapped_file& operator=(mapped_file&& o) noexcept {
+                if (this != &o) {
+                    release();
+                    fd = std::exchange(o.fd, -1);
+                    base = std::exchange(o.base, nullptr);
+                    length = std::exchange(o.length, 0);
+                    writable = o.writable;
+                }
+                return *this;
+            }
+
+            ~mapped_file() {
+                release();
+            }
+
+            const char* data() const { return static_cast<const char*>(base); }
+            char* data() { return static_cast<char*>(base); }
+            std::size_t size() const { return length; }
+
+            // hint the kernel about the access pattern of
+            // [offset, offset+bytes), errors are ignored since
+            // they are just hints
+            void advise(std::size_t offset, std::size_t bytes, int advice) const {
+                if (!base || offset >= length) {
+                    return;
+                }
+                // madvise requires an address aligned to a page
+                static const std::size_t page = ::sysconf(_SC_PAGESIZE);
+                const auto begin = offset / page * page;
+                const auto end = std::min(length, offset + bytes);
+                ::madvise(static_cast<char*>(base) + begin, end - begin, advice);
+            }
+
+            // write dirty pages back to the file
+            void sync() const {
+                if (base && writable) {
+                    ::msync(base, length, MS_SYNC);
+                }
+            }
+        };
+
+    } // namespace io
+} // namespace math
+
+#endif
@@ -0,0 +1,351 @@
+
+#ifndef MASKED_CORRELATION
+#define MASKED_CORRELATION
+
+#include "correlation.hh"
+#include "covariance_kernel.hh"
+#include "masked_kernel.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <valarray>
+#include <vector>
+
+/**
+ * Pearson Correlation Coefficient of data with missing
+ * values, represented by NaN: every pair of series only
+ * considers the rows where both values are present
+ * (pairwise deletion), so each pair has its own count and
+ * its own sums. Dense chunks, without any NaN, go through
+ * the unmasked kernels.
+ */
+namespace math
+{
+    namespace statistics
+    {
+
+        namespace detail
+        {
+            // rows checked at once for missing values
+            constexpr std::size_t masked_chunk = 1024;
+
+            template <typename T>
+            inline pcc_partial<T> masked_partial(const T* v1, const T* v2, std::size_t size, std::size_t scatter) {
+                T sums[5];
+                pcc_partial<T> ans;
+                ans.count = kernels::pcc_sums_masked(v1, v2, size, scatter, sums);
+                ans.sum_1 = sums[0];
+                ans.sum_2 = sums[1];
+                ans.sum_1_squared = sums[2];
+                ans.sum_2_squared = sums[3];
+                ans.sum_prod = sums[4];
+                return ans;
+            }
+        } // namespace detail
+
+        // pcc_partial of the positions where neither v1 nor v2 is NaN
+        template <typename T>
+        inline pcc_partial<T> masked_pearson_correlation_coefficient(const T* v1, const T* v2, std::size_t size) {
+            static_assert(std::is_floating_point_v<T>, "Missing values are represented by NaN");
+            pcc_partial<T> ans;
+            for (std::size_t i{}; i < size; i += detail::masked_chunk) {
+                const auto n = std::min(detail::masked_chunk, size - i);
+                if (!kernels::any_nan(v1 + i, n) && !kernels::any_nan(v2 + i, n)) {
+                    ans += pearson_correlation_coefficient(v1 + i, v2 + i, n);
+                } else {
+                    ans += detail::masked_partial(v1 + i, v2 + i, n, 1);
+                }
+            }
+            return ans;
+        }
+
+        template <typename T>
+        inline pcc_partial<T> masked_pearson_correlation_coefficient(const std::vector<T>& v1, const std::vector<T>& v2) {
+            if (v1.size() != v2.size()) {
+                using namespace std::literals;
+                throw std::invalid_argument("Arguments must have the same length, found len(v1)="s + std::to_string(v1.size()) + ", len(v2)=" + std::to_string(v2.size()));
+            }
+            return masked_pearson_correlation_coefficient(v1.data(), v2.data(), v1.size());
+        }
+
+        template <typename T>
+        inline pcc_partial<T> masked_pearson_correlation_coefficient_scattered(const T* v1, const T* v2, std::size_t size, std::size_t scatter = 1) {
+            static_assert(std::is_floating_point_v<T>, "Missing values are represented by NaN");
+            if (scatter == 0) {
+                throw std::invalid_argument("Scatter must be graeter than 0");
+            }
+            return detail::masked_partial(v1, v2, size, scatter);
+        }
+
+        /**
+         * multicolumn_pcc_accumulator for data with missing
+         * values. Rows (or blocks of rows of a matrix) without
+         * NaN are counted by an ordinary accumulator, the others
+         * update per pair sums and counts: the block is blended
+         * into values with NaN set to 0 (Z), their squares (Z2)
+         * and a 0/1 validity matrix (V), so that the sums over
+         * the rows present in both columns are the products
+         * Z'V, Z2'V and Z'Z computed by the blocked kernels,
+         * while the counts come from the popcount of the
+         * intersection of the validity bitmasks.
+         */
+        template <typename T = double>
+        class masked_multicolumn_pcc_accumulator {
+            static_assert(std::is_floating_point_v<T>, "Missing values are represented by NaN");
+        public:
+            using value_type = T;
+        private:
+            // rows blended at once
+            static constexpr std::size_t block = 256;
+            static constexpr std::size_t words = block / 64;
+
+            int N;
+            // rows without missing values
+            multicolumn_pcc_accumulator<value_type> dense;
+            // sums of the other rows, for each pair in couple order:
+            // only the rows where both the columns are present
+            std::valarray<long long> pair_count;
+            std::valarray<value_type> sum_1, sum_2, sum_1_squared, sum_2_squared, sum_prod;
+            long long int masked_rows{};
+
+            std::size_t index(int i, int j) const {
+                return kernels::pair_index(N, i, j);
+            }
+
+            void check_columns(std::size_t cols) const {
+                if (cols != (std::size_t)N) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(N) + " found "s + std::to_string(cols));
+                }
+            }
+
+            bool has_missing(const value_type* matrix, std::size_t rows, std::size_t row_offset, std::size_t col_offset) const {
+                if (row_offset == 1) {
+                    for (int c{}; c != N; ++c) {
+                        if (kernels::any_nan(matrix + c*col_offset, rows)) {
+                            return true;
+                        }
+                    }
+                } else if (col_offset == 1) {
+                    for (std::size_t r{}; r != rows; ++r) {
+                        if (kernels::any_nan(matrix + r*row_offset, N)) {
+                            return true;
+                        }
+                    }
+                } else {
+                    bool ans{};
+                    for (std::size_t r{}; r != rows; ++r) {
+                        for (int c{}; c != N; ++c) {
+                            const auto x = matrix[r*row_offset + c*col_offset];
+                            ans |= x != x;
+                        }
+                    }
+                    return ans;
+                }
+                return false;
+            }
+
+            // rows <= block rows with some missing value
+            void accumulate_masked(const value_type* matrix, std::size_t rows, std::size_t row_offset, std::size_t col_offset) {
+                using buffer = std::vector<value_type, simd::aligned_allocator<value_type>>;
+                static thread_local buffer z, z2, v, zv, z2v;
+                static thread_local std::vector<std::uint64_t> masks;
+                z.resize(N*block);
+                z2.resize(N*block);
+                v.resize(N*block);
+                masks.resize(N*words);
+                zv.assign(std::size_t(N)*N, value_type{});
+                z2v.assign(std::size_t(N)*N, value_type{});
+                for (int c{}; c != N; ++c) {
+                    kernels::blend_column(matrix + c*col_offset, rows, row_offset, z.data() + c*block, z2.data() + c*block, v.data() + c*block, masks.data() + c*words);
+                }
+                // zv[i*N + j] is the sum of the column i over the rows where j is present
+                kernels::gemm(z.data(), N, 1, block, v.data(), N, 1, block, rows, zv.data(), (value_type*)nullptr, (value_type*)nullptr);
+                kernels::gemm(z2.data(), N, 1, block, v.data(), N, 1, block, rows, z2v.data(), (value_type*)nullptr, (value_type*)nullptr);
+                // the cross products go straight to the packed triangle
+                kernels::syrk(z.data(), rows, N, 1, block, 0, kernels::groups(N), std::begin(sum_prod), (value_type*)nullptr, (value_type*)nullptr);
+                const auto w = (rows + 63) / 64;
+                for (int i{}, k{}; i != N; ++i) {
+                    for (int j{i+1}; j != N; ++j, ++k) {
+                        pair_count[k] += kernels::common_rows(masks.data() + i*words, masks.data() + j*words, w);
+                        sum_1[k] += zv[i*N + j];
+                        sum_2[k] += zv[j*N + i];
+                        sum_1_squared[k] += z2v[i*N + j];
+                        sum_2_squared[k] += z2v[j*N + i];
+                    }
+                }
+                masked_rows += rows;
+            }
+
+        public:
+            masked_multicolumn_pcc_accumulator(int N)
+            : N{N}, dense(N >= 2 ? N : 2)
+            {
+                if (N < 2) {
+                    using namespace std::literals;
+                    throw std::invalid_argument("N must be at least 2, found "s + std::to_string(N));
+                }
+                const auto pairs = std::size_t(N)*(N-1)/2;
+                pair_count.resize(pairs);
+                sum_1.resize(pairs);
+                sum_2.resize(pairs);
+                sum_1_squared.resize(pairs);
+                sum_2_squared.resize(pairs);
+                sum_prod.resize(pairs);
+            }
+
+            // count a single row of N elements, NaN are missing values
+            auto& accumulate_row(const value_type* row) {
+                if (!kernels::any_nan(row, N)) {
+                    dense.accumulate_row(row);
+                    return *this;
+                }
+                for (int i{}; i != N; ++i) {
+                    const auto a = row[i];
+                    if (a != a) {
+                        continue;
+                    }
+                    for (int j{i+1}; j != N; ++j) {
+                        const auto b = row[j];
+                        if (b != b) {
+                            continue;
+                        }
+                        const auto k = index(i, j);
+                        ++pair_count[k];
+                        sum_1[k] += a;
+                        sum_2[k] += b;
+                        sum_1_squared[k] += a*a;
+                        sum_2_squared[k] += b*b;
+                        sum_prod[k] += a*b;
+                    }
+                }
+                ++masked_rows;
+                return *this;
+            }
+
+            auto& accumulate(const value_type* row, std::size_t size) {
+                check_columns(size);
+                return accumulate_row(row);
+            }
+
+            auto& accumulate(const std::vector<value_type>& row) {
+                return accumulate(row.data(), row.size());
+            }
+
+            // same as multicolumn_pcc_accumulator::accumulate(matrix, ...),
+            // consecutive blocks without missing values are passed
+            // to the dense accumulator at once
+            auto& accumulate(
+                const value_type* matrix,
+                std::size_t rows,
+                std::size_t cols,
+                std::size_t row_offset,
+                std::size_t col_offset
+            ) {
+                check_columns(cols);
+                std::size_t dense_begin{};
+                for (std::size_t r0{}; r0 < rows; r0 += block) {
+                    const auto n = std::min(block, rows - r0);
+                    const auto chunk = matrix + r0*row_offset;
+                    if (!has_missing(chunk, n, row_offset, col_offset)) {
+                        continue;
+                    }
+                    if (dense_begin != r0) {
+                        dense.accumulate(matrix + dense_begin*row_offset, r0 - dense_begin, cols, row_offset, col_offset);
+                    }
+                    accumulate_masked(chunk, n, row_offset, col_offset);
+                    dense_begin = r0 + n;
+                }
+                if (dense_begin < rows) {
+                    dense.accumulate(matrix + dense_begin*row_offset, rows - dense_begin, cols, row_offset, col_offset);
+                }
+                return *this;
+            }
+
+            int columns() const { return N; }
+            // number of rows accumulated so far, with or without missing values
+            long long int rows() const { return dense.rows() + masked_rows; }
+            // rows where both the columns i and j are present
+            long long int count(int i, int j) const {
+                if (i > j) {
+                    std::swap(i, j);
+                }
+                return dense.rows() + pair_count[index(i, j)];
+            }
+
+            auto& operator+=(const masked_multicolumn_pcc_accumulator<T>& o) {
+                if (N != o.N) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Size mismatch, this->N = "s + std::to_string(N) + ", other.N = "s + std::to_string(o.N));
+                }
+                dense += o.dense;
+                pair_count += o.pair_count;
+                sum_1 += o.sum_1;
+                sum_2 += o.sum_2;
+                sum_1_squared += o.sum_1_squared;
+                sum_2_squared += o.sum_2_squared;
+                sum_prod += o.sum_prod;
+                masked_rows += o.masked_rows;
+                return *this;
+            }
+
+            auto& reset() {
+                dense.reset();
+                pair_count = 0;
+                sum_1 = 0;
+                sum_2 = 0;
+                sum_1_squared = 0;
+                sum_2_squared = 0;
+                sum_prod = 0;
+                masked_rows = 0;
+                return *this;
+            }
+
+            // partial of the pair (i,j), i < j
+            pcc_partial<value_type> partial(int i, int j) const {
+                auto ans = dense.partial(i, j);
+                const auto k = index(i, j);
+                pcc_partial<value_type> masked;
+                masked.count = pair_count[k];
+                masked.sum_1 = sum_1[k];
+                masked.sum_2 = sum_2[k];
+                masked.sum_1_squared = sum_1_squared[k];
+                masked.sum_2_squared = sum_2_squared[k];
+                masked.sum_prod = sum_prod[k];
+                return ans += masked;
+            }
+
+            correlation_matrix<value_type> packed_results() const {
+                correlation_matrix<value_type> ans(N);
+                for (int i{}, k{}; i != N; ++i) {
+                    for (int j{i+1}; j != N; ++j, ++k) {
+                        ans[k] = partial(i, j).compute();
+                    }
+                }
+                return ans;
+            }
+
+            auto results() const {
+                const auto packed = packed_results();
+                std::map<std::pair<int,int>,value_type> ans;
+                auto packed_iterator = packed.begin();
+                for (int i{}; i!=N-1; ++i) {
+                    for (int j{i+1}; j!=N; ++j) {
+                        ans[std::make_pair(i,j)] = *packed_iterator;
+                        ++packed_iterator;
+                    }
+                }
+                return ans;
+            }
+        };
+
+    } // namespace statistics
+} // namespace math
+
+#endif
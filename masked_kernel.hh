@@ -0,0 +1,202 @@
+
+#ifndef MASKED_KERNEL
+#define MASKED_KERNEL
+
+#include "simd.hh"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Kernels for series with missing values, represented by
+ * NaN. The masked sums consider only the positions where
+ * both values are present: a NaN compared with itself is
+ * unordered, the comparison gives a lane mask used to blend
+ * the missing values to 0 and, through popcount, the number
+ * of valid positions.
+ */
+namespace math
+{
+    namespace statistics
+    {
+        namespace kernels
+        {
+
+            // true if any of the size elements is NaN
+            template <typename T>
+            inline bool any_nan_scalar(const T* v, std::size_t size, std::size_t i) {
+                bool ans{};
+                for (; i < size; ++i) {
+                    ans |= v[i] != v[i];
+                }
+                return ans;
+            }
+
+            // out[5] as pcc_sums() over the positions where neither
+            // v1 nor v2 is NaN, returns the number of such positions
+            template <typename T>
+            inline std::size_t pcc_sums_masked_scalar(const T* v1, const T* v2, std::size_t size, std::size_t scatter, std::size_t i, T* out) {
+                std::size_t count{};
+                for (; i < size; ++i) {
+                    const auto a = v1[i*scatter];
+                    const auto b = v2[i*scatter];
+                    if (a != a || b != b) {
+                        continue;
+                    }
+                    out[0] += a;
+                    out[1] += b;
+                    out[2] += a*a;
+                    out[3] += b*b;
+                    out[4] += a*b;
+                    ++count;
+                }
+                return count;
+            }
+
+#ifdef MATH_SIMD_X86
+            MATH_SIMD_TARGET("avx2")
+            inline bool any_nan_avx2(const double* v, std::size_t size) {
+                auto acc = _mm256_setzero_pd();
+                std::size_t i{};
+                for (; i + 4 <= size; i += 4) {
+                    const auto x = _mm256_loadu_pd(v + i);
+                    acc = _mm256_or_pd(acc, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+                }
+                return _mm256_movemask_pd(acc) || any_nan_scalar(v, size, i);
+            }
+
+            MATH_SIMD_TARGET("avx2")
+            inline bool any_nan_avx2(const float* v, std::size_t size) {
+                auto acc = _mm256_setzero_ps();
+                std::size_t i{};
+                for (; i + 8 <= size; i += 8) {
+                    const auto x = _mm256_loadu_ps(v + i);
+                    acc = _mm256_or_ps(acc, _mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+                }
+                return _mm256_movemask_ps(acc) || any_nan_scalar(v, size, i);
+            }
+
+            MATH_SIMD_TARGET("avx2,fma,popcnt")
+            inline std::size_t pcc_sums_masked_avx2(const double* v1, const double* v2, std::size_t size, double* out) {
+                __m256d acc[5];
+                for (auto& a : acc) {
+                    a = _mm256_setzero_pd();
+                }
+                std::size_t count{}, i{};
+                for (; i + 4 <= size; i += 4) {
+                    auto a = _mm256_loadu_pd(v1 + i);
+                    auto b = _mm256_loadu_pd(v2 + i);
+                    // lanes where neither a nor b is NaN
+                    const auto valid = _mm256_cmp_pd(a, b, _CMP_ORD_Q);
+                    a = _mm256_and_pd(a, valid);
+                    b = _mm256_and_pd(b, valid);
+                    acc[0] = _mm256_add_pd(acc[0], a);
+                    acc[1] = _mm256_add_pd(acc[1], b);
+                    acc[2] = _mm256_fmadd_pd(a, a, acc[2]);
+                    acc[3] = _mm256_fmadd_pd(b, b, acc[3]);
+                    acc[4] = _mm256_fmadd_pd(a, b, acc[4]);
+                    count += __builtin_popcount(_mm256_movemask_pd(valid));
+                }
+                for (std::size_t k{}; k != 5; ++k) {
+                    double lanes[4];
+                    _mm256_storeu_pd(lanes, acc[k]);
+                    out[k] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+                }
+                return count + pcc_sums_masked_scalar(v1, v2, size, 1, i, out);
+            }
+
+            MATH_SIMD_TARGET("avx2,fma,popcnt")
+            inline std::size_t pcc_sums_masked_avx2(const float* v1, const float* v2, std::size_t size, float* out) {
+                __m256 acc[5];
+                for (auto& a : acc) {
+                    a = _mm256_setzero_ps();
+                }
+                std::size_t count{}, i{};
+                for (; i + 8 <= size; i += 8) {
+                    auto a = _mm256_loadu_ps(v1 + i);
+                    auto b = _mm256_loadu_ps(v2 + i);
+                    const auto valid = _mm256_cmp_ps(a, b, _CMP_ORD_Q);
+                    a = _mm256_and_ps(a, valid);
+                    b = _mm256_and_ps(b, valid);
+                    acc[0] = _mm256_add_ps(acc[0], a);
+                    acc[1] = _mm256_add_ps(acc[1], b);
+                    acc[2] = _mm256_fmadd_ps(a, a, acc[2]);
+                    acc[3] = _mm256_fmadd_ps(b, b, acc[3]);
+                    acc[4] = _mm256_fmadd_ps(a, b, acc[4]);
+                    count += __builtin_popcount(_mm256_movemask_ps(valid));
+                }
+                for (std::size_t k{}; k != 5; ++k) {
+                    float lanes[8];
+                    _mm256_storeu_ps(lanes, acc[k]);
+                    out[k] += ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+                }
+                return count + pcc_sums_masked_scalar(v1, v2, size, 1, i, out);
+            }
+#endif
+
+            template <typename T>
+            inline bool any_nan(const T* v, std::size_t size) {
+#ifdef MATH_SIMD_X86
+                if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>) {
+                    if (simd::active_isa() >= simd::isa::avx2) {
+                        return any_nan_avx2(v, size);
+                    }
+                }
+#endif
+                return any_nan_scalar(v, size, 0);
+            }
+
+            // out[5] (set, not added) and number of valid positions
+            template <typename T>
+            inline std::size_t pcc_sums_masked(const T* v1, const T* v2, std::size_t size, std::size_t scatter, T* out) {
+                for (std::size_t k{}; k != 5; ++k) {
+                    out[k] = T{};
+                }
+#ifdef MATH_SIMD_X86
+                if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>) {
+                    if (scatter == 1 && simd::active_isa() >= simd::isa::avx2) {
+                        return pcc_sums_masked_avx2(v1, v2, size, out);
+                    }
+                }
+#endif
+                return pcc_sums_masked_scalar(v1, v2, size, scatter, 0, out);
+            }
+
+            // Blend a column of rows elements (stride row_offset)
+            // into z (NaN replaced by 0), z2 (squares of z) and
+            // v (1 if present, 0 if missing), and set the bits of
+            // the present rows in mask (one bit per row, 64 rows
+            // per word).
+            template <typename T>
+            inline void blend_column(const T* column, std::size_t rows, std::size_t row_offset, T* z, T* z2, T* v, std::uint64_t* mask) {
+                for (std::size_t w{}; w*64 < rows; ++w) {
+                    std::uint64_t bits{};
+                    const auto end = rows < (w+1)*64 ? rows : (w+1)*64;
+                    for (auto r = w*64; r != end; ++r) {
+                        const auto x = column[r*row_offset];
+                        const bool present = x == x;
+                        z[r] = present ? x : T{};
+                        z2[r] = z[r]*z[r];
+                        v[r] = present;
+                        bits |= std::uint64_t(present) << (r - w*64);
+                    }
+                    mask[w] = bits;
+                }
+            }
+
+            // rows present in both the columns of masks m1 and m2
+            inline std::size_t common_rows(const std::uint64_t* m1, const std::uint64_t* m2, std::size_t words) {
+                std::size_t ans{};
+                for (std::size_t w{}; w != words; ++w) {
+                    ans += __builtin_popcountll(m1[w] & m2[w]);
+                }
+                return ans;
+            }
+
+        } // namespace kernels
+    } // namespace statistics
+} // namespace math
+
+#endif
@@ -0,0 +1,401 @@
+
+#ifndef PAIR_SEARCH
+#define PAIR_SEARCH
+
+#include "correlation.hh"
+#include "covariance_kernel.hh"
+#include "thread_pool.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Search of the strongly correlated pairs of columns of very
+ * wide matrices without computing all the pairs.
+ *
+ * Every column is z-normalized and projected on K random
+ * gaussian directions, the signs of the projections form a
+ * sketch of K bits (SimHash): two columns with correlation r
+ * have the same bit with probability 1 - acos(r)/pi, while for
+ * -r the bits are complemented. The sketch is split in bands
+ * of band_bits bits, two columns become candidates when a band
+ * is equal (positive correlation) or complemented (negative
+ * correlation). The candidates are then verified exactly with
+ * pcc_partial as soon as they are enumerated, each one only in
+ * the first band where it collides, so that no set of
+ * candidates is ever stored: memory is O(N*K) bits, O(N) for
+ * the band being enumerated and a bounded buffer of pairs.
+ * By default band_bits grows as log2(N), keeping the expected
+ * candidates of unrelated columns at about N per band.
+ */
+namespace math
+{
+    namespace statistics
+    {
+
+        template <typename T>
+        struct correlated_pair {
+            int first;
+            int second;
+            T r;
+        };
+
+        struct pair_search_options {
+            std::size_t bands = 32;             // more bands: higher recall, more candidates
+            std::size_t band_bits = 0;          // more bits: fewer false candidates, lower recall; 0: log2(columns), at least 8
+            std::uint64_t seed = 0x5eed;        // of the random projections
+            unsigned threads = 0;               // 0 means hardware concurrency
+            std::size_t column_block = 2048;    // columns projected at once
+        };
+
+        // band_bits used for cols columns: the one of the options
+        // or the smallest giving at most about cols candidates of
+        // unrelated columns per band (they collide with probability
+        // 2^-band_bits, equal or complemented)
+        inline std::size_t pair_search_band_bits(const pair_search_options& options, std::size_t cols) {
+            if (options.band_bits) {
+                return options.band_bits;
+            }
+            if (cols == 0) {
+                throw std::invalid_argument("The automatic band_bits need the number of columns");
+            }
+            std::size_t bits{8};
+            while (bits < 32 && (std::size_t(1) << bits) < cols) {
+                ++bits;
+            }
+            return bits;
+        }
+
+        // probability that a pair with correlation r (or -r) among
+        // cols columns becomes a candidate
+        inline double pair_search_recall(double r, const pair_search_options& options, std::size_t cols = 0) {
+            const auto p = 1 - std::acos(std::min(1.0, std::abs(r))) / std::acos(-1.0);
+            return 1 - std::pow(1 - std::pow(p, double(pair_search_band_bits(options, cols))), double(options.bands));
+        }
+
+        // smallest number of bands giving at least recall for the
+        // pairs with |correlation| >= r with the given band_bits
+        inline std::size_t pair_search_bands(double r, double recall, std::size_t band_bits) {
+            const auto p = 1 - std::acos(std::min(1.0, std::abs(r))) / std::acos(-1.0);
+            const auto hit = std::pow(p, double(band_bits));
+            if (recall >= 1 || hit <= 0) {
+                throw std::invalid_argument("Unreachable recall");
+            }
+            if (hit >= 1) {
+                return 1;
+            }
+            return std::max<std::size_t>(1, std::ceil(std::log(1 - recall) / std::log(1 - hit)));
+        }
+
+        namespace detail
+        {
+
+            // SimHash sketches of the columns of a matrix
+            template <typename T>
+            class pair_sketches
+            {
+            private:
+                std::size_t cols, bits, words;
+                std::vector<std::uint64_t> sketch;  // words per column
+                std::vector<char> constant;         // columns without variance
+
+                // rows of gaussian directions generated at once
+                static constexpr std::size_t direction_rows = 256;
+
+                // The gaussian directions, rows x bits row-major, are
+                // never stored as a whole: the n rows of the block
+                // index come from a generator seeded with the block,
+                // so every block of columns regenerates the same
+                // directions with O(direction_rows*bits) memory.
+                void generate_directions(std::uint64_t seed, std::size_t index, std::size_t n, T* out) const {
+                    std::seed_seq sequence{std::uint32_t(seed), std::uint32_t(seed >> 32), std::uint32_t(index), std::uint32_t(std::uint64_t(index) >> 32)};
+                    std::mt19937_64 generator(sequence);
+                    std::normal_distribution<T> distribution;
+                    for (std::size_t k{}; k != n*bits; ++k) {
+                        out[k] = distribution(generator);
+                    }
+                }
+
+            public:
+                pair_sketches(
+                    const T* matrix, std::size_t rows, std::size_t cols,
+                    std::size_t row_offset, std::size_t col_offset,
+                    const pair_search_options& options, parallel::thread_pool& pool
+                ) : cols{cols}, bits{options.bands*pair_search_band_bits(options, cols)}, words{(bits + 63) / 64},
+                    sketch(cols*words), constant(cols)
+                {
+                    const auto block = std::max<std::size_t>(1, options.column_block);
+                    const auto blocks = (cols + block - 1) / block;
+                    pool.parallel_for(blocks, [&](std::size_t b){
+                        const auto c0 = b*block;
+                        const auto nc = std::min(block, cols - c0);
+                        // X'G for the columns of the block, with the sums
+                        // of the columns and of the directions (after the
+                        // nc columns) collected by the kernel
+                        std::vector<T> projections(nc*bits), totals(nc + bits), squared_totals(nc + bits);
+                        std::vector<T> directions(direction_rows*bits);
+                        for (std::size_t r0{}; r0 < rows; r0 += direction_rows) {
+                            const auto n = std::min(direction_rows, rows - r0);
+                            generate_directions(options.seed, r0 / direction_rows, n, directions.data());
+                            kernels::gemm(
+                                matrix + r0*row_offset + c0*col_offset, nc, row_offset, col_offset,
+                                directions.data(), bits, bits, 1,
+                                n, projections.data(), totals.data(), squared_totals.data()
+                            );
+                        }
+                        const auto direction_sums = totals.data() + nc;
+                        for (std::size_t c{}; c != nc; ++c) {
+                            const auto mean = totals[c] / rows;
+                            const auto deviation = squared_totals[c] - totals[c]*mean;
+                            auto out = sketch.data() + (c0 + c)*words;
+                            if (!(deviation > std::abs(squared_totals[c]) * std::numeric_limits<T>::epsilon() * rows)) {
+                                constant[c0 + c] = 1;
+                                continue;
+                            }
+                            // the projection of the z-normalized column has
+                            // the sign of (x - mean)'g = x'g - mean*sum(g)
+                            for (std::size_t k{}; k != bits; ++k) {
+                                if (projections[c*bits + k] - mean*direction_sums[k] > 0) {
+                                    out[k / 64] |= std::uint64_t(1) << (k % 64);
+                                }
+                            }
+                        }
+                    });
+                }
+
+                bool is_constant(std::size_t c) const { return constant[c]; }
+
+                // bits [first, first+count) of the sketch of c, count <= 32
+                std::uint64_t band(std::size_t c, std::size_t first, std::size_t count) const {
+                    const auto s = sketch.data() + c*words;
+                    const auto w = first / 64, shift = first % 64;
+                    auto ans = s[w] >> shift;
+                    if (shift + count > 64) {
+                        ans |= s[w+1] << (64 - shift);
+                    }
+                    return ans & ((std::uint64_t(1) << count) - 1);
+                }
+
+                // first band where the sketches of i and j are equal
+                // or complemented, bands if none
+                std::size_t first_collision(std::size_t i, std::size_t j, std::size_t band_bits) const {
+                    const auto mask = (std::uint64_t(1) << band_bits) - 1;
+                    const auto bands = bits / band_bits;
+                    for (std::size_t b{}; b != bands; ++b) {
+                        const auto difference = band(i, b*band_bits, band_bits) ^ band(j, b*band_bits, band_bits);
+                        if (difference == 0 || difference == mask) {
+                            return b;
+                        }
+                    }
+                    return bands;
+                }
+            };
+
+            // pairs (i,j), i < j, encoded as i*2^32 + j
+            inline std::uint64_t encode_pair(std::size_t i, std::size_t j) {
+                return i < j ? (std::uint64_t(i) << 32) | j : (std::uint64_t(j) << 32) | i;
+            }
+
+            // f(i, j) for the candidate pairs of a band, enumerated
+            // one at a time: a bucket is never materialized.
+            // keyed is scratch of the caller
+            template <typename T, typename F>
+            inline void band_candidates(const pair_sketches<T>& sketches, std::size_t cols, std::size_t first, std::size_t bits, std::vector<std::uint64_t>& keyed, F&& f) {
+                const auto mask = (std::uint64_t(1) << bits) - 1;
+                // (band, column) sorted by band
+                keyed.clear();
+                for (std::size_t c{}; c != cols; ++c) {
+                    if (!sketches.is_constant(c)) {
+                        keyed.push_back((sketches.band(c, first, bits) << 32) | c);
+                    }
+                }
+                std::sort(keyed.begin(), keyed.end());
+                const auto key = [](std::uint64_t x){ return x >> 32; };
+                for (std::size_t begin{}; begin != keyed.size();) {
+                    auto end = begin + 1;
+                    while (end != keyed.size() && key(keyed[end]) == key(keyed[begin])) {
+                        ++end;
+                    }
+                    // same band: candidates for a positive correlation
+                    for (auto a = begin; a != end; ++a) {
+                        for (auto b = a + 1; b != end; ++b) {
+                            f(keyed[a] & 0xffffffff, keyed[b] & 0xffffffff);
+                        }
+                    }
+                    // complemented band: candidates for a negative
+                    // correlation, each couple of buckets visited once
+                    const auto complement = ~key(keyed[begin]) & mask;
+                    if (complement > key(keyed[begin])) {
+                        auto it = std::lower_bound(keyed.begin() + end, keyed.end(), complement << 32);
+                        for (; it != keyed.end() && key(*it) == complement; ++it) {
+                            for (auto a = begin; a != end; ++a) {
+                                f(keyed[a] & 0xffffffff, *it & 0xffffffff);
+                            }
+                        }
+                    }
+                    begin = end;
+                }
+            }
+
+            // pairs with |r| >= threshold
+            template <typename T>
+            class threshold_collector
+            {
+            private:
+                T threshold;
+            public:
+                std::vector<correlated_pair<T>> pairs;
+
+                explicit threshold_collector(T threshold) : threshold{threshold} {}
+
+                void add(const correlated_pair<T>& p) {
+                    if (std::abs(p.r) >= threshold) {
+                        pairs.push_back(p);
+                    }
+                }
+            };
+
+            // the (at most) k pairs with the largest |r|, heap
+            // with the weakest pair in front
+            template <typename T>
+            class top_collector
+            {
+            private:
+                std::size_t k;
+            public:
+                std::vector<correlated_pair<T>> pairs;
+
+                explicit top_collector(std::size_t k) : k{k} {}
+
+                static bool stronger(const correlated_pair<T>& a, const correlated_pair<T>& b) {
+                    return std::abs(a.r) > std::abs(b.r);
+                }
+
+                void add(const correlated_pair<T>& p) {
+                    if (pairs.size() < k) {
+                        pairs.push_back(p);
+                        std::push_heap(pairs.begin(), pairs.end(), stronger);
+                    } else if (k && stronger(p, pairs.front())) {
+                        std::pop_heap(pairs.begin(), pairs.end(), stronger);
+                        pairs.back() = p;
+                        std::push_heap(pairs.begin(), pairs.end(), stronger);
+                    }
+                }
+            };
+
+            // Every candidate verified exactly and passed once to
+            // one of the copies of collector, which are returned.
+            // The candidates of a band are enumerated in a buffer of
+            // bounded size, verified in parallel when it is full.
+            template <typename T, typename C>
+            inline std::vector<C> search_pairs(
+                const T* matrix, std::size_t rows, std::size_t cols,
+                std::size_t row_offset, std::size_t col_offset,
+                const C& collector, const pair_search_options& options
+            ) {
+                if (options.band_bits > 32 || options.bands == 0) {
+                    throw std::invalid_argument("band_bits must be at most 32 and bands at least 1");
+                }
+                if (cols > (std::size_t(1) << 31)) {
+                    throw std::invalid_argument("Too many columns");
+                }
+                const auto band_bits = pair_search_band_bits(options, std::max<std::size_t>(cols, 1));
+                parallel::thread_pool pool(options.threads ? options.threads : parallel::default_threads());
+                const pair_sketches<T> sketches(matrix, rows, cols, row_offset, col_offset, options, pool);
+                // the chunk s of the buffer goes to the collector s
+                constexpr std::size_t chunk = 1024;
+                std::vector<C> collectors(4*pool.size(), collector);
+                std::vector<std::uint64_t> buffer, keyed;
+                buffer.reserve(chunk*collectors.size());
+                std::size_t band{};
+                const auto verify = [&](){
+                    const auto chunks = (buffer.size() + chunk - 1) / chunk;
+                    pool.parallel_for(chunks, [&](std::size_t s){
+                        const auto end = std::min(buffer.size(), (s+1)*chunk);
+                        for (auto k = s*chunk; k != end; ++k) {
+                            const std::size_t first = buffer[k] >> 32;
+                            const std::size_t second = buffer[k] & 0xffffffff;
+                            // found again in a later band
+                            if (sketches.first_collision(first, second, band_bits) != band) {
+                                continue;
+                            }
+                            const auto r = pearson_correlation_coefficient_scattered(
+                                matrix + first*col_offset, matrix + second*col_offset, rows, row_offset
+                            ).compute();
+                            collectors[s].add({int(first), int(second), r});
+                        }
+                    });
+                    buffer.clear();
+                };
+                for (; band != options.bands; ++band) {
+                    band_candidates(sketches, cols, band*band_bits, band_bits, keyed, [&](std::size_t i, std::size_t j){
+                        buffer.push_back(encode_pair(i, j));
+                        if (buffer.size() == buffer.capacity()) {
+                            verify();
+                        }
+                    });
+                    verify();
+                }
+                return collectors;
+            }
+
+            // the pairs of the collectors in couple order
+            template <typename C>
+            inline auto merge_pairs(std::vector<C>& collectors) {
+                auto ans = std::move(collectors.front().pairs);
+                for (std::size_t c{1}; c != collectors.size(); ++c) {
+                    ans.insert(ans.end(), collectors[c].pairs.begin(), collectors[c].pairs.end());
+                }
+                std::sort(ans.begin(), ans.end(), [](const auto& a, const auto& b){
+                    return std::make_pair(a.first, a.second) < std::make_pair(b.first, b.second);
+                });
+                return ans;
+            }
+
+        } // namespace detail
+
+        // Pairs of columns with |r| >= threshold, in couple order.
+        // Pairs are found with probability pair_search_recall(r, options, cols),
+        // every returned coefficient is exact.
+        template <typename T>
+        inline std::vector<correlated_pair<T>> find_correlated_pairs(
+            const T* matrix, std::size_t rows, std::size_t cols,
+            std::size_t row_offset, std::size_t col_offset,
+            T threshold, const pair_search_options& options = {}
+        ) {
+            auto collectors = detail::search_pairs(matrix, rows, cols, row_offset, col_offset, detail::threshold_collector<T>(threshold), options);
+            return detail::merge_pairs(collectors);
+        }
+
+        // The (at most) k pairs with the largest |r| among the
+        // candidates, in couple order. Memory is O(k) per thread.
+        template <typename T>
+        inline std::vector<correlated_pair<T>> top_correlated_pairs(
+            const T* matrix, std::size_t rows, std::size_t cols,
+            std::size_t row_offset, std::size_t col_offset,
+            std::size_t k, const pair_search_options& options = {}
+        ) {
+            auto collectors = detail::search_pairs(matrix, rows, cols, row_offset, col_offset, detail::top_collector<T>(k), options);
+            // the k strongest of the strongest of every collector
+            detail::top_collector<T> top(k);
+            for (const auto& c : collectors) {
+                for (const auto& p : c.pairs) {
+                    top.add(p);
+                }
+            }
+            std::vector<detail::top_collector<T>> merged{std::move(top)};
+            return detail::merge_pairs(merged);
+        }
+
+    } // namespace statistics
+} // namespace math
+
+#endif
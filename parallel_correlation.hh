@@ -0,0 +1,234 @@
+
+#ifndef PARALLEL_CORRELATION
+#define PARALLEL_CORRELATION
+
+#include "correlation.hh"
+#include "thread_pool.hh"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace math
+{
+    namespace statistics
+    {
+
+        // A chunk of rows of a matrix, described as expected by
+        // multicolumn_pcc_accumulator::accumulate(matrix, ...)
+        template <typename T>
+        struct matrix_chunk {
+            const T* matrix{};
+            std::size_t rows{};
+            std::size_t row_offset{};
+            std::size_t col_offset{};
+        };
+
+        struct parallel_options {
+            // how the work is divided among the threads
+            enum class strategy {
+                automatic,  // choose according to the size of the problem
+                rows,       // one accumulator per chunk of rows, merged at the end
+                pairs,      // split the triangle of pairs of columns, no merge
+            };
+
+            unsigned threads = 0;               // 0 means hardware concurrency
+            std::size_t chunk_rows = 0;         // 0 means automatic
+            strategy split = strategy::automatic;
+        };
+
+        namespace detail
+        {
+
+            // Merge the accumulators of the chunks [0,chunks) in a
+            // fixed binary tree: node (level, k) is the sum of the
+            // chunks [k*2^level, (k+1)*2^level). Each chunk is merged
+            // as soon as its sibling is available so few accumulators
+            // are alive at once, and the result does not depend on the
+            // order the chunks are completed in.
+            template <typename T>
+            class tree_reduction
+            {
+            private:
+                using accumulator = multicolumn_pcc_accumulator<T>;
+
+                std::size_t chunks;
+                std::mutex m;
+                // completed nodes waiting for their sibling
+                std::map<std::pair<int,std::size_t>, std::unique_ptr<accumulator>> pending;
+                std::unique_ptr<accumulator> root;
+
+            public:
+                explicit tree_reduction(std::size_t chunks) : chunks{chunks} {}
+
+                void complete(std::size_t chunk, std::unique_ptr<accumulator> acc) {
+                    int level{};
+                    auto k = chunk;
+                    while (true) {
+                        // chunks covered by the whole tree at this level
+                        if ((std::size_t(1) << level) >= chunks) {
+                            std::lock_guard<std::mutex> lock(m);
+                            root = std::move(acc);
+                            return;
+                        }
+                        const auto sibling = k ^ 1;
+                        // sibling out of the range: nothing to add
+                        if ((sibling << level) >= chunks) {
+                            ++level;
+                            k >>= 1;
+                            continue;
+                        }
+                        std::unique_ptr<accumulator> other;
+                        {
+                            std::lock_guard<std::mutex> lock(m);
+                            auto it = pending.find({level, sibling});
+                            if (it == pending.end()) {
+                                pending.emplace(std::make_pair(level, k), std::move(acc));
+                                return;
+                            }
+                            other = std::move(it->second);
+                            pending.erase(it);
+                        }
+                        // always left += right
+                        if (k & 1) {
+                            *other += *acc;
+                            acc = std::move(other);
+                        } else {
+                            *acc += *other;
+                        }
+                        ++level;
+                        k >>= 1;
+                    }
+                }
+
+                std::unique_ptr<accumulator> result() {
+                    return std::move(root);
+                }
+            };
+
+            // split the groups [0,G) in at most parts ranges with about
+            // the same number of pairs of groups (group g starts G-g)
+            inline std::vector<std::pair<std::size_t,std::size_t>> split_triangle(std::size_t G, std::size_t parts) {
+                std::vector<std::pair<std::size_t,std::size_t>> ans;
+                const auto total = G*(G+1)/2;
+                std::size_t begin{}, done{};
+                for (std::size_t p{1}; p <= parts && begin != G; ++p) {
+                    const auto target = total*p/parts;
+                    auto end = begin;
+                    while (end != G && (done < target || end == begin)) {
+                        done += G - end;
+                        ++end;
+                    }
+                    ans.emplace_back(begin, end);
+                    begin = end;
+                }
+                if (begin != G) {
+                    ans.back().second = G;
+                }
+                return ans;
+            }
+
+        } // namespace detail
+
+        // Accumulate chunks [0,chunks) into acc using a pool of
+        // threads, provider(i) must return the matrix_chunk with
+        // index i and can be called concurrently.
+        // Every chunk is processed by its own accumulator and the
+        // results are merged in a binary tree over the chunk indices,
+        // so for a given chunking the result is the same whatever the
+        // number of threads is.
+        template <typename T, typename Provider>
+        inline auto& parallel_accumulate(
+            multicolumn_pcc_accumulator<T>& acc,
+            std::size_t chunks,
+            Provider provider,
+            parallel::thread_pool& pool
+        ) {
+            if (chunks == 0) {
+                return acc;
+            }
+            const auto N = acc.columns();
+            detail::tree_reduction<T> reduction(chunks);
+            pool.parallel_for(chunks, [&](std::size_t i){
+                const matrix_chunk<T> chunk = provider(i);
+                auto partial = std::make_unique<multicolumn_pcc_accumulator<T>>(N);
+                partial->accumulate(chunk.matrix, chunk.rows, N, chunk.row_offset, chunk.col_offset);
+                reduction.complete(i, std::move(partial));
+            });
+            return acc += *reduction.result();
+        }
+
+        template <typename T, typename Provider>
+        inline auto& parallel_accumulate(
+            multicolumn_pcc_accumulator<T>& acc,
+            std::size_t chunks,
+            Provider provider,
+            unsigned threads = 0
+        ) {
+            parallel::thread_pool pool(threads ? threads : parallel::default_threads());
+            return parallel_accumulate(acc, chunks, provider, pool);
+        }
+
+        // Parallel version of acc.accumulate(matrix, rows, cols, row_offset, col_offset).
+        // Splitting by rows requires one accumulator per chunk (at
+        // most about one per thread alive at once), when the
+        // triangle of pairs is large it is better to split it among
+        // the threads, which also gives exactly the serial result.
+        template <typename T>
+        inline auto& parallel_accumulate(
+            multicolumn_pcc_accumulator<T>& acc,
+            const T* matrix,
+            std::size_t rows,
+            std::size_t cols,
+            std::size_t row_offset,
+            std::size_t col_offset,
+            const parallel_options& options = {}
+        ) {
+            if (cols != (decltype(cols))acc.columns()) {
+                using namespace std::literals;
+                throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(acc.columns()) + " found "s + std::to_string(cols));
+            }
+            const auto threads = options.threads ? options.threads : parallel::default_threads();
+            constexpr auto block = kernels::block_rows<T>();
+            const auto G = kernels::groups(cols);
+            auto split = options.split;
+            if (split == parallel_options::strategy::automatic) {
+                // 64MB of accumulators or too few rows to share
+                const auto triangle_bytes = cols*(cols-1)/2*sizeof(T);
+                split = (triangle_bytes*threads > (std::size_t(64) << 20) || rows < 2*threads*block) && G >= 2*threads
+                    ? parallel_options::strategy::pairs
+                    : parallel_options::strategy::rows;
+            }
+            parallel::thread_pool pool(threads);
+            if (split == parallel_options::strategy::pairs) {
+                const auto ranges = detail::split_triangle(G, 4*threads);
+                pool.parallel_for(ranges.size(), [&](std::size_t i){
+                    acc.accumulate_groups(matrix, rows, cols, row_offset, col_offset, ranges[i].first, ranges[i].second);
+                });
+                acc.commit_rows(rows);
+                return acc;
+            }
+            auto chunk_rows = options.chunk_rows;
+            if (chunk_rows == 0) {
+                // a few chunks per thread to balance the load,
+                // multiple of the rows packed at once by the kernel
+                chunk_rows = (rows + 4*threads - 1) / (4*threads);
+                chunk_rows = std::max<std::size_t>(block, (chunk_rows + block - 1) / block * block);
+            }
+            const auto chunks = (rows + chunk_rows - 1) / chunk_rows;
+            return parallel_accumulate(acc, chunks, [&](std::size_t i){
+                const auto first = i*chunk_rows;
+                return matrix_chunk<T>{matrix + first*row_offset, std::min(chunk_rows, rows - first), row_offset, col_offset};
+            }, pool);
+        }
+
+    } // namespace statistics
+} // namespace math
+
+#endif
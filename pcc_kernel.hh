@@ -0,0 +1,455 @@
+
+#ifndef PCC_KERNEL
+#define PCC_KERNEL
+
+#include "integer_kernel.hh"
+#include "simd.hh"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Hand vectorized kernels computing the five sums needed
+ * by pcc_partial over two (possibly strided) series:
+ *  out[0] = sum(v1)        out[1] = sum(v2)
+ *  out[2] = sum(v1^2)      out[3] = sum(v2^2)
+ *  out[4] = sum(v1*v2)
+ * Every kernel keeps two independent sets of vector
+ * accumulators to break the dependency chains, the best
+ * one is selected at runtime through simd::active_isa().
+ */
+namespace math
+{
+    namespace statistics
+    {
+        namespace kernels
+        {
+
+            // types with a vectorized implementation, int16 is in integer_kernel.hh
+            template <typename T, typename R>
+            constexpr bool has_pcc_kernel = std::is_same_v<T, R> && (std::is_same_v<T, double> || std::is_same_v<T, float> || std::is_same_v<T, std::int16_t>);
+
+            // four independent chains, used on the tail and when
+            // no vector instruction set is available
+            template <typename T>
+            inline void pcc_sums_scalar(const T* v1, const T* v2, std::size_t size, std::size_t scatter, std::size_t i, T* out) {
+                T s1[4]{}, s2[4]{}, q1[4]{}, q2[4]{}, p[4]{};
+                for (; i + 4 <= size; i += 4) {
+                    for (std::size_t u{}; u != 4; ++u) {
+                        const auto a = v1[(i+u)*scatter];
+                        const auto b = v2[(i+u)*scatter];
+                        s1[u] += a;
+                        s2[u] += b;
+                        q1[u] += a*a;
+                        q2[u] += b*b;
+                        p[u] += a*b;
+                    }
+                }
+                // advance pointers, an index multiplied by a known
+                // scatter makes GCC warn about overflows
+                auto p1 = v1 + i*scatter;
+                auto p2 = v2 + i*scatter;
+                for (; i < size; ++i, p1 += scatter, p2 += scatter) {
+                    const auto a = *p1;
+                    const auto b = *p2;
+                    s1[0] += a;
+                    s2[0] += b;
+                    q1[0] += a*a;
+                    q2[0] += b*b;
+                    p[0] += a*b;
+                }
+                out[0] += (s1[0] + s1[1]) + (s1[2] + s1[3]);
+                out[1] += (s2[0] + s2[1]) + (s2[2] + s2[3]);
+                out[2] += (q1[0] + q1[1]) + (q1[2] + q1[3]);
+                out[3] += (q2[0] + q2[1]) + (q2[2] + q2[3]);
+                out[4] += (p[0] + p[1]) + (p[2] + p[3]);
+            }
+
+            // add the lanes of the accumulators to out
+            template <typename T, std::size_t Lanes>
+            inline void pcc_reduce(const T (&lanes)[5][Lanes], T* out) {
+                for (std::size_t k{}; k != 5; ++k) {
+                    T tot{};
+                    for (auto x : lanes[k]) {
+                        tot += x;
+                    }
+                    out[k] = tot;
+                }
+            }
+
+#ifdef MATH_SIMD_X86
+            // add a pair of vectors to the accumulators of the set u
+            MATH_SIMD_TARGET("sse2")
+            inline void pcc_step(__m128d (&acc)[5][2], std::size_t u, __m128d a, __m128d b) {
+                acc[0][u] = _mm_add_pd(acc[0][u], a);
+                acc[1][u] = _mm_add_pd(acc[1][u], b);
+                acc[2][u] = _mm_add_pd(acc[2][u], _mm_mul_pd(a, a));
+                acc[3][u] = _mm_add_pd(acc[3][u], _mm_mul_pd(b, b));
+                acc[4][u] = _mm_add_pd(acc[4][u], _mm_mul_pd(a, b));
+            }
+
+            MATH_SIMD_TARGET("sse2")
+            inline void pcc_step(__m128 (&acc)[5][2], std::size_t u, __m128 a, __m128 b) {
+                acc[0][u] = _mm_add_ps(acc[0][u], a);
+                acc[1][u] = _mm_add_ps(acc[1][u], b);
+                acc[2][u] = _mm_add_ps(acc[2][u], _mm_mul_ps(a, a));
+                acc[3][u] = _mm_add_ps(acc[3][u], _mm_mul_ps(b, b));
+                acc[4][u] = _mm_add_ps(acc[4][u], _mm_mul_ps(a, b));
+            }
+
+            MATH_SIMD_TARGET("avx2,fma")
+            inline void pcc_step(__m256d (&acc)[5][2], std::size_t u, __m256d a, __m256d b) {
+                acc[0][u] = _mm256_add_pd(acc[0][u], a);
+                acc[1][u] = _mm256_add_pd(acc[1][u], b);
+                acc[2][u] = _mm256_fmadd_pd(a, a, acc[2][u]);
+                acc[3][u] = _mm256_fmadd_pd(b, b, acc[3][u]);
+                acc[4][u] = _mm256_fmadd_pd(a, b, acc[4][u]);
+            }
+
+            MATH_SIMD_TARGET("avx2,fma")
+            inline void pcc_step(__m256 (&acc)[5][2], std::size_t u, __m256 a, __m256 b) {
+                acc[0][u] = _mm256_add_ps(acc[0][u], a);
+                acc[1][u] = _mm256_add_ps(acc[1][u], b);
+                acc[2][u] = _mm256_fmadd_ps(a, a, acc[2][u]);
+                acc[3][u] = _mm256_fmadd_ps(b, b, acc[3][u]);
+                acc[4][u] = _mm256_fmadd_ps(a, b, acc[4][u]);
+            }
+
+            MATH_SIMD_TARGET("avx512f")
+            inline void pcc_step(__m512d (&acc)[5][2], std::size_t u, __m512d a, __m512d b) {
+                acc[0][u] = _mm512_add_pd(acc[0][u], a);
+                acc[1][u] = _mm512_add_pd(acc[1][u], b);
+                acc[2][u] = _mm512_fmadd_pd(a, a, acc[2][u]);
+                acc[3][u] = _mm512_fmadd_pd(b, b, acc[3][u]);
+                acc[4][u] = _mm512_fmadd_pd(a, b, acc[4][u]);
+            }
+
+            MATH_SIMD_TARGET("avx512f")
+            inline void pcc_step(__m512 (&acc)[5][2], std::size_t u, __m512 a, __m512 b) {
+                acc[0][u] = _mm512_add_ps(acc[0][u], a);
+                acc[1][u] = _mm512_add_ps(acc[1][u], b);
+                acc[2][u] = _mm512_fmadd_ps(a, a, acc[2][u]);
+                acc[3][u] = _mm512_fmadd_ps(b, b, acc[3][u]);
+                acc[4][u] = _mm512_fmadd_ps(a, b, acc[4][u]);
+            }
+
+            MATH_SIMD_TARGET("sse2")
+            inline void pcc_sums_sse2(const double* v1, const double* v2, std::size_t size, std::size_t scatter, double* out) {
+                __m128d acc[5][2];
+                for (auto& a : acc) {
+                    a[0] = a[1] = _mm_setzero_pd();
+                }
+                std::size_t i{};
+                if (scatter == 1) {
+                    for (; i + 4 <= size; i += 4) {
+                        pcc_step(acc, 0, _mm_loadu_pd(v1 + i), _mm_loadu_pd(v2 + i));
+                        pcc_step(acc, 1, _mm_loadu_pd(v1 + i + 2), _mm_loadu_pd(v2 + i + 2));
+                    }
+                } else {
+                    // no gather, but still independent lanes
+                    for (; i + 4 <= size; i += 4) {
+                        for (std::size_t u{}; u != 2; ++u) {
+                            const auto j = i + 2*u;
+                            pcc_step(acc, u,
+                                _mm_set_pd(v1[(j+1)*scatter], v1[j*scatter]),
+                                _mm_set_pd(v2[(j+1)*scatter], v2[j*scatter]));
+                        }
+                    }
+                }
+                double lanes[5][2];
+                for (std::size_t k{}; k != 5; ++k) {
+                    _mm_storeu_pd(lanes[k], _mm_add_pd(acc[k][0], acc[k][1]));
+                }
+                pcc_reduce(lanes, out);
+                pcc_sums_scalar(v1, v2, size, scatter, i, out);
+            }
+
+            MATH_SIMD_TARGET("sse2")
+            inline void pcc_sums_sse2(const float* v1, const float* v2, std::size_t size, std::size_t scatter, float* out) {
+                __m128 acc[5][2];
+                for (auto& a : acc) {
+                    a[0] = a[1] = _mm_setzero_ps();
+                }
+                std::size_t i{};
+                if (scatter == 1) {
+                    for (; i + 8 <= size; i += 8) {
+                        pcc_step(acc, 0, _mm_loadu_ps(v1 + i), _mm_loadu_ps(v2 + i));
+                        pcc_step(acc, 1, _mm_loadu_ps(v1 + i + 4), _mm_loadu_ps(v2 + i + 4));
+                    }
+                } else {
+                    for (; i + 8 <= size; i += 8) {
+                        for (std::size_t u{}; u != 2; ++u) {
+                            const auto j = i + 4*u;
+                            pcc_step(acc, u,
+                                _mm_set_ps(v1[(j+3)*scatter], v1[(j+2)*scatter], v1[(j+1)*scatter], v1[j*scatter]),
+                                _mm_set_ps(v2[(j+3)*scatter], v2[(j+2)*scatter], v2[(j+1)*scatter], v2[j*scatter]));
+                        }
+                    }
+                }
+                float lanes[5][4];
+                for (std::size_t k{}; k != 5; ++k) {
+                    _mm_storeu_ps(lanes[k], _mm_add_ps(acc[k][0], acc[k][1]));
+                }
+                pcc_reduce(lanes, out);
+                pcc_sums_scalar(v1, v2, size, scatter, i, out);
+            }
+
+            MATH_SIMD_TARGET("avx2,fma")
+            inline void pcc_sums_avx2(const double* v1, const double* v2, std::size_t size, std::size_t scatter, double* out) {
+                __m256d acc[5][2];
+                for (auto& a : acc) {
+                    a[0] = a[1] = _mm256_setzero_pd();
+                }
+                std::size_t i{};
+                if (scatter == 1) {
+                    for (; i + 8 <= size; i += 8) {
+                        pcc_step(acc, 0, _mm256_loadu_pd(v1 + i), _mm256_loadu_pd(v2 + i));
+                        pcc_step(acc, 1, _mm256_loadu_pd(v1 + i + 4), _mm256_loadu_pd(v2 + i + 4));
+                    }
+                } else {
+                    // gather indices, in elements
+                    const auto s = (long long)scatter;
+                    const auto idx = _mm256_set_epi64x(3*s, 2*s, s, 0);
+                    for (; i + 8 <= size; i += 8) {
+                        pcc_step(acc, 0,
+                            _mm256_i64gather_pd(v1 + i*scatter, idx, 8),
+                            _mm256_i64gather_pd(v2 + i*scatter, idx, 8));
+                        pcc_step(acc, 1,
+                            _mm256_i64gather_pd(v1 + (i+4)*scatter, idx, 8),
+                            _mm256_i64gather_pd(v2 + (i+4)*scatter, idx, 8));
+                    }
+                }
+                double lanes[5][4];
+                for (std::size_t k{}; k != 5; ++k) {
+                    _mm256_storeu_pd(lanes[k], _mm256_add_pd(acc[k][0], acc[k][1]));
+                }
+                pcc_reduce(lanes, out);
+                pcc_sums_scalar(v1, v2, size, scatter, i, out);
+            }
+
+            // 8 strided floats, 64 bit indices to support any stride
+            MATH_SIMD_TARGET("avx2,fma")
+            inline __m256 gather8(const float* v, __m256i lo, __m256i hi) {
+                return _mm256_set_m128(_mm256_i64gather_ps(v, hi, 4), _mm256_i64gather_ps(v, lo, 4));
+            }
+
+            MATH_SIMD_TARGET("avx2,fma")
+            inline void pcc_sums_avx2(const float* v1, const float* v2, std::size_t size, std::size_t scatter, float* out) {
+                __m256 acc[5][2];
+                for (auto& a : acc) {
+                    a[0] = a[1] = _mm256_setzero_ps();
+                }
+                std::size_t i{};
+                if (scatter == 1) {
+                    for (; i + 16 <= size; i += 16) {
+                        pcc_step(acc, 0, _mm256_loadu_ps(v1 + i), _mm256_loadu_ps(v2 + i));
+                        pcc_step(acc, 1, _mm256_loadu_ps(v1 + i + 8), _mm256_loadu_ps(v2 + i + 8));
+                    }
+                } else {
+                    const auto s = (long long)scatter;
+                    const auto lo = _mm256_set_epi64x(3*s, 2*s, s, 0);
+                    const auto hi = _mm256_set_epi64x(7*s, 6*s, 5*s, 4*s);
+                    for (; i + 16 <= size; i += 16) {
+                        pcc_step(acc, 0, gather8(v1 + i*scatter, lo, hi), gather8(v2 + i*scatter, lo, hi));
+                        pcc_step(acc, 1, gather8(v1 + (i+8)*scatter, lo, hi), gather8(v2 + (i+8)*scatter, lo, hi));
+                    }
+                }
+                float lanes[5][8];
+                for (std::size_t k{}; k != 5; ++k) {
+                    _mm256_storeu_ps(lanes[k], _mm256_add_ps(acc[k][0], acc[k][1]));
+                }
+                pcc_reduce(lanes, out);
+                pcc_sums_scalar(v1, v2, size, scatter, i, out);
+            }
+
+            MATH_SIMD_TARGET("avx512f")
+            inline void pcc_sums_avx512(const double* v1, const double* v2, std::size_t size, std::size_t scatter, double* out) {
+                __m512d acc[5][2];
+                for (auto& a : acc) {
+                    a[0] = a[1] = _mm512_setzero_pd();
+                }
+                std::size_t i{};
+                if (scatter == 1) {
+                    for (; i + 16 <= size; i += 16) {
+                        pcc_step(acc, 0, _mm512_loadu_pd(v1 + i), _mm512_loadu_pd(v2 + i));
+                        pcc_step(acc, 1, _mm512_loadu_pd(v1 + i + 8), _mm512_loadu_pd(v2 + i + 8));
+                    }
+                } else {
+                    const auto s = (long long)scatter;
+                    const auto idx = _mm512_set_epi64(7*s, 6*s, 5*s, 4*s, 3*s, 2*s, s, 0);
+                    const auto zero = _mm512_setzero_pd();
+                    for (; i + 16 <= size; i += 16) {
+                        pcc_step(acc, 0,
+                            _mm512_mask_i64gather_pd(zero, 0xFF, idx, v1 + i*scatter, 8),
+                            _mm512_mask_i64gather_pd(zero, 0xFF, idx, v2 + i*scatter, 8));
+                        pcc_step(acc, 1,
+                            _mm512_mask_i64gather_pd(zero, 0xFF, idx, v1 + (i+8)*scatter, 8),
+                            _mm512_mask_i64gather_pd(zero, 0xFF, idx, v2 + (i+8)*scatter, 8));
+                    }
+                }
+                double lanes[5][8];
+                for (std::size_t k{}; k != 5; ++k) {
+                    _mm512_storeu_pd(lanes[k], _mm512_add_pd(acc[k][0], acc[k][1]));
+                }
+                pcc_reduce(lanes, out);
+                pcc_sums_scalar(v1, v2, size, scatter, i, out);
+            }
+
+            // 16 strided floats, without AVX512DQ
+            MATH_SIMD_TARGET("avx512f")
+            inline __m512 gather16(const float* v, __m512i lo, __m512i hi) {
+                const auto zero = _mm256_setzero_ps();
+                const auto l = _mm256_castps_pd(_mm512_mask_i64gather_ps(zero, 0xFF, lo, v, 4));
+                const auto h = _mm256_castps_pd(_mm512_mask_i64gather_ps(zero, 0xFF, hi, v, 4));
+                return _mm512_castpd_ps(_mm512_mask_broadcast_f64x4(_mm512_castpd256_pd512(l), 0xF0, h));
+            }
+
+            MATH_SIMD_TARGET("avx512f")
+            inline void pcc_sums_avx512(const float* v1, const float* v2, std::size_t size, std::size_t scatter, float* out) {
+                __m512 acc[5][2];
+                for (auto& a : acc) {
+                    a[0] = a[1] = _mm512_setzero_ps();
+                }
+                std::size_t i{};
+                if (scatter == 1) {
+                    for (; i + 32 <= size; i += 32) {
+                        pcc_step(acc, 0, _mm512_loadu_ps(v1 + i), _mm512_loadu_ps(v2 + i));
+                        pcc_step(acc, 1, _mm512_loadu_ps(v1 + i + 16), _mm512_loadu_ps(v2 + i + 16));
+                    }
+                } else {
+                    const auto s = (long long)scatter;
+                    const auto lo = _mm512_set_epi64(7*s, 6*s, 5*s, 4*s, 3*s, 2*s, s, 0);
+                    const auto hi = _mm512_set_epi64(15*s, 14*s, 13*s, 12*s, 11*s, 10*s, 9*s, 8*s);
+                    for (; i + 32 <= size; i += 32) {
+                        pcc_step(acc, 0, gather16(v1 + i*scatter, lo, hi), gather16(v2 + i*scatter, lo, hi));
+                        pcc_step(acc, 1, gather16(v1 + (i+16)*scatter, lo, hi), gather16(v2 + (i+16)*scatter, lo, hi));
+                    }
+                }
+                float lanes[5][16];
+                for (std::size_t k{}; k != 5; ++k) {
+                    _mm512_storeu_ps(lanes[k], _mm512_add_ps(acc[k][0], acc[k][1]));
+                }
+                pcc_reduce(lanes, out);
+                pcc_sums_scalar(v1, v2, size, scatter, i, out);
+            }
+#endif
+
+            // out[5] as described above, pick the best kernel
+            // supported by the CPU
+            template <typename T>
+            inline void pcc_sums(const T* v1, const T* v2, std::size_t size, std::size_t scatter, T* out) {
+                for (std::size_t k{}; k != 5; ++k) {
+                    out[k] = T{};
+                }
+#ifdef MATH_SIMD_X86
+                switch (simd::active_isa()) {
+                case simd::isa::avx512:
+                    return pcc_sums_avx512(v1, v2, size, scatter, out);
+                case simd::isa::avx2:
+                    return pcc_sums_avx2(v1, v2, size, scatter, out);
+                case simd::isa::sse2:
+                    return pcc_sums_sse2(v1, v2, size, scatter, out);
+                default:
+                    break;
+                }
+#endif
+                pcc_sums_scalar(v1, v2, size, scatter, 0, out);
+            }
+
+            // Pearson Correlation Coefficients of the column i
+            // against n other columns, given the cross products,
+            // the totals and the sums of squared deviations
+            // (sq - t*t/count) of the other columns:
+            //  out[k] = (cov[k] - ti*t[k]/count) / sqrt(vi*v[k])
+            // or 0 when the denominator is 0, as pcc_partial::compute()
+            template <typename T>
+            inline void pcc_row_scalar(const T* cov, const T* t, const T* v, std::size_t n, T ti, T vi, T count, T* out) {
+                for (std::size_t k{}; k != n; ++k) {
+                    const auto num = cov[k] - (ti*t[k])/count;
+                    const auto den = vi*v[k];
+                    out[k] = den ? num / std::sqrt(den) : 0;
+                }
+            }
+
+#ifdef MATH_SIMD_X86
+            MATH_SIMD_TARGET("avx2,fma")
+            inline void pcc_row_avx2(const double* cov, const double* t, const double* v, std::size_t n, double ti, double vi, double count, double* out) {
+                const auto vti = _mm256_set1_pd(ti), vvi = _mm256_set1_pd(vi), vc = _mm256_set1_pd(count);
+                const auto zero = _mm256_setzero_pd();
+                std::size_t k{};
+                for (; k + 4 <= n; k += 4) {
+                    const auto num = _mm256_sub_pd(_mm256_loadu_pd(cov + k), _mm256_div_pd(_mm256_mul_pd(vti, _mm256_loadu_pd(t + k)), vc));
+                    const auto den = _mm256_mul_pd(vvi, _mm256_loadu_pd(v + k));
+                    const auto r = _mm256_div_pd(num, _mm256_sqrt_pd(den));
+                    _mm256_storeu_pd(out + k, _mm256_blendv_pd(r, zero, _mm256_cmp_pd(den, zero, _CMP_EQ_OQ)));
+                }
+                pcc_row_scalar(cov + k, t + k, v + k, n - k, ti, vi, count, out + k);
+            }
+
+            MATH_SIMD_TARGET("avx2,fma")
+            inline void pcc_row_avx2(const float* cov, const float* t, const float* v, std::size_t n, float ti, float vi, float count, float* out) {
+                const auto vti = _mm256_set1_ps(ti), vvi = _mm256_set1_ps(vi), vc = _mm256_set1_ps(count);
+                const auto zero = _mm256_setzero_ps();
+                std::size_t k{};
+                for (; k + 8 <= n; k += 8) {
+                    const auto num = _mm256_sub_ps(_mm256_loadu_ps(cov + k), _mm256_div_ps(_mm256_mul_ps(vti, _mm256_loadu_ps(t + k)), vc));
+                    const auto den = _mm256_mul_ps(vvi, _mm256_loadu_ps(v + k));
+                    const auto r = _mm256_div_ps(num, _mm256_sqrt_ps(den));
+                    _mm256_storeu_ps(out + k, _mm256_blendv_ps(r, zero, _mm256_cmp_ps(den, zero, _CMP_EQ_OQ)));
+                }
+                pcc_row_scalar(cov + k, t + k, v + k, n - k, ti, vi, count, out + k);
+            }
+
+            MATH_SIMD_TARGET("avx512f")
+            inline void pcc_row_avx512(const double* cov, const double* t, const double* v, std::size_t n, double ti, double vi, double count, double* out) {
+                const auto vti = _mm512_set1_pd(ti), vvi = _mm512_set1_pd(vi), vc = _mm512_set1_pd(count);
+                const auto zero = _mm512_setzero_pd();
+                std::size_t k{};
+                for (; k + 8 <= n; k += 8) {
+                    const auto num = _mm512_sub_pd(_mm512_loadu_pd(cov + k), _mm512_div_pd(_mm512_mul_pd(vti, _mm512_loadu_pd(t + k)), vc));
+                    const auto den = _mm512_mul_pd(vvi, _mm512_loadu_pd(v + k));
+                    const auto r = _mm512_div_pd(num, _mm512_mask_sqrt_pd(zero, 0xFF, den));
+                    _mm512_storeu_pd(out + k, _mm512_mask_blend_pd(_mm512_cmp_pd_mask(den, zero, _CMP_EQ_OQ), r, zero));
+                }
+                pcc_row_scalar(cov + k, t + k, v + k, n - k, ti, vi, count, out + k);
+            }
+
+            MATH_SIMD_TARGET("avx512f")
+            inline void pcc_row_avx512(const float* cov, const float* t, const float* v, std::size_t n, float ti, float vi, float count, float* out) {
+                const auto vti = _mm512_set1_ps(ti), vvi = _mm512_set1_ps(vi), vc = _mm512_set1_ps(count);
+                const auto zero = _mm512_setzero_ps();
+                std::size_t k{};
+                for (; k + 16 <= n; k += 16) {
+                    const auto num = _mm512_sub_ps(_mm512_loadu_ps(cov + k), _mm512_div_ps(_mm512_mul_ps(vti, _mm512_loadu_ps(t + k)), vc));
+                    const auto den = _mm512_mul_ps(vvi, _mm512_loadu_ps(v + k));
+                    const auto r = _mm512_div_ps(num, _mm512_mask_sqrt_ps(zero, 0xFFFF, den));
+                    _mm512_storeu_ps(out + k, _mm512_mask_blend_ps(_mm512_cmp_ps_mask(den, zero, _CMP_EQ_OQ), r, zero));
+                }
+                pcc_row_scalar(cov + k, t + k, v + k, n - k, ti, vi, count, out + k);
+            }
+#endif
+
+            template <typename T>
+            inline void pcc_row(const T* cov, const T* t, const T* v, std::size_t n, T ti, T vi, T count, T* out) {
+#ifdef MATH_SIMD_X86
+                if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>) {
+                    switch (simd::active_isa()) {
+                    case simd::isa::avx512:
+                        return pcc_row_avx512(cov, t, v, n, ti, vi, count, out);
+                    case simd::isa::avx2:
+                        return pcc_row_avx2(cov, t, v, n, ti, vi, count, out);
+                    default:
+                        break;
+                    }
+                }
+#endif
+                pcc_row_scalar(cov, t, v, n, ti, vi, count, out);
+            }
+
+        } // namespace kernels
+    } // namespace statistics
+} // namespace math
+
+#endif
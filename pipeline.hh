@@ -0,0 +1,595 @@
+
+#ifndef PIPELINE
+#define PIPELINE
+
+#include "correlation.hh"
+#include "convertions.hh"
+#include "simd.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * Pipelined ingestion of delimited text into a
+ * multicolumn_pcc_accumulator: a reader stage cuts the byte
+ * stream into chunks of whole lines, parser workers turn the
+ * chunks into row-major matrices and accumulator workers add
+ * them to their own accumulators, merged with operator+= at
+ * the end. Stages are connected by bounded lock-free queues
+ * and the buffers circulate in fixed pools, so a slow stage
+ * stops the previous ones (backpressure) instead of making
+ * the memory grow, and nothing is allocated once the buffers
+ * reach their working size.
+ */
+namespace math
+{
+    namespace parallel
+    {
+
+        /**
+         * Bounded multi-producer multi-consumer queue on a ring
+         * of cells with sequence numbers (D. Vyukov): push and
+         * pop are a CAS on the position plus a release store.
+         * The blocking versions spin, then yield and sleep.
+         * After close() push() fails and pop() drains the queue
+         * and then fails.
+         */
+        template <typename T>
+        class bounded_queue
+        {
+        private:
+            struct cell {
+                std::atomic<std::size_t> sequence;
+                T value;
+            };
+
+            std::unique_ptr<cell[]> cells;
+            std::size_t mask;
+            alignas(64) std::atomic<std::size_t> head{};    // next push
+            alignas(64) std::atomic<std::size_t> tail{};    // next pop
+            alignas(64) std::atomic<bool> closed{};
+
+            static void backoff(unsigned& attempt) {
+                if (++attempt < 64) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            }
+
+        public:
+            // capacity is rounded up to a power of 2
+            explicit bounded_queue(std::size_t capacity) {
+                std::size_t size{2};
+                while (size < capacity) {
+                    size <<= 1;
+                }
+                cells.reset(new cell[size]);
+                mask = size - 1;
+                for (std::size_t i{}; i != size; ++i) {
+                    cells[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            bounded_queue(const bounded_queue&) = delete;
+            bounded_queue& operator=(const bounded_queue&) = delete;
+
+            std::size_t capacity() const { return mask + 1; }
+
+            // v is moved only on success
+            bool try_push(T& v) {
+                auto pos = head.load(std::memory_order_relaxed);
+                for (;;) {
+                    auto& c = cells[pos & mask];
+                    const auto seq = c.sequence.load(std::memory_order_acquire);
+                    const auto diff = std::intptr_t(seq) - std::intptr_t(pos);
+                    if (diff == 0) {
+                        if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            c.value = std::move(v);
+                            c.sequence.store(pos + 1, std::memory_order_release);
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false;   // full
+                    } else {
+                        pos = head.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            bool try_pop(T& v) {
+                auto pos = tail.load(std::memory_order_relaxed);
+                for (;;) {
+                    auto& c = cells[pos & mask];
+                    const auto seq = c.sequence.load(std::memory_order_acquire);
+                    const auto diff = std::intptr_t(seq) - std::intptr_t(pos + 1);
+                    if (diff == 0) {
+                        if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            v = std::move(c.value);
+                            c.sequence.store(pos + mask + 1, std::memory_order_release);
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false;   // empty
+                    } else {
+                        pos = tail.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            // false once the queue is closed, also while waiting
+            // for space (a push racing with close() may succeed)
+            bool push(T v) {
+                for (unsigned attempt{};;) {
+                    if (closed.load(std::memory_order_acquire)) {
+                        return false;
+                    }
+                    if (try_push(v)) {
+                        return true;
+                    }
+                    backoff(attempt);
+                }
+            }
+
+            // false once the queue is closed and empty
+            bool pop(T& v) {
+                for (unsigned attempt{};;) {
+                    if (try_pop(v)) {
+                        return true;
+                    }
+                    if (closed.load(std::memory_order_acquire)) {
+                        // pushes done before close() are visible now
+                        return try_pop(v);
+                    }
+                    backoff(attempt);
+                }
+            }
+
+            void close() {
+                closed.store(true, std::memory_order_release);
+            }
+        };
+
+        /**
+         * Fixed set of buffers handed out by acquire() and given
+         * back by release(): at most size() are in use at once.
+         */
+        template <typename B>
+        class buffer_pool
+        {
+        private:
+            std::vector<std::unique_ptr<B>> buffers;
+            bounded_queue<B*> free;
+
+        public:
+            explicit buffer_pool(std::size_t count) : free(count) {
+                for (std::size_t i{}; i != count; ++i) {
+                    buffers.push_back(std::make_unique<B>());
+                    free.push(buffers.back().get());
+                }
+            }
+
+            std::size_t size() const { return buffers.size(); }
+
+            // waits for a free buffer, nullptr after close()
+            B* acquire() {
+                B* ans{};
+                return free.pop(ans) ? ans : nullptr;
+            }
+
+            // after close() the buffer is not handed out again
+            void release(B* b) { free.push(b); }
+
+            // wake up and fail the threads waiting in acquire()
+            void close() { free.close(); }
+        };
+
+    } // namespace parallel
+
+    namespace io
+    {
+
+        // byte stream of a file read sequentially, usable as
+        // source of ingestion_pipeline::run()
+        class file_source
+        {
+        private:
+            int fd{-1};
+            std::string path;
+
+        public:
+            explicit file_source(const std::string& path) : path{path} {
+                fd = ::open(path.c_str(), O_RDONLY);
+                if (fd == -1) {
+                    throw std::system_error(errno, std::generic_category(), "cannot open '" + path + "'");
+                }
+                ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            }
+
+            file_source(file_source&& o) noexcept : fd{std::exchange(o.fd, -1)}, path{std::move(o.path)} {}
+            file_source(const file_source&) = delete;
+            file_source& operator=(const file_source&) = delete;
+
+            ~file_source() {
+                if (fd != -1) {
+                    ::close(fd);
+                }
+            }
+
+            // fill buffer, less than size bytes only at the end of the file
+            std::size_t operator()(char* buffer, std::size_t size) {
+                std::size_t done{};
+                while (done != size) {
+                    const auto n = ::read(fd, buffer + done, size - done);
+                    if (n == 0) {
+                        break;
+                    }
+                    if (n == -1) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        throw std::system_error(errno, std::generic_category(), "cannot read '" + path + "'");
+                    }
+                    done += n;
+                }
+                return done;
+            }
+        };
+
+    } // namespace io
+
+    namespace statistics
+    {
+
+        struct stage_stats {
+            std::size_t chunks{};
+            std::size_t bytes{};        // of text
+            std::size_t rows{};
+            double busy{};              // seconds of work, summed over the workers
+            double waiting{};           // seconds blocked on the input or on the buffers
+
+            // bytes of text per second of work
+            double throughput() const { return busy > 0 ? bytes / busy : 0; }
+
+            stage_stats& operator+=(const stage_stats& o) {
+                chunks += o.chunks;
+                bytes += o.bytes;
+                rows += o.rows;
+                busy += o.busy;
+                waiting += o.waiting;
+                return *this;
+            }
+        };
+
+        struct pipeline_stats {
+            stage_stats read;
+            stage_stats parse;
+            stage_stats accumulate;
+            double merge{};             // seconds of the final merge
+            double seconds{};           // wall time of run()
+        };
+
+        struct pipeline_options {
+            char delimiter = ',';
+            std::size_t header_lines = 0;       // lines skipped at the beginning
+            std::size_t columns = 0;            // 0: fields of the first row
+            unsigned parsers = 1;
+            unsigned accumulators = 1;
+            std::size_t chunk_bytes = 1 << 20;  // text read at once, grows for longer lines
+            std::size_t buffers = 0;            // of each kind, 0: 2 per worker
+        };
+
+        /**
+         * Correlation of all the pairs of columns of a delimited
+         * text (see convertions::parse_rows for the format)
+         * read from a byte stream. A parse error stops all the
+         * stages and is thrown by run() with its line (from 0,
+         * header included) and column.
+         */
+        template <typename T = double>
+        class ingestion_pipeline
+        {
+        public:
+            using value_type = T;
+            // reads up to size bytes into buffer, 0 at the end of the stream
+            using source_type = std::function<std::size_t(char*, std::size_t)>;
+
+        private:
+            using clock = std::chrono::steady_clock;
+
+            struct text_chunk {
+                std::vector<char> text;
+                std::size_t begin{}, end{};     // whole lines in [begin,end)
+                std::size_t first_line{};
+                std::size_t lines{};            // '\n' in [begin,end)
+            };
+
+            struct value_chunk {
+                std::vector<value_type, simd::aligned_allocator<value_type>> values;
+                std::size_t rows{};
+            };
+
+            pipeline_options options;
+            pipeline_stats statistics;
+
+            static double since(clock::time_point t) {
+                return std::chrono::duration<double>(clock::now() - t).count();
+            }
+
+            // State shared by the stages of a run. Every queue holds
+            // at least all the buffers of its pool, so a push never
+            // waits for space; if it did, fail() closing the queues
+            // would still make it return.
+            struct run_state {
+                std::size_t cols{};
+                parallel::buffer_pool<text_chunk> text_pool;
+                parallel::buffer_pool<value_chunk> value_pool;
+                parallel::bounded_queue<text_chunk*> parse_queue;
+                parallel::bounded_queue<value_chunk*> accumulate_queue;
+                std::atomic<unsigned> parsers_alive;
+                std::atomic<bool> failed{};
+                std::mutex m;
+                std::exception_ptr error;
+                pipeline_stats stats;
+
+                run_state(std::size_t buffers, unsigned parsers)
+                : text_pool(buffers), value_pool(buffers), parse_queue(buffers), accumulate_queue(buffers), parsers_alive{parsers} {}
+
+                // first error wins, every stage stops
+                void fail(std::exception_ptr e) {
+                    {
+                        std::lock_guard<std::mutex> lock(m);
+                        if (!error) {
+                            error = e;
+                        }
+                    }
+                    failed = true;
+                    text_pool.close();
+                    value_pool.close();
+                    parse_queue.close();
+                    accumulate_queue.close();
+                }
+            };
+
+            void parse_stage(run_state& s) {
+                stage_stats local;
+                try {
+                    for (;;) {
+                        auto t0 = clock::now();
+                        text_chunk* chunk{};
+                        if (!s.parse_queue.pop(chunk) || s.failed) {
+                            break;
+                        }
+                        auto values = s.value_pool.acquire();
+                        local.waiting += since(t0);
+                        if (!values) {
+                            break;
+                        }
+                        t0 = clock::now();
+                        const std::string_view text(chunk->text.data() + chunk->begin, chunk->end - chunk->begin);
+                        // a last line without '\n' is a row too
+                        const auto max_rows = chunk->lines + 1;
+                        values->values.resize(max_rows * s.cols);
+                        const auto status = convertions::parse_rows(text, options.delimiter, values->values.data(), s.cols, max_rows, s.cols, 1);
+                        if (!status) {
+                            using namespace std::literals;
+                            throw std::runtime_error("Invalid value at line "s + std::to_string(chunk->first_line + status.line)
+                                + ", column "s + std::to_string(status.column));
+                        }
+                        values->rows = status.rows;
+                        ++local.chunks;
+                        local.bytes += text.size();
+                        local.rows += status.rows;
+                        s.text_pool.release(chunk);
+                        if (!s.accumulate_queue.push(values)) {
+                            break;
+                        }
+                        local.busy += since(t0);
+                    }
+                } catch (...) {
+                    s.fail(std::current_exception());
+                }
+                std::lock_guard<std::mutex> lock(s.m);
+                s.stats.parse += local;
+                // the last parser closes the queue of the accumulators
+                if (--s.parsers_alive == 0) {
+                    s.accumulate_queue.close();
+                }
+            }
+
+            void accumulate_stage(run_state& s, multicolumn_pcc_accumulator<value_type>& acc) {
+                stage_stats local;
+                try {
+                    for (;;) {
+                        auto t0 = clock::now();
+                        value_chunk* chunk{};
+                        if (!s.accumulate_queue.pop(chunk) || s.failed) {
+                            break;
+                        }
+                        local.waiting += since(t0);
+                        t0 = clock::now();
+                        acc.accumulate(chunk->values.data(), chunk->rows, s.cols, s.cols, 1);
+                        ++local.chunks;
+                        local.rows += chunk->rows;
+                        local.bytes += chunk->rows * s.cols * sizeof(value_type);
+                        s.value_pool.release(chunk);
+                        local.busy += since(t0);
+                    }
+                } catch (...) {
+                    s.fail(std::current_exception());
+                }
+                std::lock_guard<std::mutex> lock(s.m);
+                s.stats.accumulate += local;
+            }
+
+            // fields of the first non blank line of text, 0 if none
+            std::size_t count_columns(std::string_view text) const {
+                while (!text.empty()) {
+                    const auto nl = text.find('\n');
+                    const auto line = text.substr(0, nl);
+                    if (line.find_first_not_of(" \t\r") != std::string_view::npos) {
+                        return std::count(line.begin(), line.end(), options.delimiter) + 1;
+                    }
+                    text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+                }
+                return 0;
+            }
+
+        public:
+            explicit ingestion_pipeline(const pipeline_options& options = {}) : options{options} {
+                if (this->options.parsers == 0 || this->options.accumulators == 0) {
+                    throw std::invalid_argument("At least one parser and one accumulator are required");
+                }
+                if (this->options.chunk_bytes == 0) {
+                    throw std::invalid_argument("chunk_bytes must be positive");
+                }
+            }
+
+            // statistics of the last run()
+            const pipeline_stats& stats() const { return statistics; }
+
+            // Read source to the end and return the accumulator of
+            // all the rows. The calling thread is the reader.
+            multicolumn_pcc_accumulator<value_type> run(const source_type& source) {
+                const auto start = clock::now();
+                const auto workers = options.parsers + options.accumulators;
+                run_state s(options.buffers ? std::max<std::size_t>(options.buffers, 2) : 2*workers, options.parsers);
+                s.cols = options.columns;
+                std::vector<std::unique_ptr<multicolumn_pcc_accumulator<value_type>>> accumulators;
+                std::vector<std::thread> threads;
+                // workers start when the number of columns is known
+                const auto start_workers = [&](){
+                    if (s.cols < 2) {
+                        using namespace std::literals;
+                        throw std::invalid_argument("At least 2 columns are required, found "s + std::to_string(s.cols));
+                    }
+                    for (unsigned p{}; p != options.parsers; ++p) {
+                        threads.emplace_back([this, &s](){ parse_stage(s); });
+                    }
+                    for (unsigned a{}; a != options.accumulators; ++a) {
+                        accumulators.push_back(std::make_unique<multicolumn_pcc_accumulator<value_type>>(int(s.cols)));
+                        threads.emplace_back([this, &s, acc = accumulators.back().get()](){ accumulate_stage(s, *acc); });
+                    }
+                };
+                stage_stats& read = s.stats.read;
+                try {
+                    if (s.cols) {
+                        start_workers();
+                    }
+                    std::vector<char> carry;        // partial line of the previous chunk
+                    std::size_t headers = options.header_lines;
+                    std::size_t line{};
+                    for (bool eof{}; !eof && !s.failed;) {
+                        auto t0 = clock::now();
+                        auto chunk = s.text_pool.acquire();
+                        read.waiting += since(t0);
+                        if (!chunk) {
+                            break;
+                        }
+                        t0 = clock::now();
+                        auto& text = chunk->text;
+                        text.resize(std::max(options.chunk_bytes, 2*carry.size()));
+                        std::copy(carry.begin(), carry.end(), text.begin());
+                        std::size_t filled = carry.size();
+                        std::size_t end{};
+                        for (;;) {
+                            const auto n = source(text.data() + filled, text.size() - filled);
+                            filled += n;
+                            eof = n == 0;
+                            if (eof) {
+                                end = filled;
+                                break;
+                            }
+                            if (filled == text.size()) {
+                                // cut after the last complete line
+                                const auto last = std::find(text.rbegin(), text.rend(), '\n');
+                                if (last != text.rend()) {
+                                    end = text.rend() - last;
+                                    break;
+                                }
+                                // a line longer than the buffer
+                                text.resize(2*text.size());
+                            }
+                        }
+                        read.bytes += filled - carry.size();
+                        carry.assign(text.begin() + end, text.begin() + filled);
+                        std::size_t begin{};
+                        for (; headers && begin != end; --headers, ++line) {
+                            const auto nl = std::find(text.begin() + begin, text.begin() + end, '\n');
+                            begin = nl == text.begin() + end ? end : nl - text.begin() + 1;
+                        }
+                        chunk->begin = begin;
+                        chunk->end = end;
+                        chunk->first_line = line;
+                        chunk->lines = std::count(text.begin() + begin, text.begin() + end, '\n');
+                        line += chunk->lines;
+                        if (threads.empty()) {
+                            s.cols = count_columns(std::string_view(text.data() + begin, end - begin));
+                        }
+                        if (!s.cols || begin == end) {
+                            // nothing to parse, or only blank lines so far
+                            s.text_pool.release(chunk);
+                            read.busy += since(t0);
+                            continue;
+                        }
+                        if (threads.empty()) {
+                            start_workers();
+                        }
+                        ++read.chunks;
+                        if (!s.parse_queue.push(chunk)) {
+                            break;
+                        }
+                        read.busy += since(t0);
+                    }
+                } catch (...) {
+                    s.fail(std::current_exception());
+                }
+                s.parse_queue.close();
+                for (auto& t : threads) {
+                    t.join();
+                }
+                if (s.error) {
+                    std::rethrow_exception(s.error);
+                }
+                if (accumulators.empty()) {
+                    throw std::runtime_error("No rows found");
+                }
+                const auto merge_start = clock::now();
+                auto ans = std::move(*accumulators[0]);
+                for (std::size_t a{1}; a != accumulators.size(); ++a) {
+                    ans += *accumulators[a];
+                }
+                s.stats.merge = since(merge_start);
+                s.stats.seconds = since(start);
+                statistics = s.stats;
+                return ans;
+            }
+
+            multicolumn_pcc_accumulator<value_type> run_file(const std::string& path) {
+                io::file_source source(path);
+                return run(std::ref(source));
+            }
+        };
+
+    } // namespace statistics
+} // namespace math
+
+#endif
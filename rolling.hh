@@ -0,0 +1,176 @@
+
+#ifndef ROLLING
+#define ROLLING
+
+#include "correlation.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace math
+{
+    namespace statistics
+    {
+
+        /**
+         * Pearson Correlation Coefficient over the last W
+         * pairs of samples. Every push() adds the new pair
+         * and removes the oldest one from a pcc_partial, so it
+         * costs O(1). To bound the drift caused by the floating
+         * point cancellations the partial is recomputed from the
+         * ring buffer every reanchor pushes (by default W, so the
+         * amortized cost is still O(1)).
+         */
+        template <typename T = double>
+        class rolling_pcc {
+        public:
+            using value_type = T;
+        private:
+            std::size_t W;
+            std::size_t reanchor_every;
+            // ring buffer, head is the position of the next
+            // sample (the oldest one once the window is full)
+            std::vector<value_type> xs, ys;
+            std::size_t head{}, filled{};
+            std::size_t since_anchor{};
+            pcc_partial<value_type> current;
+
+        public:
+            rolling_pcc(std::size_t window, std::size_t reanchor = 0)
+            : W{window}, reanchor_every{reanchor ? reanchor : window}, xs(window), ys(window)
+            {
+                if (window == 0) {
+                    throw std::invalid_argument("window must be at least 1");
+                }
+            }
+
+            auto& push(value_type v_1, value_type v_2) {
+                if (filled == W) {
+                    current.remove(xs[head], ys[head]);
+                } else {
+                    ++filled;
+                }
+                xs[head] = v_1;
+                ys[head] = v_2;
+                current.accumulate(v_1, v_2);
+                if (++head == W) {
+                    head = 0;
+                }
+                if (++since_anchor == reanchor_every) {
+                    reanchor();
+                }
+                return *this;
+            }
+
+            // recompute the partial from the samples in the window
+            auto& reanchor() {
+                // the samples are always in [0,filled), their
+                // order does not matter
+                current = pearson_correlation_coefficient(xs.data(), ys.data(), filled);
+                since_anchor = 0;
+                return *this;
+            }
+
+            const pcc_partial<value_type>& partial() const { return current; }
+            auto compute() const { return current.compute(); }
+
+            std::size_t window() const { return W; }
+            std::size_t size() const { return filled; }
+            bool full() const { return filled == W; }
+        };
+
+        /**
+         * Rolling correlation matrix of N streams over the last
+         * W rows, same approach of rolling_pcc applied to a
+         * multicolumn_pcc_accumulator: every push() costs
+         * O(N^2) whatever W is.
+         */
+        template <typename T = double>
+        class rolling_multicolumn_pcc {
+        public:
+            using value_type = T;
+        private:
+            int N;
+            std::size_t W;
+            std::size_t reanchor_every;
+            // W rows of N elements, row-major
+            std::vector<value_type> buffer;
+            std::size_t head{}, filled{};
+            std::size_t since_anchor{};
+            multicolumn_pcc_accumulator<value_type> current;
+
+            // N, once the arguments are checked: used in the
+            // initializer, before anything is allocated
+            static int checked_columns(int N, std::size_t window) {
+                using namespace std::literals;
+                if (window == 0) {
+                    throw std::invalid_argument("window must be at least 1");
+                }
+                if (N < 2) {
+                    throw std::invalid_argument("N must be at least 2, found "s + std::to_string(N));
+                }
+                if (window > std::numeric_limits<std::size_t>::max() / sizeof(value_type) / std::size_t(N)) {
+                    throw std::invalid_argument("A window of "s + std::to_string(window) + " rows of "s + std::to_string(N) + " columns is too large"s);
+                }
+                return N;
+            }
+
+        public:
+            rolling_multicolumn_pcc(int N, std::size_t window, std::size_t reanchor = 0)
+            : N{checked_columns(N, window)}, W{window}, reanchor_every{reanchor ? reanchor : window}, buffer(window*std::size_t(N)), current(N)
+            {
+            }
+
+            // push a row of N elements
+            auto& push(const value_type* row) {
+                const auto slot = buffer.data() + head*N;
+                if (filled == W) {
+                    current.remove_row(slot);
+                } else {
+                    ++filled;
+                }
+                std::copy(row, row + N, slot);
+                current.accumulate_row(slot);
+                if (++head == W) {
+                    head = 0;
+                }
+                if (++since_anchor == reanchor_every) {
+                    reanchor();
+                }
+                return *this;
+            }
+
+            auto& push(const std::vector<value_type>& row) {
+                if (row.size() != (std::size_t)N) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(N) + " found "s + std::to_string(row.size()));
+                }
+                return push(row.data());
+            }
+
+            // recompute the accumulator from the rows in the window,
+            // the order of the rows does not matter
+            auto& reanchor() {
+                current.reset();
+                current.accumulate(buffer.data(), filled, N, N, 1);
+                since_anchor = 0;
+                return *this;
+            }
+
+            const multicolumn_pcc_accumulator<value_type>& accumulator() const { return current; }
+            auto packed_results() const { return current.packed_results(); }
+            auto results() const { return current.results(); }
+
+            std::size_t window() const { return W; }
+            std::size_t size() const { return filled; }
+            bool full() const { return filled == W; }
+        };
+
+    } // namespace statistics
+} // namespace math
+
+#endif
@@ -0,0 +1,318 @@
+
+#ifndef SERIALIZATION
+#define SERIALIZATION
+
+#include "columnar.hh"
+#include "correlation.hh"
+#include "mapped_file.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * Binary encoding of the state of pcc_partial and
+ * multicolumn_pcc_accumulator:
+ *
+ *  [header, 64 bytes]
+ *      magic "MPCCSTAT", version, kind, dtype,
+ *      columns, count, position, number of values,
+ *      size of a value
+ *  [values, in the accumulator type of dtype]
+ *      pcc_partial: sum_1 sum_2 sum_1_squared sum_2_squared sum_prod
+ *      multicolumn_pcc_accumulator: totals, squared_totals
+ *          (columns values each) and covariance_total
+ *          (columns*(columns-1)/2 values, couple order)
+ *
+ * The values are the sums as accumulated: dtype itself for
+ * floating point, 64 or 128 bit integers for integer types
+ * (see accumulation_traits). Files written before the size of
+ * a value was recorded have 0 there and are accepted only for
+ * floating point types.
+ * Data are stored in the native byte order. position is not
+ * used by the library: checkpoints can store there how much
+ * of the input has been consumed to resume from it.
+ */
+namespace math
+{
+    namespace io
+    {
+
+        enum class state_kind : std::uint32_t {
+            pcc_partial = 1,
+            multicolumn = 2,
+        };
+
+        struct state_header {
+            char magic[8];
+            std::uint32_t version;
+            state_kind kind;
+            dtype type;
+            std::int32_t columns;
+            std::int64_t count;
+            std::uint64_t position;
+            std::uint64_t values;
+            std::uint32_t value_size;   // sizeof of the accumulator type
+            std::uint8_t reserved[12];
+        };
+        static_assert(sizeof(state_header) == 64, "The header must take 64 bytes");
+
+        constexpr char state_magic[8] = {'M','P','C','C','S','T','A','T'};
+        constexpr std::uint32_t state_version = 1;
+
+        // type of the values stored for series of T
+        template <typename T>
+        using state_value_type = typename statistics::accumulation_traits<T>::accumulator_type;
+
+        struct state_access {
+            template <typename T>
+            static std::size_t values(const statistics::multicolumn_pcc_accumulator<T>& acc) {
+                return 2*acc.totals.size() + acc.covariance_total.size();
+            }
+
+            template <typename T>
+            static void store(const statistics::multicolumn_pcc_accumulator<T>& acc, state_value_type<T>* out) {
+                out = std::copy(std::begin(acc.totals), std::end(acc.totals), out);
+                out = std::copy(std::begin(acc.squared_totals), std::end(acc.squared_totals), out);
+                std::copy(std::begin(acc.covariance_total), std::end(acc.covariance_total), out);
+            }
+
+            // add the state in values (as written by store()) to acc
+            template <typename T>
+            static void add(statistics::multicolumn_pcc_accumulator<T>& acc, long long count, const state_value_type<T>* values) {
+                for (auto& v : acc.totals) {
+                    v += *values++;
+                }
+                for (auto& v : acc.squared_totals) {
+                    v += *values++;
+                }
+                for (auto& v : acc.covariance_total) {
+                    v += *values++;
+                }
+                acc.count += count;
+            }
+        };
+
+        namespace detail
+        {
+
+            inline void write_file(const std::string& path, const std::vector<char>& buffer, bool durable) {
+                const auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd == -1) {
+                    throw std::system_error(errno, std::generic_category(), "cannot create '" + path + "'");
+                }
+                // normally a single write, loop only on short writes
+                std::size_t done{};
+                while (done != buffer.size()) {
+                    const auto n = ::write(fd, buffer.data() + done, buffer.size() - done);
+                    if (n == -1 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n == -1) {
+                        const auto err = errno;
+                        ::close(fd);
+                        throw std::system_error(err, std::generic_category(), "cannot write '" + path + "'");
+                    }
+                    done += n;
+                }
+                if (durable && ::fsync(fd) == -1) {
+                    const auto err = errno;
+                    ::close(fd);
+                    throw std::system_error(err, std::generic_category(), "cannot sync '" + path + "'");
+                }
+                if (::close(fd) == -1) {
+                    throw std::system_error(errno, std::generic_category(), "cannot close '" + path + "'");
+                }
+            }
+
+            // flush the directory containing path, making a rename
+            // into it durable
+            inline void sync_directory(const std::string& path) {
+                using namespace std::literals;
+                const auto slash = path.rfind('/');
+                const auto directory = slash == std::string::npos ? "."s : slash == 0 ? "/"s : path.substr(0, slash);
+                const auto fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+                if (fd == -1) {
+                    throw std::system_error(errno, std::generic_category(), "cannot open '" + directory + "'");
+                }
+                // EINVAL: the file system cannot sync directories
+                if (::fsync(fd) == -1 && errno != EINVAL) {
+                    const auto err = errno;
+                    ::close(fd);
+                    throw std::system_error(err, std::generic_category(), "cannot sync '" + directory + "'");
+                }
+                ::close(fd);
+            }
+
+            template <typename T>
+            inline std::vector<char> encode(state_kind kind, int columns, long long count, std::uint64_t position, std::size_t values) {
+                std::vector<char> buffer(sizeof(state_header) + values*sizeof(state_value_type<T>));
+                state_header h{};
+                std::memcpy(h.magic, state_magic, sizeof(h.magic));
+                h.version = state_version;
+                h.kind = kind;
+                h.type = dtype_of<T>();
+                h.columns = columns;
+                h.count = count;
+                h.position = position;
+                h.values = values;
+                h.value_size = sizeof(state_value_type<T>);
+                std::memcpy(buffer.data(), &h, sizeof(h));
+                return buffer;
+            }
+
+            template <typename T>
+            inline std::vector<char> encode(const statistics::pcc_partial<T>& p, std::uint64_t position) {
+                auto buffer = encode<T>(state_kind::pcc_partial, 2, p.count, position, 5);
+                const state_value_type<T> values[5] = {p.sum_1, p.sum_2, p.sum_1_squared, p.sum_2_squared, p.sum_prod};
+                std::memcpy(buffer.data() + sizeof(state_header), values, sizeof(values));
+                return buffer;
+            }
+
+            template <typename T>
+            inline std::vector<char> encode(const statistics::multicolumn_pcc_accumulator<T>& acc, std::uint64_t position) {
+                auto buffer = encode<T>(state_kind::multicolumn, acc.columns(), acc.rows(), position, state_access::values(acc));
+                state_access::store(acc, reinterpret_cast<state_value_type<T>*>(buffer.data() + sizeof(state_header)));
+                return buffer;
+            }
+
+            template <typename T, int Columns>
+            inline std::vector<char> encode(const statistics::multicolumn_pcc_accumulator<T, Columns>& acc, std::uint64_t position) {
+                return encode(statistics::multicolumn_pcc_accumulator<T>(acc), position);
+            }
+
+            // mapped state file, checked against the expected kind and type
+            template <typename T>
+            class state_file
+            {
+            public:
+                using value_type = state_value_type<T>;
+            private:
+                mapped_file file;
+                state_header h;
+
+            public:
+                state_file(const std::string& path, state_kind kind) : file(path) {
+                    using namespace std::literals;
+                    if (file.size() < sizeof(state_header)) {
+                        throw std::runtime_error("'"s + path + "' is too small to be a state file"s);
+                    }
+                    std::memcpy(&h, file.data(), sizeof(h));
+                    if (std::memcmp(h.magic, state_magic, sizeof(h.magic)) != 0) {
+                        throw std::runtime_error("'"s + path + "' is not a state file"s);
+                    }
+                    if (h.version != state_version) {
+                        throw std::runtime_error("Unsupported version "s + std::to_string(h.version) + " of '"s + path + "'"s);
+                    }
+                    // files without value_size store T itself
+                    const std::size_t value_size = h.value_size ? h.value_size : sizeof(T);
+                    if (h.kind != kind || h.type != dtype_of<T>() || value_size != sizeof(value_type)) {
+                        throw std::runtime_error("Type mismatch reading '"s + path + "'"s);
+                    }
+                    const std::uint64_t expected = kind == state_kind::pcc_partial
+                        ? 5
+                        : 2*std::uint64_t(h.columns) + std::uint64_t(h.columns)*(h.columns-1)/2;
+                    if (h.columns < 2 || h.values != expected || (file.size() - sizeof(h)) / sizeof(value_type) < expected) {
+                        throw std::runtime_error("'"s + path + "' is corrupted or truncated"s);
+                    }
+                    file.advise(0, file.size(), MADV_SEQUENTIAL);
+                }
+
+                const state_header& header() const { return h; }
+
+                // the header takes 64 bytes, values are aligned
+                const value_type* values() const {
+                    return reinterpret_cast<const value_type*>(file.data() + sizeof(state_header));
+                }
+            };
+
+        } // namespace detail
+
+        // write the state in path, position is stored as is
+        template <typename State>
+        inline void save(const std::string& path, const State& state, std::uint64_t position = 0) {
+            detail::write_file(path, detail::encode(state, position), false);
+        }
+
+        // Same as save() but the file is replaced atomically: the
+        // state is written to a temporary file, flushed to disk and
+        // renamed, then the directory is flushed: after a crash path
+        // contains a complete checkpoint, the new or the old one.
+        template <typename State>
+        inline void checkpoint(const std::string& path, const State& state, std::uint64_t position) {
+            const auto tmp = path + ".tmp";
+            detail::write_file(tmp, detail::encode(state, position), true);
+            if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+                const auto err = errno;
+                std::remove(tmp.c_str());
+                throw std::system_error(err, std::generic_category(), "cannot rename '" + tmp + "'");
+            }
+            detail::sync_directory(path);
+        }
+
+        // load a pcc_partial, position (if not null) receives the stored one
+        template <typename T = double>
+        inline statistics::pcc_partial<T> load_partial(const std::string& path, std::uint64_t* position = nullptr) {
+            const detail::state_file<T> file(path, state_kind::pcc_partial);
+            const auto v = file.values();
+            statistics::pcc_partial<T> ans;
+            ans.count = file.header().count;
+            ans.sum_1 = v[0];
+            ans.sum_2 = v[1];
+            ans.sum_1_squared = v[2];
+            ans.sum_2_squared = v[3];
+            ans.sum_prod = v[4];
+            if (position) {
+                *position = file.header().position;
+            }
+            return ans;
+        }
+
+        // load a multicolumn_pcc_accumulator, position (if not null)
+        // receives the stored one
+        template <typename T = double>
+        inline statistics::multicolumn_pcc_accumulator<T> load_accumulator(const std::string& path, std::uint64_t* position = nullptr) {
+            const detail::state_file<T> file(path, state_kind::multicolumn);
+            statistics::multicolumn_pcc_accumulator<T> ans(file.header().columns);
+            state_access::add(ans, file.header().count, file.values());
+            if (position) {
+                *position = file.header().position;
+            }
+            return ans;
+        }
+
+        // Sum the states of the shards in paths with +=, loading
+        // one file at a time so memory does not grow with the shards
+        template <typename T = double>
+        inline statistics::multicolumn_pcc_accumulator<T> merge_accumulators(const std::vector<std::string>& paths) {
+            if (paths.empty()) {
+                throw std::invalid_argument("No state to merge");
+            }
+            auto ans = load_accumulator<T>(paths.front());
+            for (std::size_t i{1}; i != paths.size(); ++i) {
+                ans += load_accumulator<T>(paths[i]);
+            }
+            return ans;
+        }
+
+        template <typename T = double>
+        inline statistics::pcc_partial<T> merge_partials(const std::vector<std::string>& paths) {
+            statistics::pcc_partial<T> ans;
+            for (const auto& path : paths) {
+                ans += load_partial<T>(path);
+            }
+            return ans;
+        }
+
+    } // namespace io
+} // namespace math
+
+#endif
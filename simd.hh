@@ -0,0 +1,100 @@
+
+#ifndef SIMD
+#define SIMD
+
+#include <cstddef>
+#include <new>
+#include <limits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MATH_SIMD_X86 1
+#include <immintrin.h>
+// compile a single function for a given instruction set,
+// it must be called only if the CPU supports it
+#define MATH_SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+/**
+ * Small set of helpers shared by the hand vectorized
+ * kernels: runtime detection of the instruction set
+ * and an allocator for aligned buffers.
+ */
+namespace math
+{
+    namespace simd
+    {
+
+        // instruction sets the kernels know about,
+        // ordered from the least to the most capable
+        enum class isa {
+            scalar,
+            sse2,
+            avx2,       // AVX2 + FMA
+            avx512,     // AVX-512F
+        };
+
+        // query the CPU (CPUID) for the best supported set
+        inline isa detect() {
+#ifdef MATH_SIMD_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) {
+                return isa::avx512;
+            }
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                return isa::avx2;
+            }
+            if (__builtin_cpu_supports("sse2")) {
+                return isa::sse2;
+            }
+#endif
+            return isa::scalar;
+        }
+
+        // instruction set used by the kernels, detected once
+        inline isa& active_isa() {
+            static isa current = detect();
+            return current;
+        }
+
+        // limit the kernels to a less capable instruction set,
+        // useful to test and benchmark every code path.
+        // It is not possible to go beyond what the CPU supports.
+        inline void restrict_isa(isa limit) {
+            const auto best = detect();
+            active_isa() = limit < best ? limit : best;
+        }
+
+        // allocator returning memory aligned to Align bytes,
+        // suitable for std::vector used as kernel scratch buffers
+        template <typename T, std::size_t Align = 64>
+        struct aligned_allocator {
+            using value_type = T;
+
+            template <typename U>
+            struct rebind { using other = aligned_allocator<U, Align>; };
+
+            aligned_allocator() = default;
+            template <typename U>
+            aligned_allocator(const aligned_allocator<U, Align>&) {}
+
+            T* allocate(std::size_t n) {
+                if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+                    throw std::bad_alloc();
+                }
+                return static_cast<T*>(::operator new(n*sizeof(T), std::align_val_t(Align)));
+            }
+
+            void deallocate(T* p, std::size_t) {
+                ::operator delete(p, std::align_val_t(Align));
+            }
+
+            template <typename U>
+            bool operator==(const aligned_allocator<U, Align>&) const { return true; }
+            template <typename U>
+            bool operator!=(const aligned_allocator<U, Align>&) const { return false; }
+        };
+
+    } // namespace simd
+} // namespace math
+
+#endif
@@ -0,0 +1,214 @@
+
+#ifndef SPEARMAN
+#define SPEARMAN
+
+#include "correlation.hh"
+#include "parallel_correlation.hh"
+#include "thread_pool.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Spearman rank correlation: the Pearson Correlation
+ * Coefficient of the ranks of the values, ties get the
+ * average of the ranks they span. Ranks are computed by a
+ * LSD radix sort on keys whose unsigned order is the order
+ * of the values, and then go through the usual pcc kernels.
+ * NaN have no rank, the result with NaN in the input is
+ * unspecified.
+ */
+namespace math
+{
+    namespace statistics
+    {
+
+        namespace detail
+        {
+
+            // unsigned key with the same order of the values
+            template <typename T>
+            inline auto radix_key(T v) {
+                if constexpr (std::is_floating_point_v<T>) {
+                    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "Unsupported floating point type");
+                    using K = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+                    constexpr K sign = K(1) << (sizeof(K)*8 - 1);
+                    // -0 and +0 are the same value
+                    if (v == 0) {
+                        v = 0;
+                    }
+                    K k;
+                    std::memcpy(&k, &v, sizeof(k));
+                    // negative values: reverse the order of the magnitudes
+                    return k & sign ? ~k : k | sign;
+                } else {
+                    static_assert(std::is_integral_v<T>, "Only arithmetic types can be ranked");
+                    using K = std::make_unsigned_t<T>;
+                    if constexpr (std::is_signed_v<T>) {
+                        return K(K(v) ^ (K(1) << (sizeof(K)*8 - 1)));
+                    } else {
+                        return K(v);
+                    }
+                }
+            }
+
+        } // namespace detail
+
+        /**
+         * Buffers used to rank a series, reused across series of
+         * up to the same length to avoid allocations.
+         */
+        template <typename T>
+        class rank_scratch
+        {
+        public:
+            using key_type = decltype(detail::radix_key(T{}));
+        private:
+            std::vector<key_type> keys, keys_tmp;
+            std::vector<std::uint32_t> index, index_tmp;
+
+            // sort keys[0,n) carrying index along, the result is
+            // left in keys and index
+            void sort(std::size_t n) {
+                constexpr std::size_t digits = sizeof(key_type);
+                // histograms of all the digits in a single pass
+                std::size_t hist[digits][256]{};
+                for (std::size_t i{}; i != n; ++i) {
+                    auto k = keys[i];
+                    for (std::size_t d{}; d != digits; ++d) {
+                        ++hist[d][k & 0xff];
+                        k >>= 8;
+                    }
+                }
+                for (std::size_t d{}; d != digits; ++d) {
+                    const auto shift = 8*d;
+                    // all the keys have the same digit: nothing to do
+                    if (hist[d][(keys[0] >> shift) & 0xff] == n) {
+                        continue;
+                    }
+                    std::size_t offset[256];
+                    std::size_t sum{};
+                    for (std::size_t b{}; b != 256; ++b) {
+                        offset[b] = sum;
+                        sum += hist[d][b];
+                    }
+                    for (std::size_t i{}; i != n; ++i) {
+                        const auto pos = offset[(keys[i] >> shift) & 0xff]++;
+                        keys_tmp[pos] = keys[i];
+                        index_tmp[pos] = index[i];
+                    }
+                    keys.swap(keys_tmp);
+                    index.swap(index_tmp);
+                }
+            }
+
+        public:
+            // Store the rank (from 1, average for ties) of
+            // v[i*stride] in out[i*out_stride], for i in [0,size)
+            template <typename R>
+            void rank(const T* v, std::size_t size, std::size_t stride, R* out, std::size_t out_stride) {
+                if (size == 0) {
+                    return;
+                }
+                if (size > std::numeric_limits<std::uint32_t>::max()) {
+                    throw std::invalid_argument("Too many values to rank");
+                }
+                if (keys.size() < size) {
+                    keys.resize(size);
+                    keys_tmp.resize(size);
+                    index.resize(size);
+                    index_tmp.resize(size);
+                }
+                for (std::size_t i{}; i != size; ++i) {
+                    keys[i] = detail::radix_key(v[i*stride]);
+                    index[i] = i;
+                }
+                sort(size);
+                for (std::size_t begin{}; begin != size;) {
+                    auto end = begin + 1;
+                    while (end != size && keys[end] == keys[begin]) {
+                        ++end;
+                    }
+                    // positions [begin,end) have ranks [begin+1,end]
+                    const R r = R(begin + 1 + end) / 2;
+                    for (auto i = begin; i != end; ++i) {
+                        out[index[i]*out_stride] = r;
+                    }
+                    begin = end;
+                }
+            }
+        };
+
+        // Spearman coefficient of two series of size elements
+        template <typename T, typename R = double>
+        inline R spearman_correlation_coefficient(const T* v1, const T* v2, std::size_t size) {
+            static thread_local rank_scratch<T> scratch;
+            static thread_local std::vector<R> r1, r2;
+            r1.resize(size);
+            r2.resize(size);
+            scratch.rank(v1, size, 1, r1.data(), 1);
+            scratch.rank(v2, size, 1, r2.data(), 1);
+            return pearson_correlation_coefficient<R, R>(r1.data(), r2.data(), size).compute();
+        }
+
+        template <typename T, typename R = double>
+        inline R spearman_correlation_coefficient(const std::vector<T>& v1, const std::vector<T>& v2) {
+            if (v1.size() != v2.size()) {
+                using namespace std::literals;
+                throw std::invalid_argument("Arguments must have the same length, found len(v1)="s + std::to_string(v1.size()) + ", len(v2)=" + std::to_string(v2.size()));
+            }
+            return spearman_correlation_coefficient<T, R>(v1.data(), v2.data(), v1.size());
+        }
+
+        // Rank every column of matrix (described as for
+        // multicolumn_pcc_accumulator::accumulate) into ranks,
+        // column-major with rows elements per column.
+        // Columns are ranked in parallel, every thread reuses
+        // its own scratch buffers.
+        template <typename T, typename R>
+        inline void rank_columns(
+            const T* matrix, std::size_t rows, std::size_t cols,
+            std::size_t row_offset, std::size_t col_offset,
+            R* ranks, parallel::thread_pool& pool
+        ) {
+            pool.parallel_for(cols, [&](std::size_t c){
+                static thread_local rank_scratch<T> scratch;
+                scratch.rank(matrix + c*col_offset, rows, row_offset, ranks + c*rows, 1);
+            });
+        }
+
+        // Spearman coefficients of all the pairs of columns of matrix,
+        // in the same order of multicolumn_pcc_accumulator::packed_results()
+        template <typename T, typename R = double>
+        inline correlation_matrix<R> spearman_correlation_matrix(
+            const T* matrix, std::size_t rows, std::size_t cols,
+            std::size_t row_offset, std::size_t col_offset,
+            unsigned threads = 0
+        ) {
+            if (cols < 2) {
+                using namespace std::literals;
+                throw std::invalid_argument("At least 2 columns are required, found "s + std::to_string(cols));
+            }
+            parallel_options options;
+            options.threads = threads ? threads : parallel::default_threads();
+            std::vector<R, simd::aligned_allocator<R>> ranks(rows*cols);
+            {
+                parallel::thread_pool pool(options.threads);
+                rank_columns(matrix, rows, cols, row_offset, col_offset, ranks.data(), pool);
+            }
+            multicolumn_pcc_accumulator<R> acc(cols);
+            parallel_accumulate(acc, ranks.data(), rows, cols, 1, rows, options);
+            return acc.packed_results();
+        }
+
+    } // namespace statistics
+} // namespace math
+
+#endif
@@ -0,0 +1,469 @@
+
+#ifndef STABLE_CORRELATION
+#define STABLE_CORRELATION
+
+#include "correlation.hh"
+#include "covariance_kernel.hh"
+#include "pcc_kernel.hh"
+#include "simd.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Numerically stable accumulators: instead of the raw sums
+ * they keep the means and the sums of the products of the
+ * deviations from the means (co-moments), updated one sample
+ * at a time with Welford's recurrence and merged with the
+ * pairwise formula of Chan et al.:
+ *  n = na + nb, d = mean_b - mean_a
+ *  mean = mean_a + d*nb/n
+ *  C = C_a + C_b + d_1*d_2*na*nb/n
+ * The coefficient is C_12 / sqrt(C_11*C_22), there is no
+ * difference of large sums so a large mean with respect to the
+ * variance does not cancel the significant digits, and float
+ * is usable where pcc_partial needs long double.
+ * The means are stored relative to a shift, the first value
+ * seen, so they keep their precision too (the d of the merge
+ * would otherwise be rounded to the magnitude of the data).
+ * Batches are centered on the current mean and go through the
+ * vectorized kernels, then are merged as a whole.
+ */
+namespace math
+{
+    namespace statistics
+    {
+        namespace kernels
+        {
+
+#ifdef MATH_SIMD_X86
+            MATH_SIMD_TARGET("avx2")
+            inline void center_avx2(const double* v, std::size_t n, double shift, double mean, double* out) {
+                const auto s = _mm256_set1_pd(shift), m = _mm256_set1_pd(mean);
+                std::size_t i{};
+                for (; i + 4 <= n; i += 4) {
+                    _mm256_storeu_pd(out + i, _mm256_sub_pd(_mm256_sub_pd(_mm256_loadu_pd(v + i), s), m));
+                }
+                for (; i != n; ++i) {
+                    out[i] = (v[i] - shift) - mean;
+                }
+            }
+
+            MATH_SIMD_TARGET("avx2")
+            inline void center_avx2(const float* v, std::size_t n, float shift, float mean, float* out) {
+                const auto s = _mm256_set1_ps(shift), m = _mm256_set1_ps(mean);
+                std::size_t i{};
+                for (; i + 8 <= n; i += 8) {
+                    _mm256_storeu_ps(out + i, _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(v + i), s), m));
+                }
+                for (; i != n; ++i) {
+                    out[i] = (v[i] - shift) - mean;
+                }
+            }
+
+            MATH_SIMD_TARGET("avx2")
+            inline void center_avx2(const double* v, std::size_t n, const double* shift, const double* mean, double* out) {
+                std::size_t i{};
+                for (; i + 4 <= n; i += 4) {
+                    const auto d = _mm256_sub_pd(_mm256_loadu_pd(v + i), _mm256_loadu_pd(shift + i));
+                    _mm256_storeu_pd(out + i, _mm256_sub_pd(d, _mm256_loadu_pd(mean + i)));
+                }
+                for (; i != n; ++i) {
+                    out[i] = (v[i] - shift[i]) - mean[i];
+                }
+            }
+
+            MATH_SIMD_TARGET("avx2")
+            inline void center_avx2(const float* v, std::size_t n, const float* shift, const float* mean, float* out) {
+                std::size_t i{};
+                for (; i + 8 <= n; i += 8) {
+                    const auto d = _mm256_sub_ps(_mm256_loadu_ps(v + i), _mm256_loadu_ps(shift + i));
+                    _mm256_storeu_ps(out + i, _mm256_sub_ps(d, _mm256_loadu_ps(mean + i)));
+                }
+                for (; i != n; ++i) {
+                    out[i] = (v[i] - shift[i]) - mean[i];
+                }
+            }
+#endif
+
+            // out[i] = (v[i*scatter] - shift) - mean, the order of
+            // the subtractions keeps the small differences exact
+            template <typename T>
+            inline void center(const T* v, std::size_t n, std::size_t scatter, T shift, T mean, T* out) {
+#ifdef MATH_SIMD_X86
+                if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+                    if (scatter == 1 && simd::active_isa() >= simd::isa::avx2) {
+                        return center_avx2(v, n, shift, mean, out);
+                    }
+                }
+#endif
+                for (std::size_t i{}; i != n; ++i) {
+                    out[i] = (v[i*scatter] - shift) - mean;
+                }
+            }
+
+            // out[i] = (v[i] - shift[i]) - mean[i], a row of a matrix
+            // centered on the shifts and the means of its columns
+            template <typename T>
+            inline void center(const T* v, std::size_t n, const T* shift, const T* mean, T* out) {
+#ifdef MATH_SIMD_X86
+                if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+                    if (simd::active_isa() >= simd::isa::avx2) {
+                        return center_avx2(v, n, shift, mean, out);
+                    }
+                }
+#endif
+                for (std::size_t i{}; i != n; ++i) {
+                    out[i] = (v[i] - shift[i]) - mean[i];
+                }
+            }
+
+        } // namespace kernels
+
+        template <typename T = double>
+        class stable_pcc
+        {
+            static_assert(std::is_floating_point_v<T>, "Only floating point types are supported");
+        public:
+            using value_type = T;
+        private:
+            long long count{};
+            value_type shift_1{}, shift_2{};
+            value_type mean_1{}, mean_2{};  // minus the shifts
+            value_type m2_1{}, m2_2{};      // sum((v - mean)^2)
+            value_type comoment{};          // sum((v_1 - mean_1)*(v_2 - mean_2))
+
+            // elements processed at once by the batch update
+            static constexpr std::size_t block = 1024;
+
+        public:
+            // Welford update
+            auto& accumulate(value_type v_1, value_type v_2) {
+                if (count == 0) {
+                    shift_1 = v_1;
+                    shift_2 = v_2;
+                }
+                ++count;
+                v_1 -= shift_1;
+                v_2 -= shift_2;
+                const auto d_1 = v_1 - mean_1;
+                const auto d_2 = v_2 - mean_2;
+                mean_1 += d_1 / count;
+                mean_2 += d_2 / count;
+                m2_1 += d_1*(v_1 - mean_1);
+                m2_2 += d_2*(v_2 - mean_2);
+                comoment += d_1*(v_2 - mean_2);
+                return *this;
+            }
+
+            // size elements of two series, scatter apart
+            auto& accumulate(const value_type* v1, const value_type* v2, std::size_t size, std::size_t scatter = 1) {
+                static thread_local std::vector<value_type, simd::aligned_allocator<value_type>> x, y;
+                x.resize(block);
+                y.resize(block);
+                if (count == 0 && size) {
+                    shift_1 = v1[0];
+                    shift_2 = v2[0];
+                }
+                for (std::size_t b0{}; b0 < size; b0 += block) {
+                    const auto n = std::min(block, size - b0);
+                    // around the current mean the raw sums do not
+                    // cancel
+                    kernels::center(v1 + b0*scatter, n, scatter, shift_1, mean_1, x.data());
+                    kernels::center(v2 + b0*scatter, n, scatter, shift_2, mean_2, y.data());
+                    value_type sums[5];
+                    kernels::pcc_sums(x.data(), y.data(), n, 1, sums);
+                    stable_pcc b;
+                    b.count = n;
+                    b.shift_1 = shift_1;
+                    b.shift_2 = shift_2;
+                    b.mean_1 = mean_1 + sums[0] / n;
+                    b.mean_2 = mean_2 + sums[1] / n;
+                    b.m2_1 = sums[2] - sums[0]*sums[0] / n;
+                    b.m2_2 = sums[3] - sums[1]*sums[1] / n;
+                    b.comoment = sums[4] - sums[0]*sums[1] / n;
+                    *this += b;
+                }
+                return *this;
+            }
+
+            auto& accumulate(const std::vector<value_type>& v1, const std::vector<value_type>& v2) {
+                if (v1.size() != v2.size()) {
+                    using namespace std::literals;
+                    throw std::invalid_argument("Arguments must have the same length, found len(v1)="s + std::to_string(v1.size()) + ", len(v2)=" + std::to_string(v2.size()));
+                }
+                return accumulate(v1.data(), v2.data(), v1.size());
+            }
+
+            // Chan merge
+            auto& operator+=(const stable_pcc& o) {
+                if (o.count == 0) {
+                    return *this;
+                }
+                if (count == 0) {
+                    return *this = o;
+                }
+                const value_type na = count, nb = o.count, n = na + nb;
+                const auto f = na*nb / n;
+                const auto d_1 = (o.shift_1 - shift_1) + o.mean_1 - mean_1;
+                const auto d_2 = (o.shift_2 - shift_2) + o.mean_2 - mean_2;
+                mean_1 += d_1*nb / n;
+                mean_2 += d_2*nb / n;
+                m2_1 += o.m2_1 + d_1*d_1*f;
+                m2_2 += o.m2_2 + d_2*d_2*f;
+                comoment += o.comoment + d_1*d_2*f;
+                count += o.count;
+                return *this;
+            }
+
+            auto operator+(const stable_pcc& o) const {
+                auto ans = *this;
+                ans += o;
+                return ans;
+            }
+
+            auto compute() const -> value_type {
+                const auto den = m2_1*m2_2;
+                return count && den > 0 ? comoment / std::sqrt(den) : 0;
+            }
+
+            long long rows() const { return count; }
+            value_type mean(int i) const { return i ? shift_2 + mean_2 : shift_1 + mean_1; }
+            // population covariance
+            value_type covariance() const { return count ? comoment / count : 0; }
+
+            auto& reset() {
+                return *this = stable_pcc();
+            }
+        };
+
+        /**
+         * Stable version of multicolumn_pcc_accumulator: means
+         * and sums of squared deviations of the N columns and the
+         * co-moments of the pairs, in couple order.
+         * A matrix is processed in blocks of rows: each block is
+         * centered on the current means into a contiguous panel
+         * whose co-moments come from the covariance kernel (syrk),
+         * and the block is then merged as a whole.
+         */
+        template <typename T = double>
+        class stable_multicolumn_pcc
+        {
+            static_assert(std::is_floating_point_v<T>, "Only floating point types are supported");
+        public:
+            using value_type = T;
+        private:
+            int N;
+            long long count{};
+            std::vector<value_type> shift;
+            std::vector<value_type> means;      // minus shift
+            std::vector<value_type> m2;
+            std::vector<value_type> comoment;
+            std::vector<value_type> deviation;  // scratch of accumulate_row
+
+            // rows centered and multiplied at once by accumulate(matrix, ...)
+            static constexpr std::size_t block = 2*kernels::block_rows<T>();
+
+            // Chan merge of rows_b rows with the given statistics,
+            // means_b relative to shift_b
+            void merge(long long rows_b, const value_type* shift_b, const value_type* means_b, const value_type* m2_b, const value_type* comoment_b) {
+                if (rows_b == 0) {
+                    return;
+                }
+                if (count == 0) {
+                    std::copy(shift_b, shift_b + N, shift.begin());
+                }
+                const value_type na = count, nb = rows_b, n = na + nb;
+                const auto f = na*nb / n;
+                const auto w = nb / n;
+                for (int c{}; c != N; ++c) {
+                    deviation[c] = (shift_b[c] - shift[c]) + means_b[c] - means[c];
+                    means[c] += deviation[c]*w;
+                    m2[c] += m2_b[c] + deviation[c]*deviation[c]*f;
+                }
+                auto out = comoment.data();
+                for (int i{}; i < N-1; ++i) {
+                    const auto di = deviation[i]*f;
+                    for (int j{i+1}; j != N; ++j) {
+                        *out++ += *comoment_b++ + di*deviation[j];
+                    }
+                }
+                count += rows_b;
+            }
+
+        public:
+            explicit stable_multicolumn_pcc(int N)
+            : N{N}, shift(std::max(N, 0)), means(std::max(N, 0)), m2(std::max(N, 0)), deviation(std::max(N, 0))
+            {
+                if (N < 2) {
+                    using namespace std::literals;
+                    throw std::invalid_argument("N must be at least 2, found "s + std::to_string(N));
+                }
+                comoment.resize(std::size_t(N)*(N-1)/2);
+            }
+
+            // Welford update with a row of N elements
+            auto& accumulate_row(const value_type* row) {
+                if (count == 0) {
+                    std::copy(row, row + N, shift.begin());
+                }
+                ++count;
+                const value_type n = count;
+                for (int c{}; c != N; ++c) {
+                    deviation[c] = (row[c] - shift[c]) - means[c];
+                    means[c] += deviation[c] / n;
+                }
+                // d_i*(x_j - new mean_j) = d_i*d_j*(n-1)/n
+                const auto f = (n - 1) / n;
+                auto out = comoment.data();
+                for (int i{}; i != N; ++i) {
+                    const auto di = deviation[i]*f;
+                    m2[i] += di*deviation[i];
+                    for (int j{i+1}; j != N; ++j) {
+                        *out++ += di*deviation[j];
+                    }
+                }
+                return *this;
+            }
+
+            auto& accumulate(const value_type* row, std::size_t size) {
+                if (size != std::size_t(N)) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(N) + " found "s + std::to_string(size));
+                }
+                return accumulate_row(row);
+            }
+
+            auto& accumulate(const std::vector<value_type>& row) {
+                return accumulate(row.data(), row.size());
+            }
+
+            // matrix described as for multicolumn_pcc_accumulator::accumulate
+            auto& accumulate(
+                const value_type* matrix, std::size_t rows, std::size_t cols,
+                std::size_t row_offset, std::size_t col_offset
+            ) {
+                if (cols != std::size_t(N)) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Wrong number of columns received, expected "s + std::to_string(N) + " found "s + std::to_string(cols));
+                }
+                static thread_local std::vector<value_type, simd::aligned_allocator<value_type>> panel;
+                static thread_local std::vector<value_type> block_means, totals, block_m2, block_comoment;
+                if (count == 0 && rows) {
+                    for (std::size_t c{}; c != cols; ++c) {
+                        shift[c] = matrix[c*col_offset];
+                    }
+                }
+                panel.resize(block*cols);
+                block_means.resize(cols);
+                totals.resize(cols);
+                block_m2.resize(cols);
+                block_comoment.resize(comoment.size());
+                for (std::size_t r0{}; r0 < rows; r0 += block) {
+                    const auto n = std::min(block, rows - r0);
+                    const auto chunk = matrix + r0*row_offset;
+                    for (std::size_t r{}; r != n; ++r) {
+                        if (col_offset == 1) {
+                            kernels::center(chunk + r*row_offset, cols, shift.data(), means.data(), panel.data() + r*cols);
+                            continue;
+                        }
+                        for (std::size_t c{}; c != cols; ++c) {
+                            panel[r*cols + c] = (chunk[r*row_offset + c*col_offset] - shift[c]) - means[c];
+                        }
+                    }
+                    std::fill(totals.begin(), totals.end(), value_type{});
+                    std::fill(block_m2.begin(), block_m2.end(), value_type{});
+                    std::fill(block_comoment.begin(), block_comoment.end(), value_type{});
+                    kernels::syrk(
+                        panel.data(), n, cols, cols, 1, 0, kernels::groups(cols),
+                        block_comoment.data(), totals.data(), block_m2.data()
+                    );
+                    // moments of the block around its own means
+                    for (std::size_t c{}; c != cols; ++c) {
+                        block_m2[c] -= totals[c]*totals[c] / n;
+                        block_means[c] = means[c] + totals[c] / n;
+                    }
+                    auto out = block_comoment.data();
+                    for (std::size_t i{}; i + 1 < cols; ++i) {
+                        const auto ti = totals[i] / n;
+                        for (auto j = i+1; j != cols; ++j) {
+                            *out++ -= ti*totals[j];
+                        }
+                    }
+                    merge(n, shift.data(), block_means.data(), block_m2.data(), block_comoment.data());
+                }
+                return *this;
+            }
+
+            auto& operator+=(const stable_multicolumn_pcc& o) {
+                if (N != o.N) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Size mismatch, this->N = "s + std::to_string(N) + ", other.N = "s + std::to_string(o.N));
+                }
+                merge(o.count, o.shift.data(), o.means.data(), o.m2.data(), o.comoment.data());
+                return *this;
+            }
+
+            auto operator+(const stable_multicolumn_pcc& o) const {
+                auto ans = *this;
+                ans += o;
+                return ans;
+            }
+
+            int columns() const { return N; }
+            long long rows() const { return count; }
+            value_type mean(int c) const { return shift[c] + means[c]; }
+            // population covariance of the pair (i,j), i < j
+            value_type covariance(int i, int j) const {
+                return count ? comoment[kernels::pair_index(N, i, j)] / count : 0;
+            }
+
+            auto& reset() {
+                count = 0;
+                std::fill(shift.begin(), shift.end(), value_type{});
+                std::fill(means.begin(), means.end(), value_type{});
+                std::fill(m2.begin(), m2.end(), value_type{});
+                std::fill(comoment.begin(), comoment.end(), value_type{});
+                return *this;
+            }
+
+            // coefficients of all the pairs in couple order
+            correlation_matrix<value_type> packed_results() const {
+                correlation_matrix<value_type> ans(N);
+                auto out = ans.data();
+                auto cov = comoment.data();
+                for (int i{}; i < N-1; ++i) {
+                    for (int j{i+1}; j != N; ++j) {
+                        const auto den = m2[i]*m2[j];
+                        *out++ = den > 0 ? *cov / std::sqrt(den) : 0;
+                        ++cov;
+                    }
+                }
+                return ans;
+            }
+
+            auto results() const {
+                const auto packed = packed_results();
+                std::map<std::pair<int,int>,value_type> ans;
+                auto packed_iterator = packed.begin();
+                for (int i{}; i!=N-1; ++i) {
+                    for (int j{i+1}; j!=N; ++j) {
+                        ans[std::make_pair(i,j)] = *packed_iterator;
+                        ++packed_iterator;
+                    }
+                }
+                return ans;
+            }
+        };
+
+    } // namespace statistics
+} // namespace math
+
+#endif
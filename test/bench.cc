@@ -0,0 +1,346 @@
+
+// Throughput of the correlation and parsing kernels.
+//
+//  ./bench [--quick] [--min-time S] [--csv FILE] [--json FILE] [--baseline FILE]
+//
+// Every case is repeated until it runs for at least --min-time
+// seconds and the best time of a single repetition is reported
+// as ns per element, GB/s (bytes of input read) and pairs/s
+// (pairs of columns times rows). --csv and --json write all
+// the results, --baseline compares them with a previous CSV.
+
+#include "../correlation.hh"
+#include "../parallel_correlation.hh"
+#include "../couple.hh"
+#include "../convertions.hh"
+#include "../stable_correlation.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace math::statistics;
+
+struct result {
+    std::string name;
+    std::string dtype;
+    std::string layout;
+    unsigned threads;
+    std::size_t size;       // main size parameter of the case
+    double seconds;         // best time of a repetition
+    double elements;        // elements processed by a repetition
+    double bytes;           // bytes read by a repetition
+    double pairs;           // pair updates done by a repetition
+
+    std::string key() const {
+        return name + "/" + dtype + "/" + layout + "/" + std::to_string(threads) + "/" + std::to_string(size);
+    }
+    double ns_per_element() const { return elements ? seconds*1e9 / elements : 0; }
+    double gb_per_second() const { return bytes / seconds / 1e9; }
+    double pairs_per_second() const { return pairs / seconds; }
+};
+
+static double min_time = 0.2;
+static std::vector<result> results;
+
+// value depending on the result of a case, so that it is not optimized away
+static volatile double sink;
+
+template <typename F>
+static double best_time(F f) {
+    using clock = std::chrono::steady_clock;
+    f();
+    double best = 1e300;
+    const auto start = clock::now();
+    do {
+        const auto t0 = clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double>(clock::now() - t0).count());
+    } while (std::chrono::duration<double>(clock::now() - start).count() < min_time);
+    return best;
+}
+
+static void report(result r) {
+    results.push_back(r);
+    std::cout << std::left << std::setw(34) << r.name << std::setw(8) << r.dtype << std::setw(14) << r.layout
+              << std::right << std::setw(4) << r.threads << std::setw(10) << r.size
+              << std::fixed << std::setprecision(3)
+              << std::setw(12) << r.ns_per_element() << " ns/el"
+              << std::setw(10) << r.gb_per_second() << " GB/s"
+              << std::scientific << std::setprecision(3)
+              << std::setw(12) << r.pairs_per_second() << " pairs/s\n" << std::defaultfloat;
+}
+
+template <typename T>
+static std::vector<T> random_values(std::size_t n) {
+    std::default_random_engine generator(42);
+    std::normal_distribution<T> distribution(10, 3);
+    std::vector<T> ans(n);
+    for (auto& v : ans) {
+        v = distribution(generator);
+    }
+    return ans;
+}
+
+template <typename T>
+static const char* dtype() {
+    return sizeof(T) == 4 ? "float" : "double";
+}
+
+template <typename T>
+static void bench_pairwise(std::size_t n) {
+    const auto v1 = random_values<T>(n), v2 = random_values<T>(n);
+    const double bytes = 2.0*n*sizeof(T);
+    report({"pcc(vector)", dtype<T>(), "contiguous", 1, n,
+        best_time([&](){ sink = pearson_correlation_coefficient(v1, v2).sum_prod; }), double(n), bytes, double(n)});
+    report({"pcc(pointer)", dtype<T>(), "contiguous", 1, n,
+        best_time([&](){ sink = pearson_correlation_coefficient(v1.data(), v2.data(), n).sum_prod; }), double(n), bytes, double(n)});
+    // two columns of a row-major matrix of 16 columns
+    constexpr std::size_t scatter = 16;
+    const auto m = random_values<T>(n*scatter);
+    report({"pcc_scattered", dtype<T>(), "stride16", 1, n,
+        best_time([&](){ sink = pearson_correlation_coefficient_scattered(m.data(), m.data() + 1, n, scatter).sum_prod; }), double(n), bytes, double(n)});
+    report({"stable_pcc", dtype<T>(), "contiguous", 1, n,
+        best_time([&](){ sink = stable_pcc<T>().accumulate(v1.data(), v2.data(), n).compute(); }), double(n), bytes, double(n)});
+}
+
+template <typename T>
+static void bench_multicolumn(std::size_t rows, std::size_t cols, const std::vector<unsigned>& threads) {
+    const auto m = random_values<T>(rows*cols);
+    // same data column-major
+    std::vector<T> t(rows*cols);
+    for (std::size_t r{}; r != rows; ++r) {
+        for (std::size_t c{}; c != cols; ++c) {
+            t[c*rows + r] = m[r*cols + c];
+        }
+    }
+    const double elements = double(rows)*cols;
+    const double bytes = elements*sizeof(T);
+    const double pairs = double(rows)*cols*(cols-1)/2;
+    {
+        std::vector<T> row(cols);
+        // a subset of the rows, the row path is much slower
+        const auto few = std::min<std::size_t>(rows, 256);
+        report({"multicolumn.accumulate(row)", dtype<T>(), "row-major", 1, cols,
+            best_time([&](){
+                multicolumn_pcc_accumulator<T> acc(cols);
+                for (std::size_t r{}; r != few; ++r) {
+                    std::copy(m.begin() + r*cols, m.begin() + (r+1)*cols, row.begin());
+                    acc.accumulate(row);
+                }
+                sink = acc.rows();
+            }), double(few)*cols, double(few)*cols*sizeof(T), double(few)*cols*(cols-1)/2});
+    }
+    report({"multicolumn.accumulate(matrix)", dtype<T>(), "row-major", 1, cols,
+        best_time([&](){
+            multicolumn_pcc_accumulator<T> acc(cols);
+            acc.accumulate(m.data(), rows, cols, cols, 1);
+            sink = acc.rows();
+        }), elements, bytes, pairs});
+    report({"multicolumn.accumulate(matrix)", dtype<T>(), "column-major", 1, cols,
+        best_time([&](){
+            multicolumn_pcc_accumulator<T> acc(cols);
+            acc.accumulate(t.data(), rows, cols, 1, rows);
+            sink = acc.rows();
+        }), elements, bytes, pairs});
+    report({"stable_multicolumn.accumulate", dtype<T>(), "row-major", 1, cols,
+        best_time([&](){
+            stable_multicolumn_pcc<T> acc(cols);
+            acc.accumulate(m.data(), rows, cols, cols, 1);
+            sink = acc.rows();
+        }), elements, bytes, pairs});
+    for (auto n : threads) {
+        parallel_options options;
+        options.threads = n;
+        report({"parallel_accumulate", dtype<T>(), "row-major", n, cols,
+            best_time([&](){
+                multicolumn_pcc_accumulator<T> acc(cols);
+                parallel_accumulate(acc, m.data(), rows, cols, cols, 1, options);
+                sink = acc.rows();
+            }), elements, bytes, pairs});
+    }
+    multicolumn_pcc_accumulator<T> acc(cols);
+    acc.accumulate(m.data(), rows, cols, cols, 1);
+    const double triangle = double(cols)*(cols-1)/2;
+    report({"multicolumn.packed_results", dtype<T>(), "-", 1, cols,
+        best_time([&](){ sink = acc.packed_results()[0]; }), triangle, triangle*sizeof(T), triangle});
+    report({"multicolumn.results", dtype<T>(), "-", 1, cols,
+        best_time([&](){ sink = acc.results().size(); }), triangle, triangle*sizeof(T), triangle});
+}
+
+static void bench_couple(int n) {
+    const double pairs = double(n)*(n-1)/2;
+    report({"couple.inc", "-", "-", 1, std::size_t(n),
+        best_time([&](){
+            long long tot{};
+            for (math::sets::couple c(n); c; ++c) {
+                tot += c.first() ^ c.second();
+            }
+            sink = tot;
+        }), pairs, 0, pairs});
+    report({"couple_range", "-", "-", 1, std::size_t(n),
+        best_time([&](){
+            long long tot{};
+            for (const auto p : math::sets::couple_range(n)) {
+                tot += p.first ^ p.second;
+            }
+            sink = tot;
+        }), pairs, 0, pairs});
+}
+
+template <typename T>
+static void bench_parsing(std::size_t n) {
+    const auto values = random_values<T>(n);
+    std::vector<std::string> fields;
+    std::string text;
+    for (auto v : values) {
+        std::ostringstream s;
+        s << std::setprecision(sizeof(T) == 4 ? 9 : 17) << v;
+        fields.push_back(s.str());
+        text += fields.back() + (fields.size() % 8 ? ',' : '\n');
+    }
+    double bytes{};
+    for (const auto& f : fields) {
+        bytes += f.size();
+    }
+    report({"convertions::ston", dtype<T>(), "-", 1, n,
+        best_time([&](){
+            T tot{};
+            for (const auto& f : fields) {
+                tot += math::convertions::ston<T>(f);
+            }
+            sink = tot;
+        }), double(n), bytes, 0});
+    report({"convertions::parse", dtype<T>(), "-", 1, n,
+        best_time([&](){
+            T tot{}, v{};
+            for (const auto& f : fields) {
+                math::convertions::parse(f, v);
+                tot += v;
+            }
+            sink = tot;
+        }), double(n), bytes, 0});
+    std::vector<T> out(n);
+    report({"convertions::parse_rows", dtype<T>(), "row-major", 1, n,
+        best_time([&](){
+            sink = math::convertions::parse_rows(text, ',', out.data(), 8, n/8, 8, 1).rows;
+        }), double(n/8*8), double(text.size()), 0});
+}
+
+static void write_csv(const std::string& path) {
+    std::ofstream out(path);
+    out << "name,dtype,layout,threads,size,seconds,ns_per_element,gb_per_second,pairs_per_second\n";
+    out << std::setprecision(9);
+    for (const auto& r : results) {
+        out << r.name << ',' << r.dtype << ',' << r.layout << ',' << r.threads << ',' << r.size << ','
+            << r.seconds << ',' << r.ns_per_element() << ',' << r.gb_per_second() << ',' << r.pairs_per_second() << '\n';
+    }
+}
+
+static void write_json(const std::string& path) {
+    std::ofstream out(path);
+    out << std::setprecision(9) << "[\n";
+    for (std::size_t i{}; i != results.size(); ++i) {
+        const auto& r = results[i];
+        out << "  {\"name\": \"" << r.name << "\", \"dtype\": \"" << r.dtype << "\", \"layout\": \"" << r.layout
+            << "\", \"threads\": " << r.threads << ", \"size\": " << r.size << ", \"seconds\": " << r.seconds
+            << ", \"ns_per_element\": " << r.ns_per_element() << ", \"gb_per_second\": " << r.gb_per_second()
+            << ", \"pairs_per_second\": " << r.pairs_per_second() << '}' << (i + 1 != results.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+// print the speedup of every case with respect to a previous CSV,
+// returns the number of cases more than 10% slower
+static int compare(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Cannot read " << path << '\n';
+        return 1;
+    }
+    std::map<std::string, double> baseline;
+    std::string line;
+    std::getline(in, line);
+    while (std::getline(in, line)) {
+        std::vector<std::string> f;
+        std::istringstream s(line);
+        for (std::string field; std::getline(s, field, ',');) {
+            f.push_back(field);
+        }
+        if (f.size() >= 6) {
+            baseline[f[0] + "/" + f[1] + "/" + f[2] + "/" + f[3] + "/" + f[4]] = std::stod(f[5]);
+        }
+    }
+    int slower{};
+    std::cout << "\nspeedup against " << path << '\n';
+    for (const auto& r : results) {
+        const auto it = baseline.find(r.key());
+        if (it == baseline.end()) {
+            continue;
+        }
+        const auto speedup = it->second / r.seconds;
+        std::cout << std::left << std::setw(70) << r.key() << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(8) << speedup << "x" << (speedup < 0.9 ? "  SLOWER" : "") << '\n';
+        slower += speedup < 0.9;
+    }
+    return slower;
+}
+
+int main(int argc, char** argv) {
+    bool quick{};
+    std::string csv, json, baseline;
+    for (int i{1}; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--quick") {
+            quick = true;
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            min_time = std::atof(argv[++i]);
+        } else if (arg == "--csv" && i + 1 < argc) {
+            csv = argv[++i];
+        } else if (arg == "--json" && i + 1 < argc) {
+            json = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baseline = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--quick] [--min-time S] [--csv FILE] [--json FILE] [--baseline FILE]\n";
+            return 2;
+        }
+    }
+    const std::vector<std::size_t> lengths = quick ? std::vector<std::size_t>{1 << 12} : std::vector<std::size_t>{1 << 10, 1 << 16, 1 << 22};
+    const std::vector<std::size_t> widths = quick ? std::vector<std::size_t>{64} : std::vector<std::size_t>{16, 128, 512};
+    const std::size_t rows = quick ? 1024 : 8192;
+    std::vector<unsigned> threads{1};
+    for (unsigned n{2}; n <= std::max(2u, math::parallel::default_threads()); n *= 2) {
+        threads.push_back(n);
+    }
+    for (auto n : lengths) {
+        bench_pairwise<float>(n);
+        bench_pairwise<double>(n);
+    }
+    for (auto cols : widths) {
+        bench_multicolumn<float>(rows, cols, threads);
+        bench_multicolumn<double>(rows, cols, threads);
+    }
+    bench_couple(quick ? 1000 : 10000);
+    bench_parsing<float>(quick ? 1 << 14 : 1 << 18);
+    bench_parsing<double>(quick ? 1 << 14 : 1 << 18);
+    if (!csv.empty()) {
+        write_csv(csv);
+    }
+    if (!json.empty()) {
+        write_json(json);
+    }
+    if (!baseline.empty()) {
+        return compare(baseline) ? 1 : 0;
+    }
+    return 0;
+}
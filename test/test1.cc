@@ -1,10 +1,12 @@
 #include "../modules/CPP-test-unit/tester.hh"
 #include "../correlation.hh"
+#include "../simd.hh"
 
 #include <vector>
 #include <random>
 #include <stdexcept>
 #include <string>
+#include <cmath>
 
 using namespace std::literals;
 
@@ -54,3 +56,42 @@ tester t3([](){
     }
 });
 
+
+tester t4([](){
+    // every kernel, contiguous and strided, against the plain loop
+    constexpr int N = 1003, scatter = 3;
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> distribution(-2, 9);
+    std::vector<double> v(N*scatter);
+    std::vector<float> f(N*scatter);
+    for (int i{}; i!=N*scatter; ++i) {
+        v[i] = distribution(generator);
+        f[i] = v[i];
+    }
+    math::statistics::pcc_partial<long double> expected, expected_scattered;
+    for (int i{}; i!=N; ++i) {
+        expected.accumulate(v[i], v[N + i]);
+        expected_scattered.accumulate(v[i*scatter], v[i*scatter + 1]);
+    }
+    for (auto level : {math::simd::isa::scalar, math::simd::isa::sse2, math::simd::isa::avx2, math::simd::isa::avx512}) {
+        math::simd::restrict_isa(level);
+        const double results[] = {
+            math::statistics::pearson_correlation_coefficient(v.data(), v.data() + N, N).compute(),
+            math::statistics::pearson_correlation_coefficient(f.data(), f.data() + N, N).compute(),
+        };
+        const double scattered[] = {
+            math::statistics::pearson_correlation_coefficient_scattered(v.data(), v.data() + 1, N, scatter).compute(),
+            math::statistics::pearson_correlation_coefficient_scattered(f.data(), f.data() + 1, N, scatter).compute(),
+        };
+        for (int k{}; k!=2; ++k) {
+            const double tolerance = k ? 1e-4 : 1e-12;
+            if (std::abs(results[k] - (double)expected.compute()) > tolerance) {
+                throw std::runtime_error("Expected "s + std::to_string((double)expected.compute()) + ", found "s + std::to_string(results[k]));
+            }
+            if (std::abs(scattered[k] - (double)expected_scattered.compute()) > tolerance) {
+                throw std::runtime_error("Expected "s + std::to_string((double)expected_scattered.compute()) + ", found "s + std::to_string(scattered[k]));
+            }
+        }
+    }
+    math::simd::restrict_isa(math::simd::isa::avx512);
+});
@@ -0,0 +1,80 @@
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../spearman.hh"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+
+using namespace std::literals;
+using namespace math::statistics;
+
+// ranks from 1, average for ties, with a comparison sort
+template <typename T>
+static std::vector<double> naive_ranks(const std::vector<T>& v) {
+    std::vector<std::size_t> order(v.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](auto a, auto b){ return v[a] < v[b]; });
+    std::vector<double> ans(v.size());
+    for (std::size_t begin{}; begin != v.size();) {
+        auto end = begin + 1;
+        while (end != v.size() && v[order[end]] == v[order[begin]]) {
+            ++end;
+        }
+        for (auto i = begin; i != end; ++i) {
+            ans[order[i]] = (begin + 1 + end) / 2.;
+        }
+        begin = end;
+    }
+    return ans;
+}
+
+template <typename T>
+static void check_ranks(const std::vector<T>& v) {
+    rank_scratch<T> scratch;
+    std::vector<double> found(v.size());
+    scratch.rank(v.data(), v.size(), 1, found.data(), 1);
+    if (found != naive_ranks(v)) {
+        throw std::runtime_error("Wrong ranks");
+    }
+}
+
+tester t1([](){
+    check_ranks(std::vector<double>{3.5, -1, 0, -0., 2, -7.25, 3.5, 1e300, -1e-300, 3.5});
+    check_ranks(std::vector<float>{1.f, -2.f, 1.f, 0.5f, -2.f});
+    check_ranks(std::vector<int>{5, -3, 7, -3, 0, 5, -100000, 5});
+    check_ranks(std::vector<unsigned short>{5, 3, 3, 65535, 0});
+});
+
+tester t2([](){
+    constexpr int rows = 900, cols = 10;
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(0, 5);
+    // row-major, rounded to create ties
+    std::vector<double> m(rows*cols);
+    for (int r{}; r != rows; ++r) {
+        for (int c{}; c != cols; ++c) {
+            m[r*cols + c] = std::round(distribution(generator) + (c ? std::exp(m[r*cols] / 5) : 0));
+        }
+    }
+    std::vector<std::vector<double>> columns(cols, std::vector<double>(rows));
+    for (int r{}; r != rows; ++r) {
+        for (int c{}; c != cols; ++c) {
+            columns[c][r] = m[r*cols + c];
+        }
+    }
+    const auto found = spearman_correlation_matrix(m.data(), rows, cols, cols, 1, 3);
+    for (int i{}, k{}; i != cols; ++i) {
+        for (int j{i+1}; j != cols; ++j, ++k) {
+            const auto expected = pearson_correlation_coefficient(naive_ranks(columns[i]), naive_ranks(columns[j])).compute();
+            const auto pair = spearman_correlation_coefficient(columns[i], columns[j]);
+            if (std::abs(found[k] - expected) > 1e-9 || std::abs(pair - expected) > 1e-9) {
+                throw std::runtime_error("Pair ("s + std::to_string(i) + ","s + std::to_string(j) + ") expected "s + std::to_string(expected) + ", found "s + std::to_string(found[k]));
+            }
+        }
+    }
+});
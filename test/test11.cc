@@ -0,0 +1,156 @@
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../pair_search.hh"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+using namespace std::literals;
+using namespace math::statistics;
+
+constexpr int rows = 200, cols = 300;
+
+// row-major matrix with a few strongly correlated pairs
+static std::vector<double> planted() {
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(0, 1);
+    std::vector<double> m(rows*cols);
+    for (auto& x : m) {
+        x = distribution(generator) + 10;
+    }
+    const std::vector<std::pair<int,int>> pairs{{3, 250}, {17, 18}, {100, 42}, {299, 0}, {150, 151}};
+    double sign = 1;
+    for (const auto& p : pairs) {
+        for (int r{}; r != rows; ++r) {
+            m[r*cols + p.second] = sign*3*m[r*cols + p.first] + 0.5*distribution(generator);
+        }
+        sign = -sign;
+    }
+    return m;
+}
+
+static std::vector<correlated_pair<double>> brute_force(const std::vector<double>& m, double threshold) {
+    std::vector<correlated_pair<double>> ans;
+    for (int i{}; i != cols; ++i) {
+        for (int j{i+1}; j != cols; ++j) {
+            const auto r = pearson_correlation_coefficient_scattered(m.data() + i, m.data() + j, rows, cols).compute();
+            if (std::abs(r) >= threshold) {
+                ans.push_back({i, j, r});
+            }
+        }
+    }
+    return ans;
+}
+
+static void check_same(const std::vector<correlated_pair<double>>& expected, const std::vector<correlated_pair<double>>& found) {
+    if (expected.size() != found.size()) {
+        throw std::runtime_error("Expected "s + std::to_string(expected.size()) + " pairs, found "s + std::to_string(found.size()));
+    }
+    for (std::size_t k{}; k != found.size(); ++k) {
+        if (expected[k].first != found[k].first || expected[k].second != found[k].second || std::abs(expected[k].r - found[k].r) > 1e-12) {
+            throw std::runtime_error("Pair "s + std::to_string(k) + " expected ("s + std::to_string(expected[k].first) + ","s + std::to_string(expected[k].second)
+                + "), found ("s + std::to_string(found[k].first) + ","s + std::to_string(found[k].second) + ")"s);
+        }
+    }
+}
+
+tester t1([](){
+    const auto m = planted();
+    const auto expected = brute_force(m, 0.9);
+    if (expected.size() != 5) {
+        throw std::runtime_error("Unexpected data");
+    }
+    pair_search_options options;
+    options.threads = 2;
+    options.column_block = 64;
+    if (pair_search_recall(0.9, options, cols) < 0.999) {
+        throw std::runtime_error("Recall too low for the test");
+    }
+    check_same(expected, find_correlated_pairs(m.data(), rows, cols, cols, 1, 0.9, options));
+    // same data column-major
+    std::vector<double> t(rows*cols);
+    for (int r{}; r != rows; ++r) {
+        for (int c{}; c != cols; ++c) {
+            t[c*rows + r] = m[r*cols + c];
+        }
+    }
+    check_same(expected, find_correlated_pairs(t.data(), rows, cols, 1, rows, 0.9, options));
+});
+
+tester t2([](){
+    const auto m = planted();
+    auto expected = brute_force(m, 0.9);
+    std::sort(expected.begin(), expected.end(), [](const auto& a, const auto& b){ return std::abs(a.r) > std::abs(b.r); });
+    expected.resize(3);
+    std::sort(expected.begin(), expected.end(), [](const auto& a, const auto& b){ return std::make_pair(a.first, a.second) < std::make_pair(b.first, b.second); });
+    check_same(expected, top_correlated_pairs(m.data(), rows, cols, cols, 1, 3));
+    const auto bands = pair_search_bands(0.9, 0.99, 8);
+    pair_search_options options;
+    options.bands = bands;
+    options.band_bits = 8;
+    if (pair_search_recall(0.9, options) < 0.99 || (options.bands = bands - 1, pair_search_recall(0.9, options) >= 0.99)) {
+        throw std::runtime_error("Wrong number of bands for the requested recall");
+    }
+});
+
+tester t3([](){
+    // several blocks of directions: the candidates do not depend
+    // on the split of the columns nor on the threads
+    const int long_rows = 1000, few = 40;
+    std::default_random_engine generator(3);
+    std::normal_distribution<double> distribution(0, 1);
+    std::vector<double> m(long_rows*few);
+    for (auto& x : m) {
+        x = distribution(generator);
+    }
+    for (int r{}; r != long_rows; ++r) {
+        m[r*few + 7] = -2*m[r*few + 30] + 0.3*distribution(generator);
+    }
+    std::vector<std::vector<correlated_pair<double>>> found;
+    for (std::size_t block : {1, 7, 4096}) {
+        for (unsigned threads : {1, 3}) {
+            pair_search_options options;
+            options.column_block = block;
+            options.threads = threads;
+            found.push_back(find_correlated_pairs(m.data(), long_rows, few, few, 1, 0.0, options));
+        }
+    }
+    for (const auto& f : found) {
+        check_same(found[0], f);
+    }
+    // every candidate verified once
+    const auto repeated = std::adjacent_find(found[0].begin(), found[0].end(), [](const auto& a, const auto& b){ return a.first == b.first && a.second == b.second; });
+    if (repeated != found[0].end()) {
+        throw std::runtime_error("Pair ("s + std::to_string(repeated->first) + ","s + std::to_string(repeated->second) + ") found twice");
+    }
+    const auto strong = std::count_if(found[0].begin(), found[0].end(), [](const auto& p){ return p.first == 7 && p.second == 30 && p.r < -0.9; });
+    if (strong != 1) {
+        throw std::runtime_error("Planted pair not found");
+    }
+});
+
+tester t4([](){
+    // top pairs from the per thread heaps are the strongest
+    // candidates, band_bits grow with the columns
+    const auto m = planted();
+    pair_search_options options;
+    options.threads = 3;
+    auto candidates = find_correlated_pairs(m.data(), rows, cols, cols, 1, 0.0, options);
+    std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b){ return std::abs(a.r) > std::abs(b.r); });
+    for (std::size_t k : {0, 1, 5, 40}) {
+        auto expected = std::vector<correlated_pair<double>>(candidates.begin(), candidates.begin() + k);
+        std::sort(expected.begin(), expected.end(), [](const auto& a, const auto& b){ return std::make_pair(a.first, a.second) < std::make_pair(b.first, b.second); });
+        check_same(expected, top_correlated_pairs(m.data(), rows, cols, cols, 1, k, options));
+    }
+    if (pair_search_band_bits(options, 300) != 9 || pair_search_band_bits(options, 10) != 8 || pair_search_band_bits(options, 1 << 20) != 20) {
+        throw std::runtime_error("Wrong automatic band_bits");
+    }
+    options.band_bits = 12;
+    if (pair_search_band_bits(options, 1 << 20) != 12) {
+        throw std::runtime_error("band_bits of the options not used");
+    }
+});
@@ -0,0 +1,89 @@
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../lagged.hh"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include <complex>
+
+using namespace std::literals;
+using namespace math::statistics;
+
+// coefficient of x[t] and y[t+k] through pcc_partial
+static double direct(const std::vector<double>& x, const std::vector<double>& y, long long k) {
+    pcc_partial<double> p;
+    for (long long t{}; t != (long long)x.size(); ++t) {
+        if (t + k >= 0 && t + k < (long long)y.size()) {
+            p.accumulate(x[t], y[t+k]);
+        }
+    }
+    return p.compute();
+}
+
+tester t1([](){
+    // FFT against the definition
+    constexpr std::size_t n = 16;
+    fft_plan<double> plan(n);
+    std::vector<std::complex<double>> a(n), expected(n);
+    for (std::size_t i{}; i != n; ++i) {
+        a[i] = {std::sin(i*1.3), std::cos(i*0.7) + i};
+    }
+    for (std::size_t k{}; k != n; ++k) {
+        for (std::size_t i{}; i != n; ++i) {
+            expected[k] += a[i] * std::polar(1.0, -2*std::acos(-1.0)*k*i/n);
+        }
+    }
+    auto b = a;
+    plan.transform(b.data());
+    for (std::size_t k{}; k != n; ++k) {
+        if (std::abs(b[k] - expected[k]) > 1e-9) {
+            throw std::runtime_error("Wrong FFT at "s + std::to_string(k));
+        }
+    }
+    plan.transform(b.data(), true);
+    for (std::size_t k{}; k != n; ++k) {
+        if (std::abs(b[k] - a[k]) > 1e-12) {
+            throw std::runtime_error("Wrong inverse FFT at "s + std::to_string(k));
+        }
+    }
+});
+
+tester t2([](){
+    constexpr std::size_t n = 1000, L = 40, series = 5;
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(100, 1);
+    // row-major, series i is the first one delayed by 7*i plus noise
+    std::vector<double> m(n*series);
+    std::vector<std::vector<double>> columns(series, std::vector<double>(n));
+    std::vector<double> base(n + 7*series);
+    for (auto& v : base) {
+        v = distribution(generator);
+    }
+    for (std::size_t t{}; t != n; ++t) {
+        for (std::size_t s{}; s != series; ++s) {
+            columns[s][t] = m[t*series + s] = base[t + 7*series - 7*s] + (s ? 0.3*distribution(generator) : 0);
+        }
+    }
+    lagged_correlation<double> lagged(L);
+    // odd number of pairs: the last one is transformed alone
+    const std::vector<std::pair<int,int>> pairs{{0, 1}, {0, 3}, {4, 2}};
+    std::vector<double> out(pairs.size()*lagged.lags());
+    lagged.compute_pairs(m.data(), n, series, 1, pairs, out.data());
+    for (std::size_t p{}; p != pairs.size(); ++p) {
+        for (long long k{-(long long)L}; k <= (long long)L; ++k) {
+            const auto expected = direct(columns[pairs[p].first], columns[pairs[p].second], k);
+            const auto found = out[p*lagged.lags() + k + L];
+            if (std::abs(found - expected) > 1e-9) {
+                throw std::runtime_error("Pair "s + std::to_string(p) + " lag "s + std::to_string(k) + " expected "s + std::to_string(expected) + ", found "s + std::to_string(found));
+            }
+        }
+    }
+    // the peak is at the delay
+    const auto single = lagged.compute(columns[0], columns[2]);
+    if (std::max_element(single.begin(), single.end()) - single.begin() != (long long)L + 14) {
+        throw std::runtime_error("Peak not found at lag 14");
+    }
+});
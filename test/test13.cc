@@ -0,0 +1,111 @@
+#define MATH_UTILS_INSTRUMENTATION
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../correlation.hh"
+#include "../parallel_correlation.hh"
+#include "../instrumentation.hh"
+
+#include <vector>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace std::literals;
+using namespace math::statistics;
+namespace instr = math::instrumentation;
+
+tester t1([](){
+    // counters of the pcc entry points
+    instr::reset();
+    std::vector<double> v1(1000, 1.5), v2(1000, 2.5);
+    pearson_correlation_coefficient(v1, v2);
+    pearson_correlation_coefficient(v1.data(), v2.data(), 500);
+    pearson_correlation_coefficient_scattered(v1.data(), v2.data(), 100, 10);
+    const auto s = instr::read();
+    if (s[instr::counter::pcc_elements] != 1600 || s[instr::counter::pcc_bytes] != 1600*2*sizeof(double)) {
+        throw std::runtime_error("Wrong pcc counters: "s + s.to_text());
+    }
+    if (s.count(instr::phase::pcc) != 3) {
+        throw std::runtime_error("Wrong number of pcc calls: "s + std::to_string(s.count(instr::phase::pcc)));
+    }
+});
+
+tester t2([](){
+    // rows, bytes, merges and results of the accumulators
+    instr::reset();
+    constexpr int N = 20;
+    constexpr std::size_t rows = 300;
+    std::vector<float> m(rows*N);
+    for (std::size_t i{}; i != m.size(); ++i) {
+        m[i] = float(i % 17) - float(i % 5);
+    }
+    multicolumn_pcc_accumulator<float> a(N), b(N);
+    a.accumulate(m.data(), rows, N, N, 1);
+    for (std::size_t r{}; r != 10; ++r) {
+        b.accumulate_row(m.data() + r*N);
+    }
+    a += b;
+    a.results();
+    const auto s = instr::read();
+    if (s[instr::counter::rows_ingested] != rows + 10) {
+        throw std::runtime_error("Wrong rows_ingested "s + std::to_string(s[instr::counter::rows_ingested]));
+    }
+    if (s[instr::counter::bytes_ingested] != (rows + 10)*N*sizeof(float)) {
+        throw std::runtime_error("Wrong bytes_ingested "s + std::to_string(s[instr::counter::bytes_ingested]));
+    }
+    if (s[instr::counter::merges] != 1 || s.count(instr::phase::merge) != 1) {
+        throw std::runtime_error("Wrong number of merges "s + std::to_string(s[instr::counter::merges]));
+    }
+    if (s.count(instr::phase::kernel) != 1 || s.count(instr::phase::results) != 1 || s.count(instr::phase::packed_results) != 1) {
+        throw std::runtime_error("Wrong phases: "s + s.to_text());
+    }
+    // fixed size accumulator
+    multicolumn_pcc_accumulator<float, N> f;
+    f.accumulate(m.data(), rows, N, N, 1);
+    f.packed_results();
+    const auto t = instr::read();
+    if (t[instr::counter::rows_ingested] != 2*rows + 10 || t.count(instr::phase::packed_results) != 2) {
+        throw std::runtime_error("Wrong counters of the fixed accumulator: "s + t.to_text());
+    }
+});
+
+tester t3([](){
+    // counters of terminated threads and of the split by columns
+    instr::reset();
+    constexpr std::size_t rows = 256, cols = 100;
+    std::vector<double> m(rows*cols, 1.0);
+    std::thread([&](){
+        std::vector<double> v(rows, 1.0);
+        pearson_correlation_coefficient(v, v);
+    }).join();
+    if (instr::read()[instr::counter::pcc_elements] != rows) {
+        throw std::runtime_error("Counters of a terminated thread lost");
+    }
+    multicolumn_pcc_accumulator<double> acc(cols);
+    parallel_options options;
+    options.threads = 3;
+    options.split = parallel_options::strategy::pairs;
+    parallel_accumulate(acc, m.data(), rows, cols, cols, 1, options);
+    const auto s = instr::read();
+    if (s[instr::counter::rows_ingested] != rows || s[instr::counter::bytes_ingested] != rows*cols*sizeof(double)) {
+        throw std::runtime_error("Wrong counters of parallel_accumulate: "s + s.to_text());
+    }
+});
+
+tester t4([](){
+    // dumps
+    instr::reset();
+    multicolumn_pcc_accumulator<double> a(3), b(3);
+    a += b;
+    const auto s = instr::read();
+    const auto json = s.to_json();
+    if (json.find("\"merges\": 1") == std::string::npos || json.find("\"merge\": {\"calls\": 1") == std::string::npos) {
+        throw std::runtime_error("Wrong json: "s + json);
+    }
+    if (s.to_text().find("merges 1\n") == std::string::npos) {
+        throw std::runtime_error("Wrong text: "s + s.to_text());
+    }
+    instr::reset();
+    if (instr::read()[instr::counter::merges] != 0) {
+        throw std::runtime_error("reset does not clear the counters");
+    }
+});
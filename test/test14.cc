@@ -0,0 +1,265 @@
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../correlation.hh"
+#include "../parallel_correlation.hh"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+using namespace std::literals;
+using namespace math::statistics;
+
+template <typename T>
+static std::vector<T> random_integers(std::size_t n, unsigned seed, long long lo, long long hi) {
+    std::default_random_engine generator(seed);
+    std::uniform_int_distribution<long long> distribution(lo, hi);
+    std::vector<T> ans(n);
+    for (auto& v : ans) {
+        v = T(distribution(generator));
+    }
+    return ans;
+}
+
+// sums of two series in long double, exact for the values used
+template <typename T>
+static pcc_partial<double> reference(const T* v1, const T* v2, std::size_t size, std::size_t scatter = 1) {
+    pcc_partial<double> ans;
+    for (std::size_t i{}; i != size; ++i) {
+        ans.accumulate(double(v1[i*scatter]), double(v2[i*scatter]));
+    }
+    return ans;
+}
+
+template <typename P>
+static void check_sums(const P& p, std::int64_t s1, std::int64_t s2, std::int64_t q1, std::int64_t q2, std::int64_t sp, const std::string& where) {
+    if (p.sum_1 != s1 || p.sum_2 != s2 || p.sum_1_squared != q1 || p.sum_2_squared != q2 || p.sum_prod != sp) {
+        throw std::runtime_error("Wrong integer sums "s + where);
+    }
+}
+
+tester t1([](){
+    // int16 through pmaddwd: exact sums, also for -32768
+    static_assert(std::is_same_v<pcc_partial<std::int16_t>::accumulator_type, std::int64_t>);
+    static_assert(std::is_same_v<decltype(pcc_partial<std::int16_t>{}.compute()), double>);
+    for (std::size_t n : {0, 5, 16, 31, 1000, 70000}) {
+        auto v1 = random_integers<std::int16_t>(n, 1, -32768, 32767);
+        auto v2 = random_integers<std::int16_t>(n, 2, -32768, 32767);
+        // the only pair of products overflowing int32
+        for (std::size_t i{}; i + 1 < n && i < 64; ++i) {
+            v1[i] = v2[i] = -32768;
+        }
+        std::int64_t s1{}, s2{}, q1{}, q2{}, sp{};
+        for (std::size_t i{}; i != n; ++i) {
+            s1 += v1[i];
+            s2 += v2[i];
+            q1 += std::int64_t(v1[i])*v1[i];
+            q2 += std::int64_t(v2[i])*v2[i];
+            sp += std::int64_t(v1[i])*v2[i];
+        }
+        for (auto level : {math::simd::isa::scalar, math::simd::isa::avx512}) {
+            math::simd::restrict_isa(level);
+            const auto p = pearson_correlation_coefficient(v1, v2);
+            check_sums(p, s1, s2, q1, q2, sp, "of "s + std::to_string(n) + " elements"s);
+            check_sums(pearson_correlation_coefficient(v1.data(), v2.data(), n), s1, s2, q1, q2, sp, "(pointer)");
+            const auto r = reference(v1.data(), v2.data(), n).compute();
+            if (std::abs(p.compute() - r) > 1e-9) {
+                throw std::runtime_error("Wrong coefficient "s + std::to_string(p.compute()) + " expected "s + std::to_string(r));
+            }
+        }
+        if (n >= 2) {
+            const auto p = pearson_correlation_coefficient_scattered(v1.data(), v1.data() + 1, n/2, 2);
+            pcc_partial<std::int16_t> q;
+            for (std::size_t i{}; i != n/2; ++i) {
+                q.accumulate(v1[2*i], v1[2*i+1]);
+            }
+            check_sums(p, q.sum_1, q.sum_2, q.sum_1_squared, q.sum_2_squared, q.sum_prod, "(scattered)");
+        }
+    }
+});
+
+tester t2([](){
+    // int32 accumulate in 128 bits: products of 2^31 do not overflow
+    const std::size_t n = 5000;
+    const auto v1 = random_integers<std::int32_t>(n, 3, -2147483648LL, 2147483647LL);
+    auto v2 = v1;
+    for (std::size_t i{}; i != n; ++i) {
+        v2[i] = std::int32_t(v1[i] / 2 + (long long)(i % 101) * 1000000);
+    }
+    const auto p = pearson_correlation_coefficient(v1, v2);
+    const auto r = reference(v1.data(), v2.data(), n).compute();
+    if (std::abs(p.compute() - r) > 1e-9) {
+        throw std::runtime_error("Wrong int32 coefficient "s + std::to_string(p.compute()) + " expected "s + std::to_string(r));
+    }
+    // removing all the elements leaves exactly 0
+    auto q = p;
+    for (std::size_t i{}; i != n; ++i) {
+        q.remove(v1[i], v2[i]);
+    }
+    if (q.count != 0 || q.sum_prod != 0 || q.sum_1_squared != 0) {
+        throw std::runtime_error("Sums not exact after remove");
+    }
+});
+
+tester t3([](){
+    // multicolumn: matrix (row-major and column-major) and row paths agree exactly
+    for (int N : {2, 7, 8, 19}) {
+        const std::size_t rows = 1100;
+        const auto m = random_integers<std::int16_t>(rows*N, N, -32768, 32767);
+        std::vector<std::int16_t> t(rows*N);
+        for (std::size_t r{}; r != rows; ++r) {
+            for (int c{}; c != N; ++c) {
+                t[c*rows + r] = m[r*N + c];
+            }
+        }
+        multicolumn_pcc_accumulator<std::int16_t> by_row(N), row_major(N), col_major(N);
+        multicolumn_pcc_accumulator<double> reference(N);
+        for (std::size_t r{}; r != rows; ++r) {
+            by_row.accumulate_row(m.data() + r*N);
+            std::vector<double> row(m.begin() + r*N, m.begin() + (r+1)*N);
+            reference.accumulate(row);
+        }
+        row_major.accumulate(m.data(), rows, N, N, 1);
+        col_major.accumulate(t.data(), rows, N, 1, rows);
+        for (int i{}; i != N; ++i) {
+            for (int j{i+1}; j != N; ++j) {
+                const auto a = by_row.partial(i, j);
+                check_sums(row_major.partial(i, j), a.sum_1, a.sum_2, a.sum_1_squared, a.sum_2_squared, a.sum_prod, "(row-major)");
+                check_sums(col_major.partial(i, j), a.sum_1, a.sum_2, a.sum_1_squared, a.sum_2_squared, a.sum_prod, "(column-major)");
+            }
+        }
+        const auto packed = row_major.packed_results();
+        const auto expected = reference.packed_results();
+        static_assert(std::is_same_v<decltype(packed), const correlation_matrix<double>>);
+        for (std::size_t k{}; k != packed.size(); ++k) {
+            if (std::abs(packed[k] - expected[k]) > 1e-9) {
+                throw std::runtime_error("Wrong coefficient "s + std::to_string(k) + " with N="s + std::to_string(N));
+            }
+        }
+        const auto map = col_major.results();
+        if (map.at({0, 1}) != packed[0]) {
+            throw std::runtime_error("Wrong results()");
+        }
+    }
+});
+
+tester t4([](){
+    // exact sums: same bits whatever the number of threads and the split
+    constexpr int N = 33;
+    const std::size_t rows = 3000;
+    const auto m = random_integers<std::int16_t>(rows*N, 7, -1000, 1000);
+    multicolumn_pcc_accumulator<std::int16_t> serial(N);
+    serial.accumulate(m.data(), rows, N, N, 1);
+    const auto expected = serial.packed_results();
+    for (unsigned threads : {1, 2, 3}) {
+        for (auto split : {parallel_options::strategy::rows, parallel_options::strategy::pairs}) {
+            parallel_options options;
+            options.threads = threads;
+            options.split = split;
+            options.chunk_rows = 256;
+            multicolumn_pcc_accumulator<std::int16_t> acc(N);
+            parallel_accumulate(acc, m.data(), rows, N, N, 1, options);
+            const auto packed = acc.packed_results();
+            for (std::size_t k{}; k != packed.size(); ++k) {
+                if (packed[k] != expected[k]) {
+                    throw std::runtime_error("Result depends on the threads, "s + std::to_string(threads) + " threads"s);
+                }
+            }
+        }
+    }
+});
+
+tester t5([](){
+    // fixed number of columns and other integer types
+    constexpr int N = 5;
+    const std::size_t rows = 200;
+    const auto m = random_integers<std::uint8_t>(rows*N, 11, 0, 255);
+    multicolumn_pcc_accumulator<std::uint8_t, N> fixed;
+    multicolumn_pcc_accumulator<std::uint8_t> dynamic(N);
+    fixed.accumulate(m.data(), rows, N, N, 1);
+    for (std::size_t r{}; r != rows; ++r) {
+        dynamic.accumulate_row(m.data() + r*N);
+    }
+    const auto a = fixed.packed_results();
+    const auto b = dynamic.packed_results();
+    for (std::size_t k{}; k != a.size(); ++k) {
+        if (a[k] != b[k]) {
+            throw std::runtime_error("Fixed and dynamic accumulators differ at "s + std::to_string(k));
+        }
+    }
+    multicolumn_pcc_accumulator<std::int32_t> wide(2);
+    std::int32_t row[2] = {2147483647, -2147483647 - 1};
+    wide.accumulate_row(row);
+    row[0] = -2147483647 - 1;
+    row[1] = 2147483647;
+    wide.accumulate_row(row);
+    if (std::abs(wide.packed_results()[0] + 1) > 1e-12) {
+        throw std::runtime_error("Wrong coefficient of int32 extremes "s + std::to_string(wide.packed_results()[0]));
+    }
+});
+
+tester t6([](){
+    // cross accumulator: exact sums, also for -32768
+    const int N = 3, M = 10;
+    const std::size_t rows = 700;
+    auto m = random_integers<std::int16_t>(rows*(N + M), 13, -32768, 32767);
+    for (std::size_t r{}; r != 40; ++r) {
+        m[r*(N + M)] = m[r*(N + M) + N] = -32768;
+    }
+    cross_pcc_accumulator<std::int16_t> by_row(N, M), by_matrix(N, M);
+    cross_pcc_accumulator<double> reference(N, M);
+    for (std::size_t r{}; r != rows; ++r) {
+        by_row.accumulate_row(m.data() + r*(N + M));
+        std::vector<double> row(m.begin() + r*(N + M), m.begin() + (r+1)*(N + M));
+        reference.accumulate(row);
+    }
+    by_matrix.accumulate(m.data(), rows, N + M, N + M, 1);
+    const auto packed = by_matrix.packed_results();
+    static_assert(std::is_same_v<decltype(packed), const cross_correlation_matrix<double>>);
+    const auto expected = reference.packed_results();
+    for (int i{}; i != N; ++i) {
+        for (int j{}; j != M; ++j) {
+            const auto a = by_row.partial(i, j);
+            check_sums(by_matrix.partial(i, j), a.sum_1, a.sum_2, a.sum_1_squared, a.sum_2_squared, a.sum_prod, "(cross)");
+            const auto k = std::size_t(i)*M + j;
+            if (std::abs(packed[k] - expected[k]) > 1e-9) {
+                throw std::runtime_error("Wrong cross coefficient ("s + std::to_string(i) + ","s + std::to_string(j) + ")");
+            }
+        }
+    }
+});
+
+tester t7([](){
+    // 64 bit integers accumulate in T and still compile
+    pcc_partial<long long> p;
+    multicolumn_pcc_accumulator<std::int64_t> acc(2);
+    for (long long i{}; i != 100; ++i) {
+        p.accumulate(i, 3*i + (i % 5));
+        const std::int64_t row[2] = {i, 3*i + (i % 5)};
+        acc.accumulate_row(row);
+    }
+    static_assert(std::is_same_v<pcc_partial<long long>::accumulator_type, long long>);
+    if (std::abs(p.compute() - acc.packed_results()[0]) > 1e-12 || p.compute() < 0.99) {
+        throw std::runtime_error("Wrong int64 coefficient "s + std::to_string(p.compute()));
+    }
+    // beyond 2^32 rows the centered sums of int32 do not fit in
+    // 128 bits and are computed in long double
+    pcc_partial<std::int32_t> big;
+    big.count = 1LL << 34;
+    big.sum_1_squared = big.sum_2_squared = pcc_partial<std::int32_t>::accumulator_type(big.count) << 61;
+    big.sum_prod = big.sum_1_squared / 2;
+    big.sum_1 = big.sum_2 = 0;
+    if (std::abs(big.compute() - 0.5) > 1e-12) {
+        throw std::runtime_error("Wrong coefficient beyond 2^32 rows "s + std::to_string(big.compute()));
+    }
+#ifdef __SIZEOF_INT128__
+    // exact while the accumulators of 16 bit series do not overflow
+    static_assert(detail::exact_rows<std::int16_t>() == (1LL << 33));
+    static_assert(detail::exact_rows<std::uint16_t>() == (1LL << 31));
+    static_assert(detail::exact_rows<std::int32_t>() == (1LL << 32));
+    static_assert(detail::exact_rows<std::int64_t>() == 0);
+#endif
+});
@@ -0,0 +1,219 @@
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../pipeline.hh"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+
+using namespace std::literals;
+using namespace math::statistics;
+
+// csv text of rows x cols values, with its matrix
+template <typename T>
+static std::string make_csv(std::size_t rows, std::size_t cols, std::vector<T>& matrix, unsigned seed) {
+    std::default_random_engine generator(seed);
+    std::uniform_int_distribution<int> distribution(-500, 500);
+    std::ostringstream out;
+    matrix.resize(rows*cols);
+    for (std::size_t r{}; r != rows; ++r) {
+        for (std::size_t c{}; c != cols; ++c) {
+            const T v = std::is_integral_v<T> ? T(distribution(generator)) : T(distribution(generator)) / 8;
+            matrix[r*cols + c] = v;
+            out << v << (c + 1 != cols ? "," : "\n");
+        }
+    }
+    return out.str();
+}
+
+// source returning the text in pieces of random size
+static auto pieces(const std::string& text, unsigned seed) {
+    return [&text, pos = std::size_t{}, generator = std::default_random_engine(seed)](char* buffer, std::size_t size) mutable {
+        const auto n = std::min({size, text.size() - pos, std::size_t(generator() % 100 + 1)});
+        std::copy(text.begin() + pos, text.begin() + pos + n, buffer);
+        pos += n;
+        return n;
+    };
+}
+
+tester t1([](){
+    // several workers, chunks much smaller than the text
+    const std::size_t rows = 2000, cols = 6;
+    std::vector<double> m;
+    const auto text = "a,b,c,d,e,f\n"s + make_csv(rows, cols, m, 1);
+    multicolumn_pcc_accumulator<double> expected(cols);
+    expected.accumulate(m.data(), rows, cols, cols, 1);
+    const auto e = expected.packed_results();
+    for (unsigned workers : {1, 3}) {
+        pipeline_options options;
+        options.header_lines = 1;
+        options.parsers = workers;
+        options.accumulators = workers;
+        options.chunk_bytes = 256;
+        options.buffers = 3;
+        ingestion_pipeline<double> pipeline(options);
+        const auto acc = pipeline.run(pieces(text, workers));
+        if (acc.rows() != (long long)rows || acc.columns() != (int)cols) {
+            throw std::runtime_error("Wrong number of rows "s + std::to_string(acc.rows()));
+        }
+        const auto r = acc.packed_results();
+        for (std::size_t k{}; k != r.size(); ++k) {
+            if (std::abs(r[k] - e[k]) > 1e-12) {
+                throw std::runtime_error("Wrong coefficient "s + std::to_string(k));
+            }
+        }
+        const auto& s = pipeline.stats();
+        if (s.read.bytes != text.size() || s.parse.rows != rows || s.accumulate.rows != rows) {
+            throw std::runtime_error("Wrong stats");
+        }
+        if (s.parse.chunks != s.read.chunks || s.accumulate.chunks != s.parse.chunks || s.read.chunks < 10) {
+            throw std::runtime_error("Wrong number of chunks "s + std::to_string(s.read.chunks));
+        }
+    }
+});
+
+tester t2([](){
+    // file source, exact integers: same sums as the serial accumulator
+    const std::size_t rows = 5000, cols = 9;
+    std::vector<std::int16_t> m;
+    const auto text = make_csv(rows, cols, m, 2);
+    const auto path = "test15_tmp.csv"s;
+    std::ofstream(path) << text;
+    multicolumn_pcc_accumulator<std::int16_t> expected(cols);
+    expected.accumulate(m.data(), rows, cols, cols, 1);
+    pipeline_options options;
+    options.parsers = 2;
+    options.accumulators = 2;
+    options.chunk_bytes = 4096;
+    ingestion_pipeline<std::int16_t> pipeline(options);
+    const auto acc = pipeline.run_file(path);
+    std::remove(path.c_str());
+    if (acc.packed_results()[7] != expected.packed_results()[7] || acc.partial(2, 5).sum_prod != expected.partial(2, 5).sum_prod) {
+        throw std::runtime_error("Pipeline and serial sums differ");
+    }
+    bool thrown{};
+    try {
+        pipeline.run_file("does_not_exist.csv");
+    } catch (const std::system_error&) {
+        thrown = true;
+    }
+    if (!thrown) {
+        throw std::runtime_error("Missing file not reported");
+    }
+});
+
+tester t3([](){
+    // blank lines, CRLF, no final newline, lines longer than a chunk
+    std::string text = "\n1.5,2,3\r\n\n2,4.5,6\r\n";
+    std::vector<double> expected{1.5,2,3, 2,4.5,6};
+    for (int i{}; i != 50; ++i) {
+        const auto a = std::to_string(i) + ".000000000000000000000000000000000001";
+        text += a + "," + std::to_string(i*i) + "," + std::to_string(100 - i) + "\n";
+        expected.insert(expected.end(), {double(i), double(i*i), double(100 - i)});
+    }
+    text += "7,8,10";
+    expected.insert(expected.end(), {7, 8, 10});
+    pipeline_options options;
+    options.chunk_bytes = 16;
+    options.parsers = 2;
+    ingestion_pipeline<double> pipeline(options);
+    const auto acc = pipeline.run(pieces(text, 3));
+    multicolumn_pcc_accumulator<double> reference(3);
+    reference.accumulate(expected.data(), expected.size()/3, 3, 3, 1);
+    if (acc.rows() != reference.rows() || std::abs(acc.packed_results()[1] - reference.packed_results()[1]) > 1e-12) {
+        throw std::runtime_error("Wrong result with irregular lines, rows="s + std::to_string(acc.rows()));
+    }
+});
+
+tester t4([](){
+    // a parse error stops all the stages and reports its line
+    const std::size_t rows = 3000, cols = 4;
+    std::vector<double> m;
+    auto text = "x,y,z,w\n"s + make_csv(rows, cols, m, 4);
+    // line 2001 (from 0, header included)
+    std::size_t pos{};
+    for (int l{}; l != 2001; ++l) {
+        pos = text.find('\n', pos) + 1;
+    }
+    text.insert(text.find(',', pos) + 1, "oops");
+    pipeline_options options;
+    options.header_lines = 1;
+    options.parsers = 3;
+    options.accumulators = 2;
+    options.chunk_bytes = 512;
+    ingestion_pipeline<double> pipeline(options);
+    std::string message;
+    try {
+        pipeline.run(pieces(text, 5));
+    } catch (const std::runtime_error& e) {
+        message = e.what();
+    }
+    if (message != "Invalid value at line 2001, column 1") {
+        throw std::runtime_error("Wrong error: '"s + message + "'");
+    }
+});
+
+tester t5([](){
+    // bounded queue shared by several producers and consumers
+    math::parallel::bounded_queue<int> queue(8);
+    constexpr int per_producer = 20000;
+    std::atomic<long long> total{};
+    std::atomic<int> producers{3};
+    std::vector<std::thread> threads;
+    for (int p{}; p != 3; ++p) {
+        threads.emplace_back([&, p](){
+            for (int i{}; i != per_producer; ++i) {
+                queue.push(p*per_producer + i);
+            }
+            if (--producers == 0) {
+                queue.close();
+            }
+        });
+    }
+    for (int c{}; c != 2; ++c) {
+        threads.emplace_back([&](){
+            int v;
+            while (queue.pop(v)) {
+                total += v;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    const long long n = 3*per_producer;
+    if (total != n*(n-1)/2) {
+        throw std::runtime_error("Elements lost or duplicated by the queue");
+    }
+});
+
+tester t6([](){
+    // push fails after close(), also on a full queue, pop drains
+    math::parallel::bounded_queue<int> queue(2);
+    if (!queue.push(1) || !queue.push(2)) {
+        throw std::runtime_error("Push failed on an open queue");
+    }
+    bool pushed{true};
+    // waits for space until close()
+    std::thread producer([&](){ pushed = queue.push(3); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    queue.close();
+    producer.join();
+    if (pushed) {
+        throw std::runtime_error("Push succeeded on a closed queue");
+    }
+    int v{}, total{};
+    while (queue.pop(v)) {
+        total += v;
+    }
+    if (total != 3 || queue.push(4)) {
+        throw std::runtime_error("Wrong content after close()");
+    }
+});
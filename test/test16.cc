@@ -0,0 +1,180 @@
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../stable_correlation.hh"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+
+using namespace std::literals;
+using namespace math::statistics;
+
+// correlated series far from 0: mean `offset`, unit variance
+template <typename T>
+static void make_series(std::size_t n, T offset, unsigned seed, std::vector<T>& v1, std::vector<T>& v2) {
+    std::default_random_engine generator(seed);
+    std::normal_distribution<double> distribution;
+    v1.resize(n);
+    v2.resize(n);
+    for (std::size_t i{}; i != n; ++i) {
+        const auto a = distribution(generator);
+        const auto b = distribution(generator);
+        v1[i] = T(offset + a);
+        v2[i] = T(offset + 0.6*a + 0.8*b);
+    }
+}
+
+// two-pass coefficient in long double
+template <typename T>
+static long double reference(const T* v1, const T* v2, std::size_t n, std::size_t scatter = 1) {
+    long double m1{}, m2{};
+    for (std::size_t i{}; i != n; ++i) {
+        m1 += v1[i*scatter];
+        m2 += v2[i*scatter];
+    }
+    m1 /= n;
+    m2 /= n;
+    long double c11{}, c22{}, c12{};
+    for (std::size_t i{}; i != n; ++i) {
+        const auto d1 = v1[i*scatter] - m1;
+        const auto d2 = v2[i*scatter] - m2;
+        c11 += d1*d1;
+        c22 += d2*d2;
+        c12 += d1*d2;
+    }
+    return c12 / std::sqrt(c11*c22);
+}
+
+tester t1([](){
+    // float with a mean 10^4 times the standard deviation: the
+    // raw sums lose everything, the stable ones do not
+    const std::size_t n = 100000;
+    std::vector<float> v1, v2;
+    make_series(n, 1e4f, 1, v1, v2);
+    const auto r = reference(v1.data(), v2.data(), n);
+    stable_pcc<float> one, batch;
+    for (std::size_t i{}; i != n; ++i) {
+        one.accumulate(v1[i], v2[i]);
+    }
+    batch.accumulate(v1, v2);
+    // element by element the co-moments are float sums of n terms
+    if (std::abs(one.compute() - r) > 1e-4 || std::abs(batch.compute() - r) > 1e-6 || batch.rows() != (long long)n) {
+        throw std::runtime_error("Wrong stable coefficient "s + std::to_string(batch.compute()) + " expected "s + std::to_string((double)r));
+    }
+    if (std::abs(batch.mean(0) - 1e4f) > 0.1f) {
+        throw std::runtime_error("Wrong mean "s + std::to_string(batch.mean(0)));
+    }
+    const auto naive = pearson_correlation_coefficient(v1, v2).compute();
+    if (std::abs(naive - r) < 1e-2) {
+        throw std::runtime_error("The raw sums should not be accurate here");
+    }
+});
+
+tester t2([](){
+    // merging any split gives the result of the whole, also
+    // with scattered data and empty parts
+    const std::size_t n = 5000;
+    std::vector<double> v1, v2;
+    make_series(n, 1e8, 2, v1, v2);
+    const auto r = reference(v1.data(), v2.data(), n);
+    for (std::size_t split : {0, 1, 1023, 1024, 2500, 5000}) {
+        stable_pcc<double> a, b;
+        a.accumulate(v1.data(), v2.data(), split);
+        b.accumulate(v1.data() + split, v2.data() + split, n - split);
+        const auto c = a + b;
+        if (c.rows() != (long long)n || std::abs(c.compute() - r) > 1e-9) {
+            throw std::runtime_error("Wrong merge at "s + std::to_string(split));
+        }
+    }
+    std::vector<double> interleaved(2*n);
+    for (std::size_t i{}; i != n; ++i) {
+        interleaved[2*i] = v1[i];
+        interleaved[2*i+1] = v2[i];
+    }
+    stable_pcc<double> s;
+    s.accumulate(interleaved.data(), interleaved.data() + 1, n, 2);
+    if (std::abs(s.compute() - r) > 1e-9) {
+        throw std::runtime_error("Wrong scattered coefficient");
+    }
+    if (stable_pcc<float>().compute() != 0) {
+        throw std::runtime_error("Empty accumulator must give 0");
+    }
+});
+
+tester t3([](){
+    // multicolumn: row, row-major and column-major paths in float
+    // against the long double reference
+    for (int N : {2, 7, 8, 19}) {
+        const std::size_t rows = 3000;
+        std::default_random_engine generator(N);
+        std::normal_distribution<double> distribution;
+        std::vector<float> m(rows*N), t(rows*N);
+        for (std::size_t r{}; r != rows; ++r) {
+            const auto common = distribution(generator);
+            for (int c{}; c != N; ++c) {
+                m[r*N + c] = float(1e4*(c+1) + common + distribution(generator));
+                t[c*rows + r] = m[r*N + c];
+            }
+        }
+        stable_multicolumn_pcc<float> by_row(N), row_major(N), col_major(N);
+        for (std::size_t r{}; r != rows; ++r) {
+            by_row.accumulate_row(m.data() + r*N);
+        }
+        row_major.accumulate(m.data(), rows, N, N, 1);
+        col_major.accumulate(t.data(), rows, N, 1, rows);
+        for (const auto& acc : {by_row, row_major, col_major}) {
+            const auto packed = acc.packed_results();
+            std::size_t k{};
+            for (int i{}; i != N; ++i) {
+                for (int j{i+1}; j != N; ++j, ++k) {
+                    const auto r = reference(t.data() + i*rows, t.data() + j*rows, rows);
+                    if (acc.rows() != (long long)rows || std::abs(packed[k] - r) > 1e-5) {
+                        throw std::runtime_error("Wrong coefficient ("s + std::to_string(i) + ","s + std::to_string(j) + ") with N="s + std::to_string(N));
+                    }
+                }
+            }
+        }
+        if (row_major.results().at({0, N-1}) != row_major.packed_results()[N-2]) {
+            throw std::runtime_error("Wrong results()");
+        }
+    }
+});
+
+tester t4([](){
+    // merge of accumulators fed with different paths
+    constexpr int N = 5;
+    const std::size_t rows = 1000;
+    std::default_random_engine generator(4);
+    std::normal_distribution<double> distribution(1e6, 2);
+    std::vector<double> m(rows*N);
+    for (auto& v : m) {
+        v = distribution(generator);
+    }
+    stable_multicolumn_pcc<double> whole(N), a(N), b(N);
+    whole.accumulate(m.data(), rows, N, N, 1);
+    a.accumulate(m.data(), 300, N, N, 1);
+    for (std::size_t r{300}; r != rows; ++r) {
+        b.accumulate(std::vector<double>(m.begin() + r*N, m.begin() + (r+1)*N));
+    }
+    const auto c = a + b;
+    for (int i{}; i != N; ++i) {
+        if (std::abs(c.mean(i) - whole.mean(i)) > 1e-8) {
+            throw std::runtime_error("Wrong mean of column "s + std::to_string(i));
+        }
+        for (int j{i+1}; j != N; ++j) {
+            if (std::abs(c.covariance(i, j) - whole.covariance(i, j)) > 1e-9) {
+                throw std::runtime_error("Wrong covariance ("s + std::to_string(i) + ","s + std::to_string(j) + ")");
+            }
+        }
+    }
+    bool thrown{};
+    try {
+        whole += stable_multicolumn_pcc<double>(N+1);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    if (!thrown) {
+        throw std::runtime_error("Size mismatch not reported");
+    }
+});
@@ -0,0 +1,199 @@
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../correlation.hh"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+using namespace std::literals;
+using namespace math::statistics;
+
+template <typename T>
+static std::vector<T> random_matrix(std::size_t n, unsigned seed) {
+    std::default_random_engine generator(seed);
+    std::uniform_int_distribution<int> distribution(-1000, 1000);
+    std::vector<T> ans(n);
+    for (auto& v : ans) {
+        v = T(distribution(generator));
+    }
+    return ans;
+}
+
+// the given columns of a row-major matrix of width columns
+template <typename T>
+static std::vector<T> select(const std::vector<T>& m, std::size_t rows, std::size_t width, const std::vector<int>& columns) {
+    std::vector<T> ans;
+    for (std::size_t r{}; r != rows; ++r) {
+        for (auto c : columns) {
+            ans.push_back(m[r*width + c]);
+        }
+    }
+    return ans;
+}
+
+template <typename A>
+static void check_same(const A& a, const A& b, double tolerance, const std::string& where) {
+    if (a.columns() != b.columns() || a.rows() != b.rows()) {
+        throw std::runtime_error("Wrong shape "s + where);
+    }
+    const auto pa = a.packed_results();
+    const auto pb = b.packed_results();
+    for (std::size_t k{}; k != pa.size(); ++k) {
+        if (!(std::abs(pa[k] - pb[k]) <= tolerance)) {
+            throw std::runtime_error("Wrong coefficient "s + std::to_string(k) + " "s + where);
+        }
+    }
+}
+
+tester t1([](){
+    // adding columns gives the accumulator of all the columns
+    const std::size_t rows = 1500, cols = 13;
+    const auto m = random_matrix<double>(rows*cols, 1);
+    std::vector<double> t(rows*cols);
+    for (std::size_t r{}; r != rows; ++r) {
+        for (std::size_t c{}; c != cols; ++c) {
+            t[c*rows + r] = m[r*cols + c];
+        }
+    }
+    multicolumn_pcc_accumulator<double> full(cols);
+    full.accumulate(m.data(), rows, cols, cols, 1);
+    for (int N : {2, 5, 9, 12}) {
+        multicolumn_pcc_accumulator<double> row_major(N), col_major(N), split(N);
+        row_major.accumulate(m.data(), rows, N, cols, 1);
+        col_major.accumulate(t.data(), rows, N, 1, rows);
+        split.accumulate(m.data(), rows, N, cols, 1);
+        row_major.add_columns(m.data(), rows, cols, cols, 1);
+        col_major.add_columns(t.data(), rows, cols, 1, rows);
+        // new columns in a separate column-major source
+        split.add_columns(m.data(), cols, 1, t.data() + N*rows, cols - N, 1, rows, rows);
+        check_same(row_major, full, 1e-12, "(row-major) N="s + std::to_string(N));
+        check_same(col_major, full, 1e-12, "(column-major) N="s + std::to_string(N));
+        check_same(split, full, 1e-12, "(two sources) N="s + std::to_string(N));
+    }
+});
+
+tester t2([](){
+    // integers stay exact through add and remove
+    const std::size_t rows = 5000, cols = 10;
+    const auto m = random_matrix<std::int16_t>(rows*cols, 2);
+    multicolumn_pcc_accumulator<std::int16_t> acc(4), full(cols);
+    acc.accumulate(m.data(), rows, 4, cols, 1);
+    acc.add_columns(m.data(), rows, cols, cols, 1);
+    full.accumulate(m.data(), rows, cols, cols, 1);
+    for (int i{}; i != (int)cols; ++i) {
+        for (int j{i+1}; j != (int)cols; ++j) {
+            const auto a = acc.partial(i, j), b = full.partial(i, j);
+            if (a.sum_1 != b.sum_1 || a.sum_2_squared != b.sum_2_squared || a.sum_prod != b.sum_prod) {
+                throw std::runtime_error("Sums differ at ("s + std::to_string(i) + ","s + std::to_string(j) + ")");
+            }
+        }
+    }
+    const std::vector<int> kept{1, 2, 6, 9};
+    acc.remove_columns({0, 3, 4, 5, 7, 8});
+    const auto sub = select(m, rows, cols, kept);
+    multicolumn_pcc_accumulator<std::int16_t> expected(kept.size());
+    expected.accumulate(sub.data(), rows, kept.size(), kept.size(), 1);
+    check_same(acc, expected, 0, "after remove");
+    if (acc.partial(0, 3).sum_prod != full.partial(1, 9).sum_prod) {
+        throw std::runtime_error("Pair (1,9) not moved to (0,3)");
+    }
+});
+
+tester t3([](){
+    // feature selection loop: drop a column, add it back at the end,
+    // keep accumulating rows
+    const std::size_t rows = 800, cols = 6;
+    const auto m = random_matrix<double>(2*rows*cols, 3);
+    multicolumn_pcc_accumulator<double> acc(cols);
+    acc.accumulate(m.data(), rows, cols, cols, 1);
+    acc.remove_columns({2});
+    // history in the new order: 0 1 3 4 5 then 2
+    const auto history = select(m, rows, cols, {0, 1, 3, 4, 5, 2});
+    acc.add_columns(history.data(), rows, cols, cols, 1);
+    const auto rest = select(std::vector<double>(m.begin() + rows*cols, m.end()), rows, cols, {0, 1, 3, 4, 5, 2});
+    acc.accumulate(rest.data(), rows, cols, cols, 1);
+    multicolumn_pcc_accumulator<double> expected(cols);
+    const auto all = select(m, 2*rows, cols, {0, 1, 3, 4, 5, 2});
+    expected.accumulate(all.data(), 2*rows, cols, cols, 1);
+    check_same(acc, expected, 1e-12, "after the loop");
+    if (std::abs(acc.results().at({1, 5}) - expected.results().at({1, 5})) > 1e-12) {
+        throw std::runtime_error("Wrong results()");
+    }
+});
+
+tester t4([](){
+    // invalid requests leave the accumulator untouched
+    const std::size_t rows = 100, cols = 4;
+    const auto m = random_matrix<float>(rows*cols, 4);
+    multicolumn_pcc_accumulator<float> acc(3);
+    acc.accumulate(m.data(), rows, 3, cols, 1);
+    const auto before = acc.packed_results();
+    int errors{};
+    try { acc.remove_columns({0, 1}); } catch (const std::invalid_argument&) { ++errors; }
+    try { acc.remove_columns({3}); } catch (const std::out_of_range&) { ++errors; }
+    try { acc.add_columns(m.data(), rows - 1, cols, cols, 1); } catch (const std::runtime_error&) { ++errors; }
+    try { acc.add_columns(m.data(), rows, 2, cols, 1); } catch (const std::runtime_error&) { ++errors; }
+    // more than INT_MAX columns, rejected before reading them
+    try { acc.add_columns(m.data(), cols, 1, m.data(), std::numeric_limits<int>::max() - 2, cols, 1, rows); } catch (const std::invalid_argument&) { ++errors; }
+    if (errors != 5 || acc.columns() != 3 || acc.packed_results()[2] != before[2]) {
+        throw std::runtime_error("Invalid requests not reported, "s + std::to_string(errors) + " errors"s);
+    }
+    // no new columns
+    acc.add_columns(m.data(), rows, 3, cols, 1);
+    if (acc.columns() != 3) {
+        throw std::runtime_error("Columns added from nothing");
+    }
+});
+
+tester t5([](){
+    // a batcher follows the columns of its accumulator between
+    // flushes, rows buffered across a change are dropped and reported
+    const std::size_t rows = 300, cols = 7;
+    const auto m = random_matrix<double>(rows*cols, 5);
+    multicolumn_pcc_accumulator<double> acc(2), expected(cols);
+    expected.accumulate(m.data(), rows, cols, cols, 1);
+    {
+        batched_pcc_accumulator<double> batch(acc, 16);
+        for (std::size_t r{}; r != 100; ++r) {
+            batch.accumulate(m.data() + r*cols, 2);
+        }
+        batch.flush();
+        acc.add_columns(m.data(), 100, cols, cols, 1);
+        for (std::size_t r{100}; r != rows; ++r) {
+            batch.accumulate(m.data() + r*cols, cols);
+        }
+        batch.flush();
+        check_same(acc, expected, 1e-12, "(batched)");
+        // rows pending while the columns change
+        for (std::size_t r{}; r != 5; ++r) {
+            batch.accumulate(m.data() + r*cols, cols);
+        }
+        acc.remove_columns({0, 1, 2, 3});
+        bool thrown{};
+        try {
+            batch.flush();
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        if (!thrown || batch.pending() != 0 || acc.rows() != (long long)rows) {
+            throw std::runtime_error("Rows of the old columns not reported");
+        }
+        // usable again with the new columns, the row is left
+        // pending for the destructor
+        batch.accumulate(m.data(), 3);
+    }
+    if (acc.rows() != (long long)rows + 1 || acc.columns() != 3) {
+        throw std::runtime_error("Wrong accumulator after the batcher");
+    }
+    int errors{};
+    for (int N : {-1, 0, 1}) {
+        try { multicolumn_pcc_accumulator<double> wrong(N); } catch (const std::invalid_argument&) { ++errors; }
+    }
+    if (errors != 3) {
+        throw std::runtime_error("Fewer than 2 columns accepted");
+    }
+});
@@ -0,0 +1,234 @@
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../correlation.hh"
+#include "../simd.hh"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+
+using namespace std::literals;
+
+// reference: one independent pcc_partial per pair of columns
+template <typename T>
+static std::vector<T> reference(const std::vector<T>& m, int rows, int cols) {
+    std::vector<T> ans;
+    for (int c1{}; c1 != cols; ++c1) {
+        for (int c2{c1+1}; c2 != cols; ++c2) {
+            math::statistics::pcc_partial<T> p;
+            for (int r{}; r != rows; ++r) {
+                p.accumulate(m[r*cols + c1], m[r*cols + c2]);
+            }
+            ans.push_back(p.compute());
+        }
+    }
+    return ans;
+}
+
+template <typename T>
+static void check_matrix(int rows, int cols, T tolerance) {
+    std::default_random_engine generator;
+    std::uniform_real_distribution<T> distribution(-5, 12);
+    // row major
+    std::vector<T> m(rows*cols);
+    for (auto& x : m) {
+        x = distribution(generator);
+    }
+    // column major copy
+    std::vector<T> t(rows*cols);
+    for (int r{}; r != rows; ++r) {
+        for (int c{}; c != cols; ++c) {
+            t[c*rows + r] = m[r*cols + c];
+        }
+    }
+    const auto expected = reference(m, rows, cols);
+    for (auto level : {math::simd::isa::scalar, math::simd::isa::avx2, math::simd::isa::avx512}) {
+        math::simd::restrict_isa(level);
+        math::statistics::multicolumn_pcc_accumulator<T> by_rows(cols), by_cols(cols);
+        by_rows.accumulate(m.data(), rows, cols, cols, 1);
+        by_cols.accumulate(t.data(), rows, cols, 1, rows);
+        for (const auto& acc : {by_rows, by_cols}) {
+            auto res = acc.results();
+            std::size_t k{};
+            for (const auto& [pair, value] : res) {
+                if (std::abs(value - expected[k]) > tolerance) {
+                    throw std::runtime_error("Pair ("s + std::to_string(pair.first) + ","s + std::to_string(pair.second) + ") expected "s + std::to_string(expected[k]) + ", found "s + std::to_string(value));
+                }
+                ++k;
+            }
+        }
+    }
+    math::simd::restrict_isa(math::simd::isa::avx512);
+}
+
+tester t1([](){
+    check_matrix<double>(1000, 37, 1e-9);
+});
+
+tester t2([](){
+    check_matrix<float>(300, 21, 1e-3f);
+});
+
+tester t3([](){
+    // a single row and exactly one group
+    check_matrix<double>(1, 8, 1e-12);
+    check_matrix<double>(531, 2, 1e-9);
+});
+
+tester t4([](){
+    // packed results match pcc_partial::compute() exactly
+    constexpr int rows = 200, cols = 29;
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> distribution(-1, 3);
+    std::vector<double> m(rows*cols);
+    for (auto& x : m) {
+        x = distribution(generator);
+    }
+    // a constant column has no correlation
+    for (int r{}; r != rows; ++r) {
+        m[r*cols + 5] = 1.5;
+    }
+    math::statistics::multicolumn_pcc_accumulator<double> acc(cols);
+    acc.accumulate(m.data(), rows, cols, cols, 1);
+    const auto partials = acc.to_pcc_partial_valarray();
+    for (auto level : {math::simd::isa::scalar, math::simd::isa::avx2, math::simd::isa::avx512}) {
+        math::simd::restrict_isa(level);
+        const auto packed = acc.packed_results();
+        if (packed.size() != partials.size()) {
+            throw std::runtime_error("Expected "s + std::to_string(partials.size()) + " pairs, found "s + std::to_string(packed.size()));
+        }
+        for (std::size_t k{}; k != packed.size(); ++k) {
+            if (packed[k] != partials[k].compute()) {
+                throw std::runtime_error("Pair "s + std::to_string(k) + " expected "s + std::to_string(partials[k].compute()) + ", found "s + std::to_string(packed[k]));
+            }
+        }
+        if (packed(7, 3) != packed.at(3, 7) || packed(5, 9) != 0) {
+            throw std::runtime_error("Wrong indexing of the packed triangle");
+        }
+    }
+    math::simd::restrict_isa(math::simd::isa::avx512);
+});
+
+tester t5([](){
+    constexpr int rows = 1000, cols = 11;
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(5, 2);
+    std::vector<double> m(rows*cols);
+    for (auto& x : m) {
+        x = distribution(generator);
+    }
+    const auto expected = reference(m, rows, cols);
+    math::statistics::multicolumn_pcc_accumulator<double> acc(cols);
+    {
+        math::statistics::batched_pcc_accumulator<double> batch(acc, 64);
+        for (int r{}; r != rows; ++r) {
+            batch.accumulate(m.data() + r*cols, cols);
+        }
+        if (batch.pending() != rows % 64 || acc.rows() != rows / 64 * 64) {
+            throw std::runtime_error("Unexpected number of buffered rows");
+        }
+    }
+    if (acc.rows() != rows) {
+        throw std::runtime_error("Rows not flushed on destruction");
+    }
+    const auto packed = acc.packed_results();
+    for (std::size_t k{}; k != packed.size(); ++k) {
+        if (std::abs(packed[k] - expected[k]) > 1e-9) {
+            throw std::runtime_error("Pair "s + std::to_string(k) + " expected "s + std::to_string(expected[k]) + ", found "s + std::to_string(packed[k]));
+        }
+    }
+});
+
+tester t6([](){
+    constexpr int rows = 777, N = 19, M = 5, cols = N + M;
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(-3, 2);
+    std::vector<double> m(rows*cols);
+    for (auto& x : m) {
+        x = distribution(generator);
+    }
+    // y columns depend on the x ones
+    for (int r{}; r != rows; ++r) {
+        for (int j{}; j != M; ++j) {
+            m[r*cols + N + j] += 0.3*j*m[r*cols + j];
+        }
+    }
+    math::statistics::cross_pcc_accumulator<double> by_rows(N, M), by_matrix(N, M), column_major(N, M);
+    for (int r{}; r != rows; ++r) {
+        by_rows.accumulate(m.data() + r*cols, cols);
+    }
+    by_matrix.accumulate(m.data(), 300, cols, cols, 1);
+    by_matrix += math::statistics::cross_pcc_accumulator<double>(N, M).accumulate(m.data() + 300*cols, rows - 300, cols, cols, 1);
+    std::vector<double> t(rows*cols);
+    for (int r{}; r != rows; ++r) {
+        for (int c{}; c != cols; ++c) {
+            t[c*rows + r] = m[r*cols + c];
+        }
+    }
+    column_major.accumulate(t.data(), 1, rows, t.data() + N*rows, 1, rows, rows);
+    for (const auto* acc : {&by_rows, &by_matrix, &column_major}) {
+        const auto packed = acc->packed_results();
+        for (int i{}; i != N; ++i) {
+            for (int j{}; j != M; ++j) {
+                math::statistics::pcc_partial<double> p;
+                for (int r{}; r != rows; ++r) {
+                    p.accumulate(m[r*cols + i], m[r*cols + N + j]);
+                }
+                if (std::abs(packed(i, j) - p.compute()) > 1e-9 || std::abs(acc->partial(i, j).compute() - p.compute()) > 1e-9) {
+                    throw std::runtime_error("Pair ("s + std::to_string(i) + ","s + std::to_string(j) + ") expected "s + std::to_string(p.compute()) + ", found "s + std::to_string(packed(i, j)));
+                }
+            }
+        }
+    }
+});
+
+tester t7([](){
+    constexpr int rows = 500, cols = 13;
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(2, 3);
+    std::vector<double> m(rows*cols);
+    for (auto& x : m) {
+        x = distribution(generator);
+    }
+    math::statistics::multicolumn_pcc_accumulator<double, cols> fixed, blocked;
+    math::statistics::multicolumn_pcc_accumulator<double> dynamic(cols);
+    for (int r{}; r != rows; ++r) {
+        fixed.accumulate_row(m.data() + r*cols);
+        dynamic.accumulate_row(m.data() + r*cols);
+    }
+    blocked.accumulate(m.data(), rows, cols, cols, 1);
+    const auto expected = dynamic.packed_results();
+    const auto packed = fixed.packed_results();
+    const auto from_blocked = blocked.packed_results();
+    static_assert(decltype(fixed)::pair_table[decltype(fixed)::index(3, 7)] == std::pair<int,int>(3, 7));
+    for (std::size_t k{}; k != expected.size(); ++k) {
+        if (packed[k] != expected[k] || std::abs(from_blocked[k] - expected[k]) > 1e-9) {
+            throw std::runtime_error("Pair "s + std::to_string(k) + " expected "s + std::to_string(expected[k]) + ", found "s + std::to_string(packed[k]));
+        }
+    }
+    // conversions and mixed sums
+    math::statistics::multicolumn_pcc_accumulator<double> converted = fixed;
+    converted += fixed;
+    math::statistics::multicolumn_pcc_accumulator<double, cols> back(dynamic);
+    back += dynamic;
+    const auto c = converted.packed_results();
+    const auto b = back.packed_results();
+    if (converted.rows() != 2*rows || back.rows() != 2*rows) {
+        throw std::runtime_error("Wrong number of rows after the sum");
+    }
+    for (std::size_t k{}; k != expected.size(); ++k) {
+        if (std::abs(c[k] - expected[k]) > 1e-9 || std::abs(b[k] - expected[k]) > 1e-9) {
+            throw std::runtime_error("Pair "s + std::to_string(k) + " changed after the conversion");
+        }
+    }
+    bool thrown{};
+    try {
+        math::statistics::multicolumn_pcc_accumulator<double, cols> wrong(math::statistics::multicolumn_pcc_accumulator<double>(cols + 1));
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    if (!thrown) {
+        throw std::runtime_error("Size mismatch not detected");
+    }
+});
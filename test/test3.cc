@@ -0,0 +1,78 @@
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../parallel_correlation.hh"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include <atomic>
+
+using namespace std::literals;
+using namespace math::statistics;
+
+static std::vector<double> random_matrix(int rows, int cols) {
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(3, 2);
+    std::vector<double> m(rows*cols);
+    for (auto& x : m) {
+        x = distribution(generator);
+    }
+    return m;
+}
+
+tester t1([](){
+    std::atomic<int> sum{};
+    math::parallel::thread_pool pool(4);
+    pool.parallel_for(1000, [&](std::size_t i){ sum += i; });
+    if (sum != 499500) {
+        throw std::runtime_error("Expected 499500, found "s + std::to_string(sum));
+    }
+});
+
+tester t2([](){
+    // splitting pairs gives exactly the serial result
+    constexpr int rows = 700, cols = 70;
+    const auto m = random_matrix(rows, cols);
+    multicolumn_pcc_accumulator<double> serial(cols), parallel(cols);
+    serial.accumulate(m.data(), rows, cols, cols, 1);
+    parallel_options options;
+    options.threads = 3;
+    options.split = parallel_options::strategy::pairs;
+    parallel_accumulate(parallel, m.data(), rows, cols, cols, 1, options);
+    if (serial.results() != parallel.results()) {
+        throw std::runtime_error("Parallel results differ from the serial ones");
+    }
+});
+
+tester t3([](){
+    // splitting rows does not depend on the number of threads
+    constexpr int rows = 3001, cols = 19;
+    const auto m = random_matrix(rows, cols);
+    multicolumn_pcc_accumulator<double> serial(cols);
+    serial.accumulate(m.data(), rows, cols, cols, 1);
+    const auto expected = serial.results();
+    std::map<std::pair<int,int>,double> first;
+    for (unsigned threads : {1u, 2u, 5u}) {
+        multicolumn_pcc_accumulator<double> parallel(cols);
+        parallel_options options;
+        options.threads = threads;
+        options.chunk_rows = 256;
+        options.split = parallel_options::strategy::rows;
+        parallel_accumulate(parallel, m.data(), rows, cols, cols, 1, options);
+        if (parallel.rows() != rows) {
+            throw std::runtime_error("Expected "s + std::to_string(rows) + " rows, found "s + std::to_string(parallel.rows()));
+        }
+        const auto res = parallel.results();
+        if (threads == 1) {
+            first = res;
+        } else if (res != first) {
+            throw std::runtime_error("Results depend on the number of threads");
+        }
+        for (const auto& [pair, value] : res) {
+            if (std::abs(value - expected.at(pair)) > 1e-12) {
+                throw std::runtime_error("Expected "s + std::to_string(expected.at(pair)) + ", found "s + std::to_string(value));
+            }
+        }
+    }
+});
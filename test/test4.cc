@@ -0,0 +1,73 @@
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../couple.hh"
+
+#include <vector>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+using namespace std::literals;
+using math::sets::couple;
+
+tester t1([](){
+    // closed form agrees with the enumeration
+    for (int n{2}; n != 40; ++n) {
+        long long k{};
+        for (couple c(n); c; ++c, ++k) {
+            const auto p = couple::pair(n, k);
+            if (c.as_pair() != p || c.index() != k || couple::index(n, p.first, p.second) != k) {
+                throw std::runtime_error("Pair "s + std::to_string(k) + " of "s + std::to_string(n) + " differs"s);
+            }
+        }
+        if (k != couple::pairs(n)) {
+            throw std::runtime_error("Expected "s + std::to_string(couple::pairs(n)) + " pairs, found "s + std::to_string(k));
+        }
+    }
+});
+
+tester t2([](){
+    // no overflow beyond n = 46341
+    constexpr int n = 100000;
+    const auto limit = couple::pairs(n);
+    for (auto i : {0LL, 1LL, limit/2, limit-2, limit-1}) {
+        couple c(n, i);
+        if (couple::index(n, c.first(), c.second()) != i) {
+            throw std::runtime_error("Wrong pair for index "s + std::to_string(i));
+        }
+    }
+    couple last(n, limit-1);
+    if (!last.last() || last.first() != n-2 || last.second() != n-1) {
+        throw std::runtime_error("Wrong last pair");
+    }
+});
+
+tester t3([](){
+    // sub-ranges cover the whole range exactly once
+    constexpr int n = 77;
+    math::sets::couple_range all(n);
+    std::vector<std::pair<int,int>> expected(all.begin(), all.end());
+    std::vector<std::pair<int,int>> found;
+    const auto parts = all.split(5);
+    for (const auto& r : parts) {
+        if (r.size() < all.size()/5 || r.size() > all.size()/5 + 1) {
+            throw std::runtime_error("Unbalanced sub-range of "s + std::to_string(r.size()) + " pairs"s);
+        }
+        found.insert(found.end(), r.begin(), r.end());
+    }
+    if (found != expected || (long long)expected.size() != couple::pairs(n)) {
+        throw std::runtime_error("Sub-ranges do not cover all the pairs");
+    }
+    // random access
+    auto it = all.begin() + 1000;
+    if (*it != couple::pair(n, 1000) || it[-3] != *(it - 3) || std::distance(all.begin(), it) != 1000) {
+        throw std::runtime_error("Wrong random access");
+    }
+    std::reverse(expected.begin(), expected.end());
+    std::vector<std::pair<int,int>> backward;
+    for (auto b = all.end(); b != all.begin(); ) {
+        backward.push_back(*--b);
+    }
+    if (backward != expected) {
+        throw std::runtime_error("Wrong backward iteration");
+    }
+});
@@ -0,0 +1,138 @@
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../rolling.hh"
+#include "../ewm.hh"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+
+using namespace std::literals;
+using namespace math::statistics;
+
+tester t1([](){
+    constexpr std::size_t W = 50, ticks = 1234;
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(1000, 3);
+    std::vector<double> xs, ys;
+    rolling_pcc<double> rolling(W, 17);
+    for (std::size_t t{}; t != ticks; ++t) {
+        xs.push_back(distribution(generator));
+        ys.push_back(xs.back()*0.5 + distribution(generator));
+        rolling.push(xs.back(), ys.back());
+        const auto n = std::min(W, xs.size());
+        const auto expected = pearson_correlation_coefficient(xs.data() + xs.size() - n, ys.data() + ys.size() - n, n);
+        if (rolling.size() != n || rolling.partial().count != (long long)n) {
+            throw std::runtime_error("Expected "s + std::to_string(n) + " samples, found "s + std::to_string(rolling.size()));
+        }
+        if (n > 1 && std::abs(rolling.compute() - expected.compute()) > 1e-6) {
+            throw std::runtime_error("Tick "s + std::to_string(t) + " expected "s + std::to_string(expected.compute()) + ", found "s + std::to_string(rolling.compute()));
+        }
+    }
+});
+
+tester t2([](){
+    constexpr int N = 6;
+    constexpr std::size_t W = 20, ticks = 300;
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> distribution(-4, 4);
+    std::vector<double> rows;
+    rolling_multicolumn_pcc<double> rolling(N, W);
+    for (std::size_t t{}; t != ticks; ++t) {
+        std::vector<double> row(N);
+        for (auto& x : row) {
+            x = distribution(generator);
+        }
+        rows.insert(rows.end(), row.begin(), row.end());
+        rolling.push(row);
+        const auto n = std::min(W, t+1);
+        multicolumn_pcc_accumulator<double> expected(N);
+        expected.accumulate(rows.data() + (t+1-n)*N, n, N, N, 1);
+        const auto found = rolling.packed_results();
+        const auto wanted = expected.packed_results();
+        for (std::size_t k{}; k != found.size(); ++k) {
+            if (std::abs(found[k] - wanted[k]) > 1e-9) {
+                throw std::runtime_error("Tick "s + std::to_string(t) + " expected "s + std::to_string(wanted[k]) + ", found "s + std::to_string(found[k]));
+            }
+        }
+    }
+});
+
+// direct computation with the decayed weights
+template <typename T>
+static T weighted_reference(const std::vector<T>& xs, const std::vector<T>& ys, T half_life) {
+    T w{}, s1{}, s2{}, q1{}, q2{}, p{};
+    const auto n = xs.size();
+    for (std::size_t t{}; t != n; ++t) {
+        const T k = std::exp2(-T(n - 1 - t) / half_life);
+        w += k;
+        s1 += k*xs[t];
+        s2 += k*ys[t];
+        q1 += k*xs[t]*xs[t];
+        q2 += k*ys[t]*ys[t];
+        p += k*xs[t]*ys[t];
+    }
+    return (p - s1*s2/w) / std::sqrt((q1 - s1*s1/w) * (q2 - s2*s2/w));
+}
+
+tester t3([](){
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(10, 2);
+    for (double half_life : {0.5, 7., 100.}) {
+        ewm_pcc<double> ewm(half_life);
+        std::vector<double> xs, ys;
+        // long enough to renormalize several times with the short half-lives
+        for (int t{}; t != 2000; ++t) {
+            xs.push_back(distribution(generator));
+            ys.push_back(std::sin(t / 50.) * xs.back() + distribution(generator));
+            ewm.accumulate(xs.back(), ys.back());
+        }
+        const auto expected = weighted_reference(xs, ys, half_life);
+        if (std::abs(ewm.compute() - expected) > 1e-6) {
+            throw std::runtime_error("Half-life "s + std::to_string(half_life) + " expected "s + std::to_string(expected) + ", found "s + std::to_string(ewm.compute()));
+        }
+        const auto weight = (1 - std::exp2(-2000 / half_life)) / (1 - std::exp2(-1 / half_life));
+        if (std::abs(ewm.total_weight() - weight) > 1e-6*weight) {
+            throw std::runtime_error("Wrong total weight "s + std::to_string(ewm.total_weight()) + ", expected "s + std::to_string(weight));
+        }
+    }
+});
+
+tester t4([](){
+    constexpr int N = 5;
+    constexpr double half_life = 3;
+    std::default_random_engine generator;
+    std::normal_distribution<float> distribution(0, 1);
+    ewm_multicolumn_pcc<float> ewm(N, half_life);
+    std::vector<std::vector<double>> columns(N);
+    for (int t{}; t != 500; ++t) {
+        std::vector<float> row(N);
+        for (int c{}; c != N; ++c) {
+            row[c] = distribution(generator) + (c ? 0.7f*row[0] : 0.f);
+            columns[c].push_back(row[c]);
+        }
+        ewm.accumulate(row);
+    }
+    const auto packed = ewm.packed_results();
+    for (int i{}, k{}; i != N; ++i) {
+        for (int j{i+1}; j != N; ++j, ++k) {
+            const auto expected = weighted_reference(columns[i], columns[j], half_life);
+            if (std::abs(packed[k] - expected) > 1e-3) {
+                throw std::runtime_error("Pair ("s + std::to_string(i) + ","s + std::to_string(j) + ") expected "s + std::to_string(expected) + ", found "s + std::to_string(packed[k]));
+            }
+        }
+    }
+});
+
+tester t5([](){
+    // invalid arguments are reported before any allocation
+    int errors{};
+    try { rolling_multicolumn_pcc<double> r(-1, 100); } catch (const std::invalid_argument&) { ++errors; }
+    try { rolling_multicolumn_pcc<double> r(1, 100); } catch (const std::invalid_argument&) { ++errors; }
+    try { rolling_multicolumn_pcc<double> r(3, 0); } catch (const std::invalid_argument&) { ++errors; }
+    try { rolling_multicolumn_pcc<double> r(1 << 30, std::size_t(1) << 40); } catch (const std::invalid_argument&) { ++errors; }
+    if (errors != 4) {
+        throw std::runtime_error("Invalid arguments not reported, "s + std::to_string(errors) + " errors"s);
+    }
+});
@@ -0,0 +1,79 @@
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../convertions.hh"
+
+#include <vector>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+using namespace std::literals;
+using namespace math::convertions;
+
+tester t1([](){
+    if (parse<double>(" +1.5e3 ") != 1500.0 || parse<int>("-42") != -42 || parse<float>("0.25\r") != 0.25f) {
+        throw std::runtime_error("Wrong value parsed");
+    }
+    unsigned int u;
+    if (parse("4294967296", u) != std::errc::result_out_of_range || parse("-1", u) != std::errc::result_out_of_range) {
+        throw std::runtime_error("unsigned int range not checked");
+    }
+    double d;
+    if (parse("1.5x", d) != std::errc::invalid_argument || parse("", d) != std::errc::invalid_argument) {
+        throw std::runtime_error("Invalid values accepted");
+    }
+    bool thrown = false;
+    try {
+        parse<unsigned int>("-3");
+    } catch (std::out_of_range&) {
+        thrown = true;
+    }
+    if (!thrown) {
+        throw std::runtime_error("Expected std::out_of_range");
+    }
+});
+
+tester t2([](){
+    // long enough to span several 64 bytes blocks
+    std::string text;
+    constexpr std::size_t rows = 40, cols = 5;
+    for (std::size_t r{}; r != rows; ++r) {
+        for (std::size_t c{}; c != cols; ++c) {
+            text += std::to_string(r*cols + c) + ".5";
+            text += c+1 == cols ? (r % 3 ? "\n" : "\r\n") : ",";
+        }
+        if (r == 7) {
+            text += "\n";
+        }
+    }
+    // column-major destination
+    std::vector<double> m(rows*cols);
+    const auto status = parse_rows(text, ',', m.data(), cols, rows, 1, rows);
+    throw_if_error(status);
+    if (status.rows != rows || status.consumed != text.size()) {
+        throw std::runtime_error("Expected "s + std::to_string(rows) + " rows, found "s + std::to_string(status.rows));
+    }
+    for (std::size_t r{}; r != rows; ++r) {
+        for (std::size_t c{}; c != cols; ++c) {
+            if (m[c*rows + r] != r*cols + c + 0.5) {
+                throw std::runtime_error("Wrong value at ("s + std::to_string(r) + ","s + std::to_string(c) + ")"s);
+            }
+        }
+    }
+});
+
+tester t3([](){
+    double out[3];
+    auto status = parse_fields("1;2;x", ';', out, 3);
+    if (status || status.column != 2) {
+        throw std::runtime_error("Error not reported");
+    }
+    status = parse_fields("1;2", ';', out, 3);
+    if (status) {
+        throw std::runtime_error("Missing field not reported");
+    }
+    // incomplete last line left to the caller
+    status = parse_rows("1;2;3\n4;5", ';', out, 3, 10, 3, 1, false);
+    if (!status || status.rows != 1 || status.consumed != 6) {
+        throw std::runtime_error("Wrong handling of an incomplete line");
+    }
+});
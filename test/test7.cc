@@ -0,0 +1,112 @@
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../columnar.hh"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+using namespace std::literals;
+using namespace math::statistics;
+using namespace math::io;
+
+static void check_same(const multicolumn_pcc_accumulator<double>& expected, const multicolumn_pcc_accumulator<double>& found) {
+    const auto e = expected.packed_results(), f = found.packed_results();
+    for (std::size_t k{}; k != e.size(); ++k) {
+        if (std::abs(e[k] - f[k]) > 1e-9) {
+            throw std::runtime_error("Pair "s + std::to_string(k) + " expected "s + std::to_string(e[k]) + ", found "s + std::to_string(f[k]));
+        }
+    }
+}
+
+tester t1([](){
+    constexpr int N = 7;
+    constexpr std::size_t rows = 1003;
+    const auto path = "test7_t1.col"s;
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(10, 2);
+    std::vector<double> matrix(rows*N);
+    for (auto& v : matrix) {
+        v = distribution(generator);
+    }
+    {
+        columnar_writer<double> writer(path, rows, N);
+        for (std::size_t r{}; r != rows; ++r) {
+            for (int c{}; c != N; ++c) {
+                writer.column(c)[r] = matrix[r*N + c];
+            }
+        }
+    }
+    multicolumn_pcc_accumulator<double> expected(N);
+    expected.accumulate(matrix.data(), rows, N, N, 1);
+
+    columnar_reader<double> reader(path);
+    if (reader.rows() != rows || reader.cols() != N) {
+        throw std::runtime_error("Wrong size of the columnar file");
+    }
+    if (reinterpret_cast<std::uintptr_t>(reader.column(1)) % 64) {
+        throw std::runtime_error("Columns are not aligned to 64 bytes");
+    }
+    multicolumn_pcc_accumulator<double> serial(N), parallel(N);
+    reader.accumulate(serial, 100);
+    reader.parallel_accumulate(parallel, 64, 3);
+    check_same(expected, serial);
+    check_same(expected, parallel);
+
+    bool thrown{};
+    try {
+        columnar_reader<float> wrong(path);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    std::remove(path.c_str());
+    if (!thrown) {
+        throw std::runtime_error("Type mismatch not detected");
+    }
+});
+
+tester t2([](){
+    const auto csv = "test7_t2.csv"s, path = "test7_t2.col"s;
+    {
+        std::ofstream out(csv);
+        out << "a;b;c\n1;2;3\n\n4;5.5;-6\r\n7;8;9";
+    }
+    if (csv_to_columnar<double>(csv, path, ';', 1) != 3) {
+        throw std::runtime_error("Expected 3 rows");
+    }
+    columnar_reader<double> reader(path);
+    const std::vector<std::vector<double>> expected{{1,4,7}, {2,5.5,8}, {3,-6,9}};
+    for (int c{}; c != 3; ++c) {
+        for (int r{}; r != 3; ++r) {
+            if (reader.column(c)[r] != expected[c][r]) {
+                throw std::runtime_error("Wrong value at ("s + std::to_string(r) + ","s + std::to_string(c) + ")"s);
+            }
+        }
+    }
+    {
+        std::ofstream out(csv);
+        out << "1;2\n3;x\n";
+    }
+    bool thrown{};
+    try {
+        csv_to_columnar<double>(csv, path, ';');
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    // the previous conversion is left untouched, without the
+    // temporary file
+    const bool kept = columnar_reader<double>(path).rows() == 3;
+    const bool tmp_left = std::ifstream(path + ".tmp").good();
+    std::remove(csv.c_str());
+    std::remove(path.c_str());
+    if (!thrown) {
+        throw std::runtime_error("Invalid value not detected");
+    }
+    if (!kept || tmp_left) {
+        throw std::runtime_error("Failed conversion left a partial file");
+    }
+});
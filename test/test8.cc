@@ -0,0 +1,118 @@
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../serialization.hh"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cstdio>
+#include <array>
+
+using namespace std::literals;
+using namespace math::statistics;
+using namespace math::io;
+
+tester t1([](){
+    constexpr int N = 9, shards = 4, rows = 200;
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(3, 1);
+    multicolumn_pcc_accumulator<double> total(N);
+    std::vector<std::string> paths;
+    for (int s{}; s != shards; ++s) {
+        std::vector<double> m(rows*N);
+        for (auto& x : m) {
+            x = distribution(generator);
+        }
+        multicolumn_pcc_accumulator<double> shard(N);
+        shard.accumulate(m.data(), rows, N, N, 1);
+        total += shard;
+        paths.push_back("test8_shard"s + std::to_string(s) + ".state"s);
+        save(paths.back(), shard);
+    }
+    const auto merged = merge_accumulators<double>(paths);
+    if (merged.rows() != total.rows()) {
+        throw std::runtime_error("Expected "s + std::to_string(total.rows()) + " rows, found "s + std::to_string(merged.rows()));
+    }
+    const auto expected = total.packed_results(), found = merged.packed_results();
+    for (std::size_t k{}; k != expected.size(); ++k) {
+        if (expected[k] != found[k]) {
+            throw std::runtime_error("Pair "s + std::to_string(k) + " expected "s + std::to_string(expected[k]) + ", found "s + std::to_string(found[k]));
+        }
+    }
+    bool thrown{};
+    try {
+        load_accumulator<float>(paths.front());
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    for (const auto& path : paths) {
+        std::remove(path.c_str());
+    }
+    if (!thrown) {
+        throw std::runtime_error("Type mismatch not detected");
+    }
+});
+
+tester t2([](){
+    const auto path = "test8_t2.state"s;
+    pcc_partial<double> p;
+    for (int i{}; i != 100; ++i) {
+        p.accumulate(i, i*0.5 + (i % 7));
+    }
+    checkpoint(path, p, 100);
+    std::uint64_t position{};
+    const auto loaded = load_partial<double>(path, &position);
+    std::remove(path.c_str());
+    if (position != 100 || loaded.count != p.count || loaded.compute() != p.compute()) {
+        throw std::runtime_error("Checkpoint not restored");
+    }
+    multicolumn_pcc_accumulator<double, 3> fixed;
+    for (const auto& row : {std::array<double, 3>{1, 2, 4}, {2, 1, 3}, {5, 0, 1}}) {
+        fixed.accumulate(row);
+    }
+    // directory of the path flushed too
+    checkpoint("./"s + path, fixed, 3);
+    const multicolumn_pcc_accumulator<double, 3> restored(load_accumulator<double>(path, &position));
+    std::remove(path.c_str());
+    if (position != 3 || restored.packed_results() != fixed.packed_results()) {
+        throw std::runtime_error("Checkpoint of the fixed size accumulator not restored");
+    }
+});
+
+tester t3([](){
+    // integer accumulators store their 64 and 128 bit sums
+    const auto path = "test8_t3.state"s;
+    multicolumn_pcc_accumulator<std::int16_t> acc(2);
+    for (int i{}; i != 4; ++i) {
+        const std::int16_t row[2] = {30000, 30000};
+        acc.accumulate_row(row);
+    }
+    const std::int16_t row[2] = {-32768, 1};
+    acc.accumulate_row(row);
+    save(path, acc, 5);
+    const auto loaded = load_accumulator<std::int16_t>(path);
+    if (loaded.rows() != 5 || loaded.partial(0, 1).sum_1_squared != acc.partial(0, 1).sum_1_squared
+        || loaded.packed_results()[0] != acc.packed_results()[0]) {
+        throw std::runtime_error("int16 accumulator not restored");
+    }
+    pcc_partial<std::int32_t> p;
+    p.accumulate(2147483647, -2147483647 - 1);
+    p.accumulate(-2147483647 - 1, 2147483647);
+    p.accumulate(5, 7);
+    save(path, p);
+    const auto q = load_partial<std::int32_t>(path);
+    if (q.sum_prod != p.sum_prod || q.sum_1_squared != p.sum_1_squared || q.compute() != p.compute()) {
+        throw std::runtime_error("int32 partial not restored");
+    }
+    bool thrown{};
+    try {
+        load_partial<float>(path);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    std::remove(path.c_str());
+    if (!thrown) {
+        throw std::runtime_error("Type mismatch not detected");
+    }
+});
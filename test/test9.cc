@@ -0,0 +1,99 @@
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../masked_correlation.hh"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include <limits>
+
+using namespace std::literals;
+using namespace math::statistics;
+
+// pairwise deletion, one pair at a time
+static pcc_partial<double> reference(const std::vector<double>& m, int rows, int cols, int i, int j) {
+    pcc_partial<double> p;
+    for (int r{}; r != rows; ++r) {
+        const auto a = m[r*cols + i], b = m[r*cols + j];
+        if (!std::isnan(a) && !std::isnan(b)) {
+            p.accumulate(a, b);
+        }
+    }
+    return p;
+}
+
+tester t1([](){
+    constexpr std::size_t size = 5000;
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(4, 1);
+    std::vector<double> v1(size), v2(size);
+    pcc_partial<double> expected;
+    for (std::size_t i{}; i != size; ++i) {
+        v1[i] = distribution(generator);
+        v2[i] = v1[i] + distribution(generator);
+        // gaps only in the second half
+        if (i > size/2 && i % 13 == 0) {
+            v1[i] = std::numeric_limits<double>::quiet_NaN();
+        } else if (i > size/2 && i % 17 == 0) {
+            v2[i] = std::numeric_limits<double>::quiet_NaN();
+        } else {
+            expected.accumulate(v1[i], v2[i]);
+        }
+    }
+    for (auto level : {math::simd::isa::scalar, math::simd::isa::avx2}) {
+        math::simd::restrict_isa(level);
+        const auto found = masked_pearson_correlation_coefficient(v1, v2);
+        if (found.count != expected.count || std::abs(found.compute() - expected.compute()) > 1e-12) {
+            throw std::runtime_error("Expected "s + std::to_string(expected.compute()) + " over "s + std::to_string(expected.count)
+                + " pairs, found "s + std::to_string(found.compute()) + " over "s + std::to_string(found.count));
+        }
+    }
+    math::simd::restrict_isa(math::simd::isa::avx512);
+});
+
+tester t2([](){
+    constexpr int rows = 1500, cols = 12;
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(-2, 3);
+    std::uniform_int_distribution<int> gap(0, 40);
+    std::vector<double> m(rows*cols);
+    for (int r{}; r != rows; ++r) {
+        for (int c{}; c != cols; ++c) {
+            m[r*cols + c] = distribution(generator) + (c ? 0.5*m[r*cols] : 0);
+            // rows [256,512) stay dense
+            if ((r < 256 || r >= 512) && gap(generator) == 0) {
+                m[r*cols + c] = std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+    }
+    std::vector<double> t(rows*cols);
+    for (int r{}; r != rows; ++r) {
+        for (int c{}; c != cols; ++c) {
+            t[c*rows + r] = m[r*cols + c];
+        }
+    }
+    masked_multicolumn_pcc_accumulator<double> by_rows(cols), row_major(cols), column_major(cols);
+    for (int r{}; r != rows; ++r) {
+        by_rows.accumulate(m.data() + r*cols, cols);
+    }
+    row_major.accumulate(m.data(), rows, cols, cols, 1);
+    column_major.accumulate(t.data(), 700, cols, 1, rows);
+    column_major += masked_multicolumn_pcc_accumulator<double>(cols).accumulate(t.data() + 700, rows - 700, cols, 1, rows);
+    for (const auto* acc : {&by_rows, &row_major, &column_major}) {
+        const auto packed = acc->packed_results();
+        if (acc->rows() != rows) {
+            throw std::runtime_error("Expected "s + std::to_string(rows) + " rows, found "s + std::to_string(acc->rows()));
+        }
+        for (int i{}, k{}; i != cols; ++i) {
+            for (int j{i+1}; j != cols; ++j, ++k) {
+                const auto expected = reference(m, rows, cols, i, j);
+                if (acc->count(i, j) != expected.count || std::abs(packed[k] - expected.compute()) > 1e-9) {
+                    throw std::runtime_error("Pair ("s + std::to_string(i) + ","s + std::to_string(j) + ") expected "s + std::to_string(expected.compute())
+                        + " over "s + std::to_string(expected.count) + " rows, found "s + std::to_string(packed[k]) + " over "s + std::to_string(acc->count(i, j)));
+                }
+            }
+        }
+    }
+});
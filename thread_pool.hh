@@ -0,0 +1,237 @@
+
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace math
+{
+    namespace parallel
+    {
+
+        // number of threads to use when the user does not care
+        inline unsigned default_threads() {
+            const auto n = std::thread::hardware_concurrency();
+            return n ? n : 1;
+        }
+
+        /**
+         * Minimal work-stealing thread pool.
+         * Every worker owns a queue: tasks submitted by a
+         * worker go to its own queue and are executed LIFO,
+         * idle workers steal FIFO from the other queues.
+         * The thread calling wait() helps executing tasks.
+         */
+        class thread_pool
+        {
+        private:
+            using task = std::function<void()>;
+
+            struct queue {
+                std::mutex m;
+                std::deque<task> tasks;
+            };
+
+            std::vector<std::unique_ptr<queue>> queues;
+            std::vector<std::thread> threads;
+
+            std::mutex m;
+            std::condition_variable work_cv;    // new tasks or stop
+            std::condition_variable done_cv;    // all tasks completed
+            std::atomic<std::size_t> queued{};  // tasks in the queues
+            std::size_t unfinished{};           // queued + running, guarded by m
+            std::size_t next{};                 // round robin for external submit
+            bool stop{};
+            std::exception_ptr error;           // first exception thrown by a task
+
+            // index of the queue owned by the current thread,
+            // if it is a worker of this pool
+            static std::size_t& own_index() {
+                static thread_local std::size_t idx = -1;
+                return idx;
+            }
+            static const thread_pool*& own_pool() {
+                static thread_local const thread_pool* pool{};
+                return pool;
+            }
+
+            bool pop(std::size_t idx, task& t) {
+                auto& q = *queues[idx];
+                std::lock_guard<std::mutex> lock(q.m);
+                if (q.tasks.empty()) {
+                    return false;
+                }
+                t = std::move(q.tasks.back());
+                q.tasks.pop_back();
+                --queued;
+                return true;
+            }
+
+            bool steal(std::size_t thief, task& t) {
+                const auto n = queues.size();
+                for (std::size_t i{1}; i <= n; ++i) {
+                    auto& q = *queues[(thief + i) % n];
+                    std::lock_guard<std::mutex> lock(q.m);
+                    if (!q.tasks.empty()) {
+                        t = std::move(q.tasks.front());
+                        q.tasks.pop_front();
+                        --queued;
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            bool try_get(std::size_t idx, task& t) {
+                return (idx < queues.size() && pop(idx, t)) || steal(idx, t);
+            }
+
+            void execute(task& t) {
+                try {
+                    t();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(m);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+                std::lock_guard<std::mutex> lock(m);
+                if (--unfinished == 0) {
+                    done_cv.notify_all();
+                }
+            }
+
+            void work(std::size_t idx) {
+                own_index() = idx;
+                own_pool() = this;
+                task t;
+                while (true) {
+                    if (try_get(idx, t)) {
+                        execute(t);
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> lock(m);
+                    work_cv.wait(lock, [this](){ return stop || queued != 0; });
+                    if (stop && queued == 0) {
+                        return;
+                    }
+                }
+            }
+
+        public:
+            explicit thread_pool(unsigned n = default_threads()) {
+                if (n == 0) {
+                    n = 1;
+                }
+                for (unsigned i{}; i != n; ++i) {
+                    queues.push_back(std::make_unique<queue>());
+                }
+                for (unsigned i{}; i != n; ++i) {
+                    threads.emplace_back([this, i](){ work(i); });
+                }
+            }
+
+            thread_pool(const thread_pool&) = delete;
+            thread_pool& operator=(const thread_pool&) = delete;
+
+            ~thread_pool() {
+                {
+                    std::lock_guard<std::mutex> lock(m);
+                    stop = true;
+                }
+                work_cv.notify_all();
+                for (auto& t : threads) {
+                    t.join();
+                }
+            }
+
+            auto size() const { return threads.size(); }
+
+            void submit(task t) {
+                std::size_t idx;
+                {
+                    std::lock_guard<std::mutex> lock(m);
+                    ++unfinished;
+                    idx = own_pool() == this ? own_index() : next++ % queues.size();
+                }
+                try {
+                    auto& q = *queues[idx];
+                    std::lock_guard<std::mutex> lock(q.m);
+                    q.tasks.push_back(std::move(t));
+                    ++queued;
+                } catch (...) {
+                    // not queued, wait() must not expect it
+                    std::lock_guard<std::mutex> lock(m);
+                    if (--unfinished == 0) {
+                        done_cv.notify_all();
+                    }
+                    throw;
+                }
+                // take m so that no worker can miss the update
+                std::lock_guard<std::mutex> lock(m);
+                work_cv.notify_one();
+            }
+
+            // wait for all the submitted tasks, the calling thread
+            // executes tasks too. Rethrow the first exception
+            // thrown by a task, if any.
+            // It must not be called by a task of the same pool.
+            void wait() {
+                const auto idx = own_pool() == this ? own_index() : queues.size();
+                task t;
+                while (true) {
+                    if (try_get(idx, t)) {
+                        execute(t);
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> lock(m);
+                    if (unfinished == 0) {
+                        break;
+                    }
+                    done_cv.wait(lock, [this](){ return unfinished == 0 || queued != 0; });
+                    if (unfinished == 0) {
+                        break;
+                    }
+                }
+                std::exception_ptr e;
+                {
+                    std::lock_guard<std::mutex> lock(m);
+                    std::swap(e, error);
+                }
+                if (e) {
+                    std::rethrow_exception(e);
+                }
+            }
+
+            // run f(i) for each i in [0,tasks) and wait for them
+            template <typename F>
+            void parallel_for(std::size_t tasks, F f) {
+                try {
+                    for (std::size_t i{}; i != tasks; ++i) {
+                        submit([&f, i](){ f(i); });
+                    }
+                } catch (...) {
+                    // the tasks already queued refer to f
+                    try {
+                        wait();
+                    } catch (...) {
+                    }
+                    throw;
+                }
+                wait();
+            }
+        };
+
+    } // namespace parallel
+} // namespace math
+
+#endif